@@ -26,9 +26,33 @@
     ((type *)((char *)(ptr) - offsetof(type, member)))
 
 #define UNUSED(x) (void)(x)
+
+// Structures split into fields written on every call and read-mostly ones put
+// the written group on its own cache lines. CACHE_ALIGNED on a member starts
+// a new line; on a type it also pads the size to whole lines.
+#define CACHE_LINE_SIZE 64
+#define CACHE_ALIGNED __attribute__((aligned(CACHE_LINE_SIZE)))
+
+// Zeroed allocation starting on a cache line, released with free()
+static inline void *
+calloc_cache_aligned(size_t size)
+{
+    void *ptr = NULL;
+    if (posix_memalign(&ptr, CACHE_LINE_SIZE, size) != 0) {
+        return NULL;
+    }
+    memset(ptr, 0, size);
+    return ptr;
+}
 #define PTR2UINT(v)((uintptr_t)(const void*)(v))
 #define UINT2PTR(v)((void*)(uintptr_t)(v))
 
+// Maps the public size index selection onto the utils implementation
+#define SIZE_INDEX_KIND(type) \
+    (((type) == VA_SIZE_INDEX_SEGREGATED) ? CU_SIZE_INDEX_SEGREGATED : \
+     ((type) == VA_SIZE_INDEX_RADIX_COMPRESSED) ? CU_SIZE_INDEX_RADIX_COMPRESSED : \
+     ((type) == VA_SIZE_INDEX_ADDRESS_FIRST_FIT) ? CU_SIZE_INDEX_ADDRESS_FIRST_FIT : CU_SIZE_INDEX_RADIX)
+
 #define RESERVE_VA(size) mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0)
 #define FREE_VA(addr, size) munmap(addr, size)
 
@@ -2,11 +2,14 @@
 #define VA_ALLOCATOR_ARENAS_H
 
 #include "va_allocator_types.h"
+#include "va_snapshot.h"
 
 #define PHYSICAL_MEMORY_SIZE (1ULL << 31)  // 2GB physical memory
 
 // Forward declaration of ops getter for arena allocator
-va_allocator_ops_t* get_arena_allocator_ops(void);
-void *init_arena_allocator(void);
+const va_allocator_ops_t *get_arena_allocator_ops(void);
+void *init_arena_allocator(const va_allocator_config_t *config);
+// Rebuilds an allocator from the records written by its snapshot op
+void *restore_arena_allocator(const va_allocator_config_t *config, va_snapshot_reader_t *reader);
 
 #endif // VA_ALLOCATOR_ARENAS_H 
\ No newline at end of file
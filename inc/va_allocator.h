@@ -14,6 +14,7 @@ typedef struct va_allocator va_allocator_t;
 
 // Function declarations
 va_allocator_t* va_allocator_init(va_allocator_type_t type);
+va_allocator_t* va_allocator_init_with_config(va_allocator_type_t type, const va_allocator_config_t *config);
 void va_allocator_destroy(va_allocator_t *allocator);
 uint64_t va_alloc(va_allocator_t *allocator, uint64_t size);
 void va_free(va_allocator_t *allocator, uint64_t addr);
@@ -24,6 +25,94 @@ uint64_t va_allocator_get_total_size(va_allocator_t *allocator);
 // Get used VA size
 uint64_t va_allocator_get_used_size(va_allocator_t *allocator);
 
+// Get VA currently backed by memory through va_commit()
+uint64_t va_allocator_get_committed_size(va_allocator_t *allocator);
+
+// Back [addr, addr + size) with readable and writable memory. The range is
+// rounded out to whole pages and must lie within a single reservation of the
+// allocator. Returns 0 on success and -1 on failure.
+int va_commit(va_allocator_t *allocator, uint64_t addr, uint64_t size);
+
+// Release the memory behind [addr, addr + size); its contents are discarded
+// and the pages become inaccessible again. Same rounding and return as va_commit().
+int va_decommit(va_allocator_t *allocator, uint64_t addr, uint64_t size);
+
+// Batched forms: ranges that overlap or touch are merged so each merged range
+// costs one syscall. Nothing is applied if any range is invalid.
+int va_commit_ranges(va_allocator_t *allocator, const va_range_t *ranges, size_t count);
+int va_decommit_ranges(va_allocator_t *allocator, const va_range_t *ranges, size_t count);
+
+// Get free space and largest allocatable extent across all reservations
+void va_allocator_get_frag_stats(va_allocator_t *allocator, va_allocator_frag_stats_t *stats);
+
+// Plan a compaction: for every reservation that could be emptied by moving its
+// live blocks into other reservations, reserve a destination for each block
+// and list the moves in 'plan'. No allocation lands in those reservations until
+// the plan is applied, and the blocks in it must not be freed before then.
+// Returns 0 on success (possibly with no moves) and -1 if unsupported.
+int va_compaction_plan(va_allocator_t *allocator, va_compaction_plan_t *plan);
+
+// Apply a plan, calling 'relocate' for each move. A confirmed move frees its
+// source block; a declined one releases its destination. Reservations left
+// empty are then unmapped. A NULL 'relocate' declines every move, which
+// cancels the plan. The plan is consumed either way. Returns the VA released.
+uint64_t va_compaction_apply(va_allocator_t *allocator, va_compaction_plan_t *plan,
+                             va_relocate_fn relocate, void *ctx);
+
+// Write the allocator's layout (reservations, block lists, slab bitmaps and
+// large extents) to 'path' in a flat format. Returns 0 on success and -1 on
+// failure or if unsupported.
+int va_allocator_snapshot(va_allocator_t *allocator, const char *path);
+
+// Recreate an allocator from a snapshot, with every reservation mapped back at
+// its recorded address. Fails if any of that VA is already mapped. Page
+// contents and commit state are not part of a snapshot: all VA comes back
+// decommitted.
+va_allocator_t* va_allocator_restore(const char *path);
+
+// Memfd holding the metadata of a VA_ALLOCATOR_TYPE_SHARED allocator, or -1
+// for other types. Children created with fork() share the allocator as is;
+// other processes receive this descriptor and call va_allocator_shared_attach().
+int va_allocator_shared_fd(va_allocator_t *allocator);
+
+// Join a shared allocator, reserving its VA range at the same address in this
+// process. Fails if that range is already mapped here. The descriptor is
+// duplicated, so the caller may close it.
+va_allocator_t* va_allocator_shared_attach(int fd);
+
+// Implementation behind 'allocator', for the direct entry points below
+void *va_allocator_impl(va_allocator_t *allocator);
+
+// Direct entry points of each strategy, which skip the ops table and its NULL
+// checks. Used by the C++ front end in va_allocator.hpp; 'impl' must come from
+// va_allocator_impl() on an allocator of the matching type.
+uint64_t va_default_alloc(void *impl, uint64_t size);
+void va_default_free(void *impl, uint64_t addr);
+uint64_t va_arena_alloc(void *impl, uint64_t size);
+void va_arena_free(void *impl, uint64_t addr);
+uint64_t va_shared_alloc(void *impl, uint64_t size);
+void va_shared_free(void *impl, uint64_t addr);
+
+// Allocate from arena 'arena_idx' without looking it up; 'size' must belong
+// to that arena, i.e. be above the previous arena's va_arena_class_size().
+// Returns 0 if it does not.
+uint64_t va_arena_alloc_class(void *impl, uint32_t arena_idx, uint64_t size);
+
+// Largest request served by arena 'arena_idx', or 0 past the last arena
+uint64_t va_arena_class_size(uint32_t arena_idx);
+
+// Copy the cycles spent in each internal stage since creation or the last
+// reset. Returns 0 on success and -1 if the library was built without
+// VA_STAGE_TIMERS or the type has no timed stages.
+int va_allocator_get_stage_stats(va_allocator_t *allocator, va_stage_stats_t *stats);
+void va_allocator_reset_stage_stats(va_allocator_t *allocator);
+
+// Printable name of a stage
+const char *va_stage_name(va_stage_t stage);
+
+// Fill in the configuration used by va_allocator_init
+void va_allocator_config_default(va_allocator_config_t *config);
+
 // Print allocator stats
 void va_allocator_print(va_allocator_t *allocator);
 
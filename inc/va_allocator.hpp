@@ -0,0 +1,271 @@
+#ifndef VA_ALLOCATOR_HPP
+#define VA_ALLOCATOR_HPP
+
+//
+// Header-only C++ front end for the VA allocator.
+//
+// va::basic_allocator<Policy, Classes> owns one allocator of the type named by
+// Policy and calls that strategy's entry points directly, instead of going
+// through va_alloc() and the ops table. Classes is a compile-time size-class
+// table that requests are rounded up to before they reach the strategy. For
+// the arena policy, the arena serving a request is also chosen at compile
+// time when the size is a constant, see allocate<Size>().
+//
+// With C++17, va::memory_resource adapts an allocator to
+// std::pmr::memory_resource, handing out committed memory.
+//
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <unistd.h>
+#include "va_allocator.h"
+
+#if __cplusplus >= 201703L
+#include <memory_resource>
+#endif
+
+namespace va {
+
+namespace detail {
+
+// Index of the first class holding 'size', or the class count if none does
+template <uint64_t... Sizes>
+struct class_index;
+
+template <>
+struct class_index<> {
+    static constexpr uint32_t apply(uint64_t) { return 0; }
+};
+
+template <uint64_t First, uint64_t... Rest>
+struct class_index<First, Rest...> {
+    static constexpr uint32_t apply(uint64_t size) {
+        return size <= First ? 0 : 1 + class_index<Rest...>::apply(size);
+    }
+};
+
+// Smallest class holding 'size', or 'size' itself above the last class
+template <uint64_t... Sizes>
+struct class_round;
+
+template <>
+struct class_round<> {
+    static constexpr uint64_t apply(uint64_t size) { return size; }
+};
+
+template <uint64_t First, uint64_t... Rest>
+struct class_round<First, Rest...> {
+    static constexpr uint64_t apply(uint64_t size) {
+        return size <= First ? First : class_round<Rest...>::apply(size);
+    }
+};
+
+template <uint64_t... Sizes>
+struct ascending;
+
+template <>
+struct ascending<> {
+    static constexpr bool value = true;
+};
+
+template <uint64_t Only>
+struct ascending<Only> {
+    static constexpr bool value = Only > 0;
+};
+
+template <uint64_t First, uint64_t Second, uint64_t... Rest>
+struct ascending<First, Second, Rest...> {
+    static constexpr bool value = First > 0 && First < Second && ascending<Second, Rest...>::value;
+};
+
+} // namespace detail
+
+// Compile-time size-class table, largest request of each class in ascending order
+template <uint64_t... Sizes>
+struct size_classes {
+    static_assert(detail::ascending<Sizes...>::value, "size classes must be positive and ascending");
+
+    static constexpr uint32_t count = sizeof...(Sizes);
+
+    static constexpr uint32_t index(uint64_t size) { return detail::class_index<Sizes...>::apply(size); }
+    static constexpr uint64_t round(uint64_t size) { return detail::class_round<Sizes...>::apply(size); }
+
+    // Largest request of class 'i', or 0 past the last class
+    static uint64_t size(uint32_t i) {
+        const uint64_t sizes[] = {Sizes..., 0};
+        return i < count ? sizes[i] : 0;
+    }
+};
+
+// No rounding: every request reaches the strategy as is
+typedef size_classes<> exact_sizes;
+
+//
+// Allocation policies, one per allocator type. class_of() maps a request to
+// the strategy's own class, and alloc() takes that class so it can be folded
+// to a constant by the caller.
+//
+struct default_policy {
+    static const va_allocator_type_t type = VA_ALLOCATOR_TYPE_DEFAULT;
+
+    static constexpr uint32_t class_of(uint64_t) { return 0; }
+    static bool check() { return true; }
+
+    static uint64_t alloc(void *impl, uint32_t, uint64_t size) { return va_default_alloc(impl, size); }
+    static void free(void *impl, uint64_t addr) { va_default_free(impl, addr); }
+};
+
+struct arena_policy {
+    static const va_allocator_type_t type = VA_ALLOCATOR_TYPE_ARENA;
+
+    // Mirror of the bounded arenas in arena_info_table; anything larger goes
+    // to the large-object arena that follows them
+    typedef size_classes<512, 1024, 2048, 4096, 64 * 1024, 2 * 1024 * 1024, 32 * 1024 * 1024> arenas;
+
+    static constexpr uint32_t class_of(uint64_t size) { return arenas::index(size); }
+
+    // False if the mirror has drifted from the library's arena table
+    static bool check() {
+        for (uint32_t i = 0; i < arenas::count; i++) {
+            if (va_arena_class_size(i) != arenas::size(i)) {
+                return false;
+            }
+        }
+        return va_arena_class_size(arenas::count) == ~0ULL;
+    }
+
+    static uint64_t alloc(void *impl, uint32_t arena_idx, uint64_t size) {
+        return va_arena_alloc_class(impl, arena_idx, size);
+    }
+    static void free(void *impl, uint64_t addr) { va_arena_free(impl, addr); }
+};
+
+struct shared_policy {
+    static const va_allocator_type_t type = VA_ALLOCATOR_TYPE_SHARED;
+
+    static constexpr uint32_t class_of(uint64_t) { return 0; }
+    static bool check() { return true; }
+
+    static uint64_t alloc(void *impl, uint32_t, uint64_t size) { return va_shared_alloc(impl, size); }
+    static void free(void *impl, uint64_t addr) { va_shared_free(impl, addr); }
+};
+
+//
+// Owns one allocator of Policy::type. Allocation and free call the strategy
+// directly; everything else goes through the C API on get(). Like va_alloc(),
+// allocate() returns 0 on failure. The constructor throws std::bad_alloc if
+// the allocator cannot be created, and std::logic_error if Policy::check()
+// finds the policy's class table out of step with the library.
+//
+template <typename Policy, typename Classes = exact_sizes>
+class basic_allocator {
+public:
+    typedef Policy policy_type;
+    typedef Classes classes_type;
+
+    explicit basic_allocator(const va_allocator_config_t *config = nullptr)
+        : handle_(config ? va_allocator_init_with_config(Policy::type, config)
+                         : va_allocator_init(Policy::type)),
+          impl_(va_allocator_impl(handle_)) {
+        if (!handle_) {
+            throw std::bad_alloc();
+        }
+        if (!Policy::check()) {
+            va_allocator_destroy(handle_);
+            throw std::logic_error("va::basic_allocator: policy size classes do not match the library");
+        }
+    }
+
+    ~basic_allocator() { va_allocator_destroy(handle_); }
+
+    basic_allocator(const basic_allocator &) = delete;
+    basic_allocator &operator=(const basic_allocator &) = delete;
+
+    uint64_t allocate(uint64_t size) {
+        uint64_t rounded = Classes::round(size);
+        return Policy::alloc(impl_, Policy::class_of(rounded), rounded);
+    }
+
+    // Size known at compile time: class and strategy class are both constants
+    template <uint64_t Size>
+    uint64_t allocate() {
+        static constexpr uint64_t rounded = Classes::round(Size);
+        static constexpr uint32_t strategy_class = Policy::class_of(rounded);
+        return Policy::alloc(impl_, strategy_class, rounded);
+    }
+
+    void deallocate(uint64_t addr) { Policy::free(impl_, addr); }
+
+    int commit(uint64_t addr, uint64_t size) { return va_commit(handle_, addr, size); }
+    int decommit(uint64_t addr, uint64_t size) { return va_decommit(handle_, addr, size); }
+
+    uint64_t total_size() const { return va_allocator_get_total_size(handle_); }
+    uint64_t used_size() const { return va_allocator_get_used_size(handle_); }
+    uint64_t committed_size() const { return va_allocator_get_committed_size(handle_); }
+
+    va_allocator_t *get() const { return handle_; }
+
+private:
+    va_allocator_t *handle_;
+    void *impl_;
+};
+
+typedef basic_allocator<default_policy> default_allocator;
+typedef basic_allocator<arena_policy> arena_allocator;
+typedef basic_allocator<shared_policy> shared_allocator;
+
+#if __cplusplus >= 201703L
+//
+// std::pmr::memory_resource over a basic_allocator, handing out committed
+// memory. Requests are rounded up to whole pages so that no two blocks share
+// a page: each block is committed on allocation and decommitted on release.
+// Blocks stay page aligned as long as the allocator only serves page-multiple
+// sizes, so it should not be shared with other users. Alignments above the
+// page size, and blocks that come back unaligned, fail with std::bad_alloc.
+//
+template <typename Allocator>
+class memory_resource : public std::pmr::memory_resource {
+public:
+    explicit memory_resource(Allocator &allocator)
+        : allocator_(allocator), page_size_((size_t)sysconf(_SC_PAGESIZE)) {}
+
+    Allocator &upstream() const { return allocator_; }
+
+private:
+    size_t page_round(size_t bytes) const {
+        return bytes ? (bytes + page_size_ - 1) & ~(page_size_ - 1) : page_size_;
+    }
+
+    void *do_allocate(size_t bytes, size_t alignment) override {
+        size_t size = page_round(bytes);
+        uint64_t addr = alignment <= page_size_ ? allocator_.allocate(size) : 0;
+        if (addr && (addr & (page_size_ - 1)) == 0 && allocator_.commit(addr, size) == 0) {
+            return reinterpret_cast<void *>(addr);
+        }
+        if (addr) {
+            allocator_.deallocate(addr);
+        }
+        throw std::bad_alloc();
+    }
+
+    void do_deallocate(void *p, size_t bytes, size_t) override {
+        uint64_t addr = reinterpret_cast<uint64_t>(p);
+        allocator_.decommit(addr, page_round(bytes));
+        allocator_.deallocate(addr);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+        const memory_resource *resource = dynamic_cast<const memory_resource *>(&other);
+        return resource && &resource->allocator_ == &allocator_;
+    }
+
+    Allocator &allocator_;
+    size_t page_size_;
+};
+#endif
+
+} // namespace va
+
+#endif // VA_ALLOCATOR_HPP
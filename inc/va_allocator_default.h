@@ -2,11 +2,14 @@
 #define VA_ALLOCATOR_DEFAULT_H
 
 #include "va_allocator_types.h"
+#include "va_snapshot.h"
 
 #define PHYSICAL_MEMORY_SIZE (1ULL << 31)  // 2GB physical memory
 
 // Forward declaration of ops getter and init for default allocator
-va_allocator_ops_t *get_default_allocator_ops(void);
-void *init_default_allocator(void);
+const va_allocator_ops_t *get_default_allocator_ops(void);
+void *init_default_allocator(const va_allocator_config_t *config);
+// Rebuilds an allocator from the records written by its snapshot op
+void *restore_default_allocator(const va_allocator_config_t *config, va_snapshot_reader_t *reader);
 
 #endif // VA_ALLOCATOR_DEFAULT_H 
\ No newline at end of file
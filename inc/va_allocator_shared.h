@@ -0,0 +1,16 @@
+#ifndef VA_ALLOCATOR_SHARED_H
+#define VA_ALLOCATOR_SHARED_H
+
+#include "va_allocator_types.h"
+
+// Forward declaration of ops getter and init for the shared allocator
+const va_allocator_ops_t *get_shared_allocator_ops(void);
+void *init_shared_allocator(const va_allocator_config_t *config);
+
+// Maps the segment behind 'fd' and reserves its VA range at the same address
+void *attach_shared_allocator(int fd);
+
+// Descriptor of the metadata segment, for handing to other processes
+int shared_allocator_fd(void *impl);
+
+#endif // VA_ALLOCATOR_SHARED_H
@@ -1,16 +1,100 @@
 #ifndef VA_ALLOCATOR_TYPES_H
 #define VA_ALLOCATOR_TYPES_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 // Allocator implementation types
 typedef enum {
     VA_ALLOCATOR_TYPE_DEFAULT,  // Current implementation
     VA_ALLOCATOR_TYPE_ARENA,    // Arena allocator implementation
+    VA_ALLOCATOR_TYPE_SHARED,   // One VA range shared by cooperating processes
     VA_ALLOCATOR_TYPE_MAX
     // Add more types as needed
 } va_allocator_type_t;
 
+// Structure used to find a free extent of at least the requested size
+typedef enum {
+    VA_SIZE_INDEX_RADIX,       // Radix tree on size, exact best fit
+    VA_SIZE_INDEX_SEGREGATED,  // Power-of-two sub-bucketed free lists, O(1) good fit
+    VA_SIZE_INDEX_RADIX_COMPRESSED,  // Path-compressed radix tree, exact best fit
+    VA_SIZE_INDEX_ADDRESS_FIRST_FIT, // Address-ordered tree, lowest-address block that fits
+    VA_SIZE_INDEX_MAX
+} va_size_index_type_t;
+
+// Per-allocator tuning, see va_allocator_config_default()
+typedef struct {
+    va_size_index_type_t size_index;  // Free-extent index for the default allocator and object arenas
+    uint32_t reservation_pool_depth;  // Ready reservations kept per arena, 0 disables the pool
+    int reservation_pool_thread;      // Refill the pools on a background thread rather than inline
+    uint64_t arena_region_size;       // VA reserved up front and carved into arena reservations, 0 maps each separately
+    uint64_t arena_large_cache_size;  // Cap on freed large-object VA kept for reuse, 0 for no cap
+    uint64_t default_chunk_size;      // Initial reservation and minimum growth step of the default allocator
+    uint64_t default_max_size;        // Cap on VA reserved by the default allocator, 0 for no cap
+    uint64_t shared_size;             // VA range of the shared allocator, reserved at init
+    uint32_t arena_deferred_free_batch; // Arena frees queued and coalesced together, 0 frees immediately
+    uint32_t arena_quick_list_depth;  // Freed object blocks kept per exact size for reuse, 0 disables quick lists
+} va_allocator_config_t;
+
+// Snapshot of how the reserved VA is split between live and free extents
+typedef struct {
+    uint64_t reserved_size;  // VA reserved from the OS
+    uint64_t used_size;      // VA handed out to live allocations
+    uint64_t free_size;      // Free VA inside existing reservations
+    uint64_t largest_free;   // Largest extent allocatable without reserving more VA
+    uint64_t free_extents;   // Number of free extents
+    uint64_t committed_size; // VA backed by memory through va_commit()
+    uint64_t metadata_size;  // Bytes of allocator bookkeeping, without malloc overhead
+} va_allocator_frag_stats_t;
+
+// Address range for the batched commit/decommit calls
+typedef struct {
+    uint64_t addr;
+    uint64_t size;
+} va_range_t;
+
+// One move of a compaction plan: the live block at 'src' is to be copied or
+// remapped to 'dst', which the plan has already reserved
+typedef struct {
+    uint64_t src;
+    uint64_t dst;
+    uint64_t size;
+} va_relocation_t;
+
+// Relocation plan from va_compaction_plan(), consumed by va_compaction_apply()
+typedef struct {
+    va_relocation_t *moves;   // Moves that empty the reservations being evacuated
+    size_t move_count;
+    uint64_t reclaim_size;    // VA released if every move is confirmed
+    void *state;              // Owned by the allocator implementation
+} va_compaction_plan_t;
+
+// Moves one block's data; returns 0 once the data lives at move->dst
+typedef int (*va_relocate_fn)(void *ctx, const va_relocation_t *move);
+
+// Internal stages timed when the library is built with VA_STAGE_TIMERS.
+// Stages nest: a reservation scan includes the slab and object work it
+// triggers, so per-stage times do not add up to the call time.
+typedef enum {
+    VA_STAGE_SIZE_CLASS,          // Mapping a request to its arena
+    VA_STAGE_RESERVATION_SCAN,    // Walk of an arena's reservations for free space
+    VA_STAGE_BITMAP_SEARCH,       // Lowest clear bit search in a slab bitmap
+    VA_STAGE_SIZE_INDEX,          // Find, insert and remove in a free-extent size index
+    VA_STAGE_ADDR_LIST,           // Address-ordered block list walks
+    VA_STAGE_RESERVE,             // Creating a reservation or chunk, including its mmap
+    VA_STAGE_RESERVATION_LOOKUP,  // Finding the reservation or chunk of a freed address
+    VA_STAGE_MAX
+} va_stage_t;
+
+// Per-instance stage counters, see va_allocator_get_stage_stats()
+typedef struct {
+    uint64_t calls[VA_STAGE_MAX];   // Times each stage ran
+    uint64_t cycles[VA_STAGE_MAX];  // TSC ticks on x86, nanoseconds elsewhere
+} va_stage_stats_t;
+
+// Snapshot file being written, see va_allocator_snapshot()
+typedef struct va_snapshot_writer va_snapshot_writer_t;
+
 // Function pointer types for allocator operations
 typedef uint64_t (*va_alloc_fn)(void* impl, uint64_t size);
 typedef void (*va_free_fn)(void* impl, uint64_t addr);
@@ -18,8 +102,16 @@ typedef uint64_t (*va_get_total_size_fn)(void* impl);
 typedef uint64_t (*va_get_used_size_fn)(void* impl);
 typedef void (*va_print_fn)(void* impl);
 typedef void (*va_destroy_fn)(void* impl);
+typedef void (*va_get_frag_stats_fn)(void* impl, va_allocator_frag_stats_t *stats);
+typedef int (*va_commit_fn)(void* impl, const va_range_t *ranges, size_t count, int commit);
+typedef uint64_t (*va_get_committed_size_fn)(void* impl);
+typedef int (*va_compact_plan_fn)(void* impl, va_compaction_plan_t *plan);
+typedef uint64_t (*va_compact_apply_fn)(void* impl, va_compaction_plan_t *plan, va_relocate_fn relocate, void *ctx);
+typedef void (*va_snapshot_fn)(void* impl, va_snapshot_writer_t *writer);
+typedef va_stage_stats_t *(*va_stage_stats_fn)(void* impl);
 
-// Structure containing function pointers for allocator operations
+// Function pointers for allocator operations, one constant table per type.
+// Each call takes the instance state, which lives in va_allocator_t.
 typedef struct {
     va_alloc_fn alloc;
     va_free_fn free;
@@ -27,7 +119,13 @@ typedef struct {
     va_get_used_size_fn get_used_size;
     va_print_fn print;
     va_destroy_fn destroy;
-    void* impl;  // Implementation-specific data
+    va_get_frag_stats_fn get_frag_stats;
+    va_commit_fn commit;
+    va_get_committed_size_fn get_committed_size;
+    va_compact_plan_fn compact_plan;
+    va_compact_apply_fn compact_apply;
+    va_snapshot_fn snapshot;
+    va_stage_stats_fn stage_stats;  // Only set when built with VA_STAGE_TIMERS
 } va_allocator_ops_t;
 
 #endif // VA_ALLOCATOR_TYPES_H 
\ No newline at end of file
@@ -0,0 +1,46 @@
+#ifndef VA_COMMIT_H
+#define VA_COMMIT_H
+
+#include "va_allocator_types.h"
+#include "bitvector.h"
+
+//
+// Commit state of one VA reservation.
+//
+// Reservations are mapped PROT_NONE; committing makes pages readable and
+// writable, decommitting drops their contents (MADV_DONTNEED) and maps them
+// PROT_NONE again. A bit per page records which pages are committed so the
+// committed size can be reported, and so calls that change nothing skip the
+// syscalls. The bitvector is only created on the first commit.
+//
+typedef struct va_commit_map {
+    uint64_t base;             // First address of the reservation
+    uint64_t size;             // Size of the reservation
+    CUbitvector *pages;        // Bit per committed page, NULL until first commit
+    uint64_t committed_pages;  // Number of set bits in 'pages'
+} va_commit_map_t;
+
+// Looks up the commit map whose reservation contains [addr, addr + size),
+// or NULL if the range does not lie within a single reservation
+typedef va_commit_map_t *(*va_commit_lookup_fn)(void *impl, uint64_t addr, uint64_t size);
+
+// System page size, read once
+uint64_t va_page_size(void);
+
+void va_commit_map_init(va_commit_map_t *map, uint64_t base, uint64_t size);
+void va_commit_map_deinit(va_commit_map_t *map);
+
+// Bytes currently committed in the map
+uint64_t va_commit_map_committed_size(const va_commit_map_t *map);
+
+//
+// Commits (commit != 0) or decommits a batch of ranges. Ranges are rounded
+// out to whole pages, sorted, and ranges that overlap or touch within the
+// same reservation are merged so each merged range costs one syscall.
+// Every range is validated before any is applied. Returns 0 on success and
+// -1 if a range lies outside the reservations or a syscall fails.
+//
+int va_commit_apply_ranges(void *impl, va_commit_lookup_fn lookup,
+                           const va_range_t *ranges, size_t count, int commit);
+
+#endif // VA_COMMIT_H
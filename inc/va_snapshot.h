@@ -0,0 +1,46 @@
+#ifndef VA_SNAPSHOT_H
+#define VA_SNAPSHOT_H
+
+#include <stdio.h>
+#include "va_allocator_types.h"
+
+//
+// Flat allocator snapshots.
+//
+// A snapshot is a header followed by records made only of uint64_t fields.
+// Records refer to each other by position (a reservation record is followed
+// by its block records), never by pointer, so the file is read in place from
+// a read-only mapping. Addresses in the records are the VA layout itself:
+// restore maps every reservation back at the same address.
+//
+
+struct va_snapshot_writer {
+    FILE *file;
+    int error;                 // Set once any write fails
+};
+
+typedef struct va_snapshot_reader {
+    const unsigned char *data; // Mapped file
+    size_t size;
+    size_t pos;                // Next byte to read
+} va_snapshot_reader_t;
+
+// One extent of a reservation's address-ordered block list. Slab bitmaps are
+// stored as runs of set bits, with 'addr' the first block and 'size' the count.
+typedef struct {
+    uint64_t addr;
+    uint64_t size;
+    uint64_t is_free;
+} va_snapshot_block_t;
+
+void va_snapshot_write(va_snapshot_writer_t *writer, const void *data, size_t size);
+
+// Returns the next 'count' records of 'size' bytes in the mapping, or NULL if
+// the file is too short
+const void *va_snapshot_read(va_snapshot_reader_t *reader, size_t size, uint64_t count);
+
+// Reserves [addr, addr + size) exactly, failing rather than replacing any
+// existing mapping. Returns 0 on success.
+int va_snapshot_reserve_at(uint64_t addr, uint64_t size);
+
+#endif // VA_SNAPSHOT_H
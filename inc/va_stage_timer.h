@@ -0,0 +1,57 @@
+#ifndef VA_STAGE_TIMER_H
+#define VA_STAGE_TIMER_H
+
+#include "va_allocator_types.h"
+
+//
+// Stage timers, compiled in with -DVA_STAGE_TIMERS (cmake -DVA_STAGE_TIMERS=ON).
+//
+// VA_STAGE_TIME(stats, stage, ...) runs the statements in '...' and, when
+// timers are compiled in, adds their duration to stats->cycles[stage] and
+// bumps stats->calls[stage]. Without VA_STAGE_TIMERS it expands to the bare
+// statements and 'stats' is not evaluated. Statements that declare variables
+// or leave the block (return, goto) must stay outside the macro. The clock is
+// the TSC on x86 and CLOCK_MONOTONIC nanoseconds elsewhere; both are
+// unserialized reads, good enough to rank stages over many calls but not to
+// time a single one.
+//
+#ifdef VA_STAGE_TIMERS
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+
+static inline uint64_t
+va_stage_clock(void)
+{
+    return __rdtsc();
+}
+#else
+#include <time.h>
+
+static inline uint64_t
+va_stage_clock(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+#define VA_STAGE_TIME(stats, stage, ...)                         \
+    do {                                                         \
+        uint64_t va_stage_start_ = va_stage_clock();             \
+        __VA_ARGS__;                                             \
+        (stats)->cycles[stage] += va_stage_clock() - va_stage_start_; \
+        (stats)->calls[stage]++;                                 \
+    } while (0)
+
+#else
+
+#define VA_STAGE_TIME(stats, stage, ...) \
+    do {                                 \
+        __VA_ARGS__;                     \
+    } while (0)
+
+#endif // VA_STAGE_TIMERS
+
+#endif // VA_STAGE_TIMER_H
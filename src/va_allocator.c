@@ -2,14 +2,71 @@
 #include "va_allocator.h"
 #include "va_allocator_default.h"
 #include "va_allocator.arenas.h"
+#include "va_allocator_shared.h"
 #include "common.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#define VA_SNAPSHOT_MAGIC 0x003150414e534156ULL  // "VASNAP1" little endian
+#define VA_SNAPSHOT_VERSION 2   // Bump whenever the header or any record changes layout
 
 // Main allocator structure
 struct va_allocator {
-    va_allocator_ops_t* ops;
+    const va_allocator_ops_t *ops;  // Shared by every instance of the type
+    void *impl;                     // State of this instance
+    va_allocator_type_t type;
+    va_allocator_config_t config;
 };
 
+// Leads every snapshot file, followed by the implementation's records. The
+// configuration is written field by field, so the file does not depend on
+// the padding or field order of va_allocator_config_t.
+typedef struct {
+    uint64_t magic;
+    uint64_t version;
+    uint64_t type;
+    uint64_t header_size;               // sizeof(va_snapshot_header_t) of the writer
+    uint64_t size_index;
+    uint64_t reservation_pool_depth;
+    uint64_t reservation_pool_thread;
+    uint64_t arena_region_size;
+    uint64_t arena_large_cache_size;
+    uint64_t default_chunk_size;
+    uint64_t default_max_size;
+    uint64_t shared_size;
+    uint64_t arena_deferred_free_batch;
+    uint64_t arena_quick_list_depth;
+} va_snapshot_header_t;
+
+void
+va_allocator_config_default(va_allocator_config_t *config) {
+    if (!config) {
+        return;
+    }
+    memset(config, 0, sizeof(*config));
+    config->size_index = VA_SIZE_INDEX_RADIX;
+    config->reservation_pool_depth = 0;
+    config->reservation_pool_thread = 0;
+    config->arena_region_size = 0;
+    config->arena_large_cache_size = 0;
+    config->default_chunk_size = 64ULL << 20;
+    config->default_max_size = 0;
+    config->shared_size = 16ULL << 30;
+    config->arena_deferred_free_batch = 0;
+    config->arena_quick_list_depth = 0;
+}
+
 va_allocator_t* va_allocator_init(va_allocator_type_t type) {
+    va_allocator_config_t config;
+    va_allocator_config_default(&config);
+    return va_allocator_init_with_config(type, &config);
+}
+
+va_allocator_t* va_allocator_init_with_config(va_allocator_type_t type, const va_allocator_config_t *config) {
+    if (!config || config->size_index >= VA_SIZE_INDEX_MAX) {
+        return NULL;
+    }
+
     va_allocator_t *allocator = (va_allocator_t *)calloc(1, sizeof(*allocator));
     if (!allocator) {
         return NULL;
@@ -19,22 +76,28 @@ va_allocator_t* va_allocator_init(va_allocator_type_t type) {
     switch (type) {
         case VA_ALLOCATOR_TYPE_DEFAULT:
             allocator->ops = get_default_allocator_ops();
-            allocator->ops->impl = init_default_allocator();
+            allocator->impl = init_default_allocator(config);
             break;
         case VA_ALLOCATOR_TYPE_ARENA:
             allocator->ops = get_arena_allocator_ops();
-            allocator->ops->impl = init_arena_allocator();
+            allocator->impl = init_arena_allocator(config);
+            break;
+        case VA_ALLOCATOR_TYPE_SHARED:
+            allocator->ops = get_shared_allocator_ops();
+            allocator->impl = init_shared_allocator(config);
             break;
         default:
             free(allocator);
             return NULL;
     }
 
-    if (!allocator->ops->impl) {
+    if (!allocator->impl) {
         free(allocator);
         return NULL;
     }
 
+    allocator->type = type;
+    allocator->config = *config;
     return allocator;
 }
 
@@ -45,17 +108,25 @@ va_allocator_destroy(va_allocator_t *allocator) {
     }
 
     if (allocator->ops && allocator->ops->destroy) {
-        allocator->ops->destroy(allocator->ops->impl);
+        allocator->ops->destroy(allocator->impl);
     }   
     free(allocator);
 }
 
+void *
+va_allocator_impl(va_allocator_t *allocator) {
+    if (!allocator || !allocator->ops) {
+        return NULL;
+    }
+    return allocator->impl;
+}
+
 uint64_t
 va_alloc(va_allocator_t *allocator, uint64_t size) {
     if (!allocator || !allocator->ops || !allocator->ops->alloc) {
         return 0;
     }
-    return allocator->ops->alloc(allocator->ops->impl, size);
+    return allocator->ops->alloc(allocator->impl, size);
 }
 
 void
@@ -63,7 +134,7 @@ va_free(va_allocator_t *allocator, uint64_t addr) {
     if (!allocator || !allocator->ops || !allocator->ops->free) {
         return;
     }
-    allocator->ops->free(allocator->ops->impl, addr);
+    allocator->ops->free(allocator->impl, addr);
 }
 
 uint64_t
@@ -71,7 +142,7 @@ va_allocator_get_total_size(va_allocator_t *allocator) {
     if (!allocator || !allocator->ops || !allocator->ops->get_total_size) {
         return 0;
     }
-    return allocator->ops->get_total_size(allocator->ops->impl);
+    return allocator->ops->get_total_size(allocator->impl);
 }
 
 uint64_t
@@ -79,13 +150,270 @@ va_allocator_get_used_size(va_allocator_t *allocator) {
     if (!allocator || !allocator->ops || !allocator->ops->get_used_size) {
         return 0;
     }
-    return allocator->ops->get_used_size(allocator->ops->impl);
+    return allocator->ops->get_used_size(allocator->impl);
+}
+
+uint64_t
+va_allocator_get_committed_size(va_allocator_t *allocator) {
+    if (!allocator || !allocator->ops || !allocator->ops->get_committed_size) {
+        return 0;
+    }
+    return allocator->ops->get_committed_size(allocator->impl);
+}
+
+int
+va_commit_ranges(va_allocator_t *allocator, const va_range_t *ranges, size_t count) {
+    if (!allocator || !allocator->ops || !allocator->ops->commit) {
+        return -1;
+    }
+    return allocator->ops->commit(allocator->impl, ranges, count, 1);
+}
+
+int
+va_decommit_ranges(va_allocator_t *allocator, const va_range_t *ranges, size_t count) {
+    if (!allocator || !allocator->ops || !allocator->ops->commit) {
+        return -1;
+    }
+    return allocator->ops->commit(allocator->impl, ranges, count, 0);
+}
+
+int
+va_commit(va_allocator_t *allocator, uint64_t addr, uint64_t size) {
+    va_range_t range = { addr, size };
+    return va_commit_ranges(allocator, &range, 1);
+}
+
+int
+va_decommit(va_allocator_t *allocator, uint64_t addr, uint64_t size) {
+    va_range_t range = { addr, size };
+    return va_decommit_ranges(allocator, &range, 1);
+}
+
+int
+va_compaction_plan(va_allocator_t *allocator, va_compaction_plan_t *plan) {
+    if (!plan) {
+        return -1;
+    }
+    memset(plan, 0, sizeof(*plan));
+    if (!allocator || !allocator->ops || !allocator->ops->compact_plan) {
+        return -1;
+    }
+    return allocator->ops->compact_plan(allocator->impl, plan);
+}
+
+uint64_t
+va_compaction_apply(va_allocator_t *allocator, va_compaction_plan_t *plan,
+                    va_relocate_fn relocate, void *ctx) {
+    if (!allocator || !plan || !allocator->ops || !allocator->ops->compact_apply) {
+        return 0;
+    }
+    return allocator->ops->compact_apply(allocator->impl, plan, relocate, ctx);
+}
+
+static void
+config_to_snapshot(const va_allocator_config_t *config, va_snapshot_header_t *header) {
+    header->size_index = config->size_index;
+    header->reservation_pool_depth = config->reservation_pool_depth;
+    header->reservation_pool_thread = config->reservation_pool_thread;
+    header->arena_region_size = config->arena_region_size;
+    header->arena_large_cache_size = config->arena_large_cache_size;
+    header->default_chunk_size = config->default_chunk_size;
+    header->default_max_size = config->default_max_size;
+    header->shared_size = config->shared_size;
+    header->arena_deferred_free_batch = config->arena_deferred_free_batch;
+    header->arena_quick_list_depth = config->arena_quick_list_depth;
+}
+
+// Returns -1 if a recorded field does not fit its config field or is one
+// va_allocator_init_with_config() would not have accepted
+static int
+config_from_snapshot(const va_snapshot_header_t *header, va_allocator_config_t *config) {
+    if (header->size_index >= VA_SIZE_INDEX_MAX ||
+        header->reservation_pool_depth > UINT32_MAX ||
+        header->reservation_pool_thread > 1 ||
+        header->arena_deferred_free_batch > UINT32_MAX ||
+        header->arena_quick_list_depth > UINT32_MAX ||
+        header->default_chunk_size == 0 ||
+        (header->default_chunk_size & ((uint64_t)sysconf(_SC_PAGESIZE) - 1)) != 0) {
+        return -1;
+    }
+
+    va_allocator_config_default(config);
+    config->size_index = (va_size_index_type_t)header->size_index;
+    config->reservation_pool_depth = (uint32_t)header->reservation_pool_depth;
+    config->reservation_pool_thread = (int)header->reservation_pool_thread;
+    config->arena_region_size = header->arena_region_size;
+    config->arena_large_cache_size = header->arena_large_cache_size;
+    config->default_chunk_size = header->default_chunk_size;
+    config->default_max_size = header->default_max_size;
+    config->shared_size = header->shared_size;
+    config->arena_deferred_free_batch = (uint32_t)header->arena_deferred_free_batch;
+    config->arena_quick_list_depth = (uint32_t)header->arena_quick_list_depth;
+    return 0;
+}
+
+int
+va_allocator_snapshot(va_allocator_t *allocator, const char *path) {
+    if (!allocator || !path || !allocator->ops || !allocator->ops->snapshot) {
+        return -1;
+    }
+
+    va_snapshot_writer_t writer = { fopen(path, "wb"), 0 };
+    if (!writer.file) {
+        return -1;
+    }
+
+    va_snapshot_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.magic = VA_SNAPSHOT_MAGIC;
+    header.version = VA_SNAPSHOT_VERSION;
+    header.type = allocator->type;
+    header.header_size = sizeof(header);
+    config_to_snapshot(&allocator->config, &header);
+    va_snapshot_write(&writer, &header, sizeof(header));
+    allocator->ops->snapshot(allocator->impl, &writer);
+
+    if (fclose(writer.file) != 0 || writer.error) {
+        unlink(path);
+        return -1;
+    }
+    return 0;
+}
+
+va_allocator_t*
+va_allocator_restore(const char *path) {
+    if (!path) {
+        return NULL;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    void *data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+
+    va_snapshot_reader_t reader = { (const unsigned char *)data, (size_t)st.st_size, 0 };
+    const va_snapshot_header_t *header = (const va_snapshot_header_t *)va_snapshot_read(&reader, sizeof(*header), 1);
+    va_allocator_t *allocator = NULL;
+    va_allocator_config_t config;
+    if (header && header->magic == VA_SNAPSHOT_MAGIC && header->version == VA_SNAPSHOT_VERSION &&
+        header->header_size == sizeof(*header) && header->type <= VA_ALLOCATOR_TYPE_ARENA &&
+        config_from_snapshot(header, &config) == 0) {
+        allocator = (va_allocator_t *)calloc(1, sizeof(*allocator));
+    }
+    if (allocator) {
+        void *impl = NULL;
+        allocator->type = (va_allocator_type_t)header->type;
+        allocator->config = config;
+        if (allocator->type == VA_ALLOCATOR_TYPE_DEFAULT) {
+            allocator->ops = get_default_allocator_ops();
+            impl = restore_default_allocator(&allocator->config, &reader);
+        } else {
+            allocator->ops = get_arena_allocator_ops();
+            impl = restore_arena_allocator(&allocator->config, &reader);
+        }
+        // Trailing bytes mean the file is not what the records describe
+        if (impl && reader.pos != reader.size) {
+            allocator->ops->destroy(impl);
+            impl = NULL;
+        }
+        if (impl) {
+            allocator->impl = impl;
+        } else {
+            free(allocator);
+            allocator = NULL;
+        }
+    }
+
+    munmap(data, (size_t)st.st_size);
+    return allocator;
+}
+
+va_allocator_t*
+va_allocator_shared_attach(int fd) {
+    va_allocator_t *allocator = (va_allocator_t *)calloc(1, sizeof(*allocator));
+    if (!allocator) {
+        return NULL;
+    }
+    void *impl = attach_shared_allocator(fd);
+    if (!impl) {
+        free(allocator);
+        return NULL;
+    }
+    allocator->ops = get_shared_allocator_ops();
+    allocator->impl = impl;
+    allocator->type = VA_ALLOCATOR_TYPE_SHARED;
+    va_allocator_config_default(&allocator->config);
+    return allocator;
+}
+
+int
+va_allocator_shared_fd(va_allocator_t *allocator) {
+    if (!allocator || allocator->type != VA_ALLOCATOR_TYPE_SHARED) {
+        return -1;
+    }
+    return shared_allocator_fd(allocator->impl);
+}
+
+void
+va_allocator_get_frag_stats(va_allocator_t *allocator, va_allocator_frag_stats_t *stats) {
+    if (!stats) {
+        return;
+    }
+    memset(stats, 0, sizeof(*stats));
+    if (!allocator || !allocator->ops || !allocator->ops->get_frag_stats) {
+        return;
+    }
+    allocator->ops->get_frag_stats(allocator->impl, stats);
+}
+
+int
+va_allocator_get_stage_stats(va_allocator_t *allocator, va_stage_stats_t *stats) {
+    if (!stats) {
+        return -1;
+    }
+    memset(stats, 0, sizeof(*stats));
+    if (!allocator || !allocator->ops || !allocator->ops->stage_stats) {
+        return -1;
+    }
+    *stats = *allocator->ops->stage_stats(allocator->impl);
+    return 0;
+}
+
+void
+va_allocator_reset_stage_stats(va_allocator_t *allocator) {
+    if (!allocator || !allocator->ops || !allocator->ops->stage_stats) {
+        return;
+    }
+    memset(allocator->ops->stage_stats(allocator->impl), 0, sizeof(va_stage_stats_t));
+}
+
+const char *
+va_stage_name(va_stage_t stage) {
+    switch (stage) {
+        case VA_STAGE_SIZE_CLASS: return "size class lookup";
+        case VA_STAGE_RESERVATION_SCAN: return "reservation scan";
+        case VA_STAGE_BITMAP_SEARCH: return "bitmap search";
+        case VA_STAGE_SIZE_INDEX: return "size index";
+        case VA_STAGE_ADDR_LIST: return "address list walk";
+        case VA_STAGE_RESERVE: return "reserve (mmap)";
+        case VA_STAGE_RESERVATION_LOOKUP: return "reservation lookup";
+        default: return "unknown";
+    }
 }
 
 void
 va_allocator_print(va_allocator_t *allocator) {
-    if (!allocator || !allocator->ops || !allocator->ops->impl) {
+    if (!allocator || !allocator->ops || !allocator->impl) {
         return;
     }
-    allocator->ops->print(allocator->ops->impl);
+    allocator->ops->print(allocator->impl);
 }
\ No newline at end of file
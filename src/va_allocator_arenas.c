@@ -1,46 +1,106 @@
 #include "va_allocator.arenas.h"
 #include "common.h"
-#include "radix.h"
+#include <pthread.h>
+#include "sizeindex.h"
 #include "bitvector.h"
 #include "addrtracker.h"
+#include "va_commit.h"
+#include "va_stage_timer.h"
 
 #define NUM_ARENAS 8
 
+// Region mode: reservations are carved from one mapping at this granularity,
+// which divides every reservation size in arena_info_table
+#define REGION_GRANULE_SHIFT 21
+#define REGION_GRANULE_SIZE (1ULL << REGION_GRANULE_SHIFT)
+
+// Arena whose allocations each get their own extent, see allocate_large()
+#define LARGE_ARENA_IDX (NUM_ARENAS - 1)
+
+// Quick lists, see push_quick_list(): exact sizes cached per object arena, and
+// the share of a reservation they may hold between them
+#define QUICK_LISTS_PER_ARENA 4
+#define QUICK_LIST_MAX_SHARE 4
+
 // Forward declaration
 typedef struct arena arena_t;
 typedef struct arena_reservation arena_reservation_t;
 
+//
+// Layout: the hot structures below put the fields written on every
+// allocation or free first, and are cache-line aligned, so one call touches
+// as few lines as possible and nothing written by one allocator shares a
+// line with another allocator's state.
+//
+
+// One cache line per slab
 typedef struct slab_allocator {
-    uint64_t block_size;        // Size of each block in the slab
-    uint64_t blocks_per_slab;   // Number of blocks in this slab
     uint64_t free_blocks;       // Number of free blocks
     CUbitvector *bitmap;
+    uint64_t block_size;        // Size of each block in the slab
+    uint64_t blocks_per_slab;   // Number of blocks in this slab
     arena_reservation_t *parent_reservation;
-} slab_allocator_t;
+} CACHE_ALIGNED slab_allocator_t;
+
+// Object reservation blocks, see get_block()
+#define BLOCK_NIL 0                 // Block 0 and node 0 are never used
+#define BLOCK_FREE 0x1              // In the size index, or waiting for a node
+#define BLOCK_QUICK 0x2             // Parked in a quick list, neither live nor coalesced
+#define OBJ_BLOCKS_INITIAL 16
+#define FREE_NODE_CHUNK_SHIFT 4
+#define FREE_NODE_CHUNK (1U << FREE_NODE_CHUNK_SHIFT)
 
 typedef struct va_block {
-    uint64_t start_addr;         // Starting address of the block
-    uint64_t size;               // Size of the block
-    int is_free;                 // Whether the block is free
-    struct va_block *addr_next;  // Next block in address-ordered list
-    struct va_block *addr_prev;  // Previous block in address-ordered list
-    CUradixNode radix_node;      // Node in size-ordered radix tree
+    uint32_t offset;             // Start of the block relative to the reservation
+    uint32_t size;               // Size of the block
+    uint32_t addr_prev;          // Neighbours in address order
+    uint32_t addr_next;
+    uint32_t node;               // Size-index node while free, next unused block while unused
+    uint32_t flags;              // BLOCK_FREE, BLOCK_QUICK, or 0 while live
 } va_block_t;
 
+// Size-index node of a free block
+typedef struct {
+    CUsizeIndexNode size_node;
+    uint32_t block;              // Block it indexes, next unused node while unused
+} free_node_t;
+
 typedef struct {
-    va_block_t *addr_list;      // List ordered by address
-    CUradixTree size_tree;      // Tree ordered by size
+    va_block_t *blocks;          // Block array, grown by doubling
+    uint32_t block_capacity;
+    uint32_t unused_block;       // Unused blocks, linked through 'node'
+    uint32_t addr_head;          // First block in address order
+    uint32_t node_chunk_count;
+    free_node_t **node_chunks;   // Nodes in chunks of FREE_NODE_CHUNK, which never move
+    uint32_t unused_node;        // Unused nodes, linked through 'block'
+    CUsizeIndex size_index;      // Free blocks ordered by size
     arena_reservation_t *parent_reservation;
 } obj_allocator_t;
 
+// The first line holds what the reservation scan and free lookup read, with
+// plan_target filling its spare room. Only compaction writes that.
 typedef struct arena_reservation {
-    uint64_t size;
+    arena_reservation_t *next;
+    void *strategy;
+    arena_t *parent_arena;
     uint64_t addr;
+    uint64_t size;
+    int evacuating;              // Emptied by a pending compaction plan, allocations skip it
+    int in_region;               // Carved from the region rather than mapped on its own
+
+    int plan_target;             // Holds destinations of the compaction plan being built
     CUIaddrTrackerNode node;
-    arena_t *parent_arena;
-    void *strategy;
-    arena_reservation_t *next;
-} arena_reservation_t;
+    va_commit_map_t commit_map;  // Committed pages of the reservation
+} CACHE_ALIGNED arena_reservation_t;
+
+// Exactly sized extent of the large-object arena, live or cached
+typedef struct large_extent {
+    CUIaddrTrackerNode node;     // Node in large_tracker covering the extent
+    CUsizeIndexNode size_node;   // Node in large_cache while the extent is free
+    uint64_t requested;          // Size passed to va_alloc, 0 while cached
+    int is_free;                 // Whether the extent is in the cache
+    va_commit_map_t commit_map;  // Committed pages of the extent
+} large_extent_t;
 
 /*typedef struct arena_object {
     uint64_t addr;
@@ -53,24 +113,75 @@ typedef struct arena_info {
     uint64_t reservation_size;
 } arena_info_t;
 
+typedef struct {
+    obj_allocator_t *oa;
+    uint32_t block;
+} quick_entry_t;
+
+// Freed object blocks of one exact size, kept whole for the next allocation of it
+typedef struct {
+    uint64_t size;               // Size of every block in the list, 0 while the slot is unused
+    quick_entry_t *entries;      // Stack of config.arena_quick_list_depth entries
+    uint32_t count;
+} quick_list_t;
+
+// Read-mostly fields, then those the allocating thread writes, then those
+// the pool thread writes too, each group on its own lines. Arenas never share
+// a line with each other.
 typedef struct arena {
     arena_info_t info; // Arena info: max_per_alloc_size, reservation_size
     uint64_t idx;      // Arena index
     int is_slab;       // Whether the arena is managed by a slab allocator strategy
     void *parent;      // Pointer to the parent allocator
-    arena_reservation_t *reservation_head; // Head of the reservation list
-} arena_t;
+
+    CACHE_ALIGNED arena_reservation_t *reservation_head; // Head of the reservation list
+    uint64_t quick_size;                   // Bytes held across the quick lists
+    quick_list_t quick[QUICK_LISTS_PER_ARENA]; // Object arenas only, see push_quick_list()
+
+    CACHE_ALIGNED arena_reservation_t *pool_head; // Prepared reservations not in use yet
+    uint32_t pool_count;                   // Length of the pool list
+    int pool_enabled;                      // Pool is kept filled once the arena is first used
+} CACHE_ALIGNED arena_t;
 
 //
 // Arena implementation structure
 //
 typedef struct {
     arena_t arenas[NUM_ARENAS];
+
+    // Written on every call
+    CACHE_ALIGNED uint64_t used_va_size; // Currently used VA space
     uint64_t total_va_size;       // Total VA space size
-    uint64_t used_va_size;        // Currently used VA space
-    CUIaddrTracker res_tracker;   // address to reservation tracker.
+    uint64_t *deferred;           // Queued frees, see drain_deferred_frees()
+    uint32_t deferred_count;      // Room for config.arena_deferred_free_batch
+
+    // Read-mostly: free lookups and configuration
+    CACHE_ALIGNED uint64_t region_base; // Start of the region, 0 when region mode is off, see carve_from_region()
+    uint64_t region_size;
+    arena_reservation_t **region_table; // Reservation per granule of the region
+    uint32_t pool_watermark;      // Refill once a pool drops below this many reservations, see take_pooled_reservation()
+    int pool_threaded;            // Pools are refilled by pool_thread
+    CUIaddrTracker res_tracker;   // address to reservation tracker, for reservations outside the region
+    va_allocator_config_t config; // Configuration the allocator was created with
+
+    // Large objects, see allocate_large()
+    CUIaddrTracker large_tracker; // address to large extent, live and cached
+    CUsizeIndex large_cache;      // Cached extents by size
+    uint64_t large_cache_size;    // Bytes of VA in large_cache
+
+    va_stage_stats_t stage_stats; // Only updated when built with VA_STAGE_TIMERS
+
+    // Written by the pool thread too, kept off the lines above
+    CACHE_ALIGNED uint64_t region_used; // Bump offset of the next reservation
+    int pool_stop;                // Asks pool_thread to exit
+    pthread_t pool_thread;
+    pthread_mutex_t pool_lock;    // Protects the pool lists and pool_enabled when threaded
+    pthread_cond_t pool_cond;     // Signalled when a pool drops below the watermark
 } va_allocator_arenas_t;
 
+// Stage counters of the allocator that owns 'arena'
+#define ARENA_STAGE_STATS(arena) (&((va_allocator_arenas_t *)(arena)->parent)->stage_stats)
+
 //
 // Arbitrary arena sizes to reservation table:
 // <= 512b -> 2MB
@@ -80,9 +191,9 @@ typedef struct {
 // <= 64KB -> 32MB
 // <= 2MB -> 64MB
 // <= 32MB -> 512MB
-// > 32MB -> physical memory size
+// > 32MB -> exactly sized extent per allocation
 //
-arena_info_t arena_info_table[NUM_ARENAS] = {
+static const arena_info_t arena_info_table[NUM_ARENAS] = {
     {512UL, 2UL * 1024UL * 1024UL},
     {1024UL, 2UL * 1024UL * 1024UL},
     {2048UL, 4UL * 1024UL * 1024UL},
@@ -90,7 +201,7 @@ arena_info_t arena_info_table[NUM_ARENAS] = {
     {64UL * 1024UL, 32UL * 1024UL * 1024UL},
     {2UL * 1024UL * 1024UL, 64UL * 1024UL * 1024UL},
     {32UL * 1024UL * 1024UL, 512UL * 1024UL * 1024UL},
-    {~0UL, PHYSICAL_MEMORY_SIZE}
+    {~0UL, 0}
 };
 
 //
@@ -138,7 +249,7 @@ initialize_slab(arena_reservation_t *reservation)
 {
     assert(reservation && (reservation->strategy == NULL));
 
-    slab_allocator_t *sa = (slab_allocator_t *)calloc(1, sizeof(*sa));
+    slab_allocator_t *sa = (slab_allocator_t *)calloc_cache_aligned(sizeof(*sa));
     if (!sa) {
         return NULL;
     }
@@ -168,16 +279,20 @@ allocate_from_slab(slab_allocator_t *sa)
     }
 
     NvU64 bit = 0;
-    if (!cubitvectorFindLowestClearBitInRange(sa->bitmap, 0, sa->blocks_per_slab - 1, &bit)) {
+    NvBool found;
+    VA_STAGE_TIME(ARENA_STAGE_STATS(sa->parent_reservation->parent_arena), VA_STAGE_BITMAP_SEARCH,
+                  found = cubitvectorFindLowestClearBitInRange(sa->bitmap, 0, sa->blocks_per_slab - 1, &bit));
+    if (!found) {
         return 0;
     }
     cubitvectorSetBit(sa->bitmap, bit);
     sa->free_blocks--;
 
-    return (sa->parent_reservation->node.addr + (sa->block_size * bit));
+    return (sa->parent_reservation->addr + (sa->block_size * bit));
 }
 
-static void
+// Returns the size of the freed block
+static uint64_t
 free_to_slab(slab_allocator_t *sa, uint64_t addr)
 {
     assert(sa);
@@ -187,86 +302,428 @@ free_to_slab(slab_allocator_t *sa, uint64_t addr)
     uint64_t bit = (addr - sa->parent_reservation->addr) / sa->block_size;
     cubitvectorClearBit(sa->bitmap, bit);
     sa->free_blocks++;
+    return sa->block_size;
 }
 
 //
 // Object allocator functions:
 //
-// initialize_obj_allocator
-// deinitialize_obj_allocator
-// allocate_from_obj_allocator
+// get_block / get_node
+// new_block
+// attach_node
+// index_block / index_block_untimed / unindex_block
+// link_after / unlink_block
+// find_live_block
+// release_block
+// push_quick_list
+// take_quick_list
+// flush_quick_lists
 // free_to_obj_allocator
-// insert_addr_list (Helper function to insert block into address-ordered list)
-// remove_addr_list (Helper function to remove block from address-ordered list)
+// free_batch_to_obj_allocator
+// allocate_from_obj_allocator
+// deinitialize_obj_allocator
+// initialize_obj_allocator
+// obj_metadata_size
+//
+// Blocks are 24-byte records in one array per reservation, linked by index
+// in address order and placed by their offset from the reservation base.
+// Only free blocks need a size-index node. Those come from a separate pool
+// of fixed chunks, because the index holds pointers to them and the block
+// array moves when it grows. Block 0 and node 0 are never used, so zeroed
+// links read as BLOCK_NIL.
 //
+static inline va_block_t *
+get_block(obj_allocator_t *oa, uint32_t idx)
+{
+    return &oa->blocks[idx];
+}
+
+static inline free_node_t *
+get_node(obj_allocator_t *oa, uint32_t idx)
+{
+    return &oa->node_chunks[idx >> FREE_NODE_CHUNK_SHIFT][idx & (FREE_NODE_CHUNK - 1)];
+}
+
+static inline uint64_t
+block_addr(obj_allocator_t *oa, const va_block_t *block)
+{
+    return oa->parent_reservation->addr + block->offset;
+}
+
+// Returns an unused, zeroed block, or BLOCK_NIL. Growing the array moves it,
+// so block pointers taken before the call are stale after it.
+static uint32_t
+new_block(obj_allocator_t *oa)
+{
+    if (oa->unused_block == BLOCK_NIL) {
+        uint32_t capacity = oa->block_capacity ? oa->block_capacity * 2 : OBJ_BLOCKS_INITIAL;
+        va_block_t *blocks = (va_block_t *)realloc(oa->blocks, capacity * sizeof(*blocks));
+        if (!blocks) {
+            return BLOCK_NIL;
+        }
+        uint32_t first = oa->block_capacity ? oa->block_capacity : 1;
+        for (uint32_t i = first; i < capacity; i++) {
+            blocks[i].node = (i + 1 < capacity) ? i + 1 : BLOCK_NIL;
+        }
+        oa->blocks = blocks;
+        oa->block_capacity = capacity;
+        oa->unused_block = first;
+    }
+
+    uint32_t idx = oa->unused_block;
+    va_block_t *block = get_block(oa, idx);
+    oa->unused_block = block->node;
+    memset(block, 0, sizeof(*block));
+    return idx;
+}
+
 static void
-insert_addr_list(obj_allocator_t *oa, va_block_t *block) {
-    va_block_t *current = oa->addr_list;
-    va_block_t *prev = NULL;
-    while (current && current->start_addr < block->start_addr) {
-        prev = current;
-        current = current->addr_next;
-    }
-    block->addr_next = current;
-    block->addr_prev = prev;
-    if (prev) {
-        prev->addr_next = block;
-    } else {
-        oa->addr_list = block;
+drop_block(obj_allocator_t *oa, uint32_t idx)
+{
+    get_block(oa, idx)->node = oa->unused_block;
+    oa->unused_block = idx;
+}
+
+// Gives a free block its size-index node, using 'node' if it is not
+// BLOCK_NIL. Returns NULL when no node can be had.
+static free_node_t *
+attach_node(obj_allocator_t *oa, uint32_t idx, uint32_t node)
+{
+    if (node == BLOCK_NIL && oa->unused_node == BLOCK_NIL) {
+        free_node_t **chunks = (free_node_t **)realloc(oa->node_chunks,
+                                                       (oa->node_chunk_count + 1) * sizeof(*chunks));
+        if (!chunks) {
+            return NULL;
+        }
+        oa->node_chunks = chunks;
+        free_node_t *chunk = (free_node_t *)malloc(FREE_NODE_CHUNK * sizeof(*chunk));
+        if (!chunk) {
+            return NULL;
+        }
+        uint32_t base = oa->node_chunk_count++ << FREE_NODE_CHUNK_SHIFT;
+        chunks[oa->node_chunk_count - 1] = chunk;
+        for (uint32_t i = base ? 0 : 1; i < FREE_NODE_CHUNK; i++) {
+            chunk[i].block = (i + 1 < FREE_NODE_CHUNK) ? base + i + 1 : BLOCK_NIL;
+        }
+        oa->unused_node = base ? base : 1;
     }
-    if (current) {
-        current->addr_prev = block;
+    if (node == BLOCK_NIL) {
+        node = oa->unused_node;
+        oa->unused_node = get_node(oa, node)->block;
     }
+
+    free_node_t *free_node = get_node(oa, node);
+    free_node->block = idx;
+    get_block(oa, idx)->node = node;
+    return free_node;
 }
 
+// Puts a free block in the size index, using 'node' if it is not BLOCK_NIL.
+// Without a node to be had the block stays free but unindexed until it is
+// merged with an indexed neighbour.
 static void
-remove_addr_list(obj_allocator_t *oa, va_block_t *block) {
-    if (block->addr_prev) {
-        block->addr_prev->addr_next = block->addr_next;
-    } else {
-        oa->addr_list = block->addr_next;
+index_block(obj_allocator_t *oa, uint32_t idx, uint32_t node)
+{
+    free_node_t *free_node = attach_node(oa, idx, node);
+    if (!free_node) {
+        return;
+    }
+    va_block_t *block = get_block(oa, idx);
+    VA_STAGE_TIME(ARENA_STAGE_STATS(oa->parent_reservation->parent_arena), VA_STAGE_SIZE_INDEX,
+                  cuSizeIndexInsert(&oa->size_index, &free_node->size_node, block->size, block_addr(oa, block)));
+}
+
+// index_block() for initialize_obj_allocator(), which the reservation pool
+// thread runs and which therefore must not touch the stage counters
+static void
+index_block_untimed(obj_allocator_t *oa, uint32_t idx)
+{
+    free_node_t *free_node = attach_node(oa, idx, BLOCK_NIL);
+    if (!free_node) {
+        return;
     }
-    if (block->addr_next) {
-        block->addr_next->addr_prev = block->addr_prev;
+    va_block_t *block = get_block(oa, idx);
+    cuSizeIndexInsert(&oa->size_index, &free_node->size_node, block->size, block_addr(oa, block));
+}
+
+// Takes a free block out of the size index and returns its node, or BLOCK_NIL
+static uint32_t
+unindex_block(obj_allocator_t *oa, va_block_t *block)
+{
+    uint32_t node = block->node;
+    if (node != BLOCK_NIL) {
+        VA_STAGE_TIME(ARENA_STAGE_STATS(oa->parent_reservation->parent_arena), VA_STAGE_SIZE_INDEX,
+                      cuSizeIndexRemove(&oa->size_index, &get_node(oa, node)->size_node));
+        block->node = BLOCK_NIL;
     }
+    return node;
 }
 
 static void
-free_to_obj_allocator(obj_allocator_t *oa, uint64_t addr)
+put_node(obj_allocator_t *oa, uint32_t node)
 {
-    assert(oa);
-    assert(addr >= oa->parent_reservation->addr);
-    assert(addr < (oa->parent_reservation->addr + oa->parent_reservation->size));
+    if (node != BLOCK_NIL) {
+        get_node(oa, node)->block = oa->unused_node;
+        oa->unused_node = node;
+    }
+}
 
-    va_block_t *block = oa->addr_list;
-    while (block && block->start_addr != addr) {
-        block = block->addr_next;
+static void
+link_after(obj_allocator_t *oa, uint32_t prev_idx, uint32_t idx)
+{
+    va_block_t *prev = get_block(oa, prev_idx);
+    va_block_t *block = get_block(oa, idx);
+    block->addr_prev = prev_idx;
+    block->addr_next = prev->addr_next;
+    if (prev->addr_next != BLOCK_NIL) {
+        get_block(oa, prev->addr_next)->addr_prev = idx;
     }
-    if (!block || block->is_free) {
-        return;
+    prev->addr_next = idx;
+}
+
+// Removes a block from the address list and returns its slot
+static void
+unlink_block(obj_allocator_t *oa, uint32_t idx)
+{
+    va_block_t *block = get_block(oa, idx);
+    if (block->addr_prev != BLOCK_NIL) {
+        get_block(oa, block->addr_prev)->addr_next = block->addr_next;
+    } else {
+        oa->addr_head = block->addr_next;
+    }
+    if (block->addr_next != BLOCK_NIL) {
+        get_block(oa, block->addr_next)->addr_prev = block->addr_prev;
     }
+    drop_block(oa, idx);
+}
+
+// Returns the live block starting at 'addr', or BLOCK_NIL
+static uint32_t
+find_live_block(obj_allocator_t *oa, uint64_t addr)
+{
+    assert(addr >= oa->parent_reservation->addr);
+    assert(addr < (oa->parent_reservation->addr + oa->parent_reservation->size));
 
-    block->is_free = 1;
-    va_block_t *prev = block->addr_prev;
-    va_block_t *next = block->addr_next;
+    uint32_t offset = (uint32_t)(addr - oa->parent_reservation->addr);
+    uint32_t idx = oa->addr_head;
+    VA_STAGE_TIME(ARENA_STAGE_STATS(oa->parent_reservation->parent_arena), VA_STAGE_ADDR_LIST,
+                  while (idx != BLOCK_NIL && oa->blocks[idx].offset != offset) {
+                      idx = oa->blocks[idx].addr_next;
+                  });
+    return (idx != BLOCK_NIL && !oa->blocks[idx].flags) ? idx : BLOCK_NIL;
+}
 
-    assert(!prev || (prev && (block->start_addr == prev->start_addr + prev->size)));
-    if (prev && prev->is_free) {
+// Marks a block free and merges it with its free neighbours into one indexed block
+static void
+release_block(obj_allocator_t *oa, uint32_t idx)
+{
+    va_block_t *block = get_block(oa, idx);
+    uint32_t node = BLOCK_NIL;
+    block->flags = BLOCK_FREE;
+
+    uint32_t prev_idx = block->addr_prev;
+    if (prev_idx != BLOCK_NIL && (get_block(oa, prev_idx)->flags & BLOCK_FREE)) {
+        va_block_t *prev = get_block(oa, prev_idx);
+        assert(block->offset == prev->offset + prev->size);
+        node = unindex_block(oa, prev);
         prev->size += block->size;
-        remove_addr_list(oa, block);
-        radixTreeRemove(&prev->radix_node);
-        free(block);
+        unlink_block(oa, idx);
+        idx = prev_idx;
         block = prev;
     }
 
-    assert(!next || (next && (block->start_addr + block->size == next->start_addr)));
-    if (next && next->is_free) {
+    uint32_t next_idx = block->addr_next;
+    if (next_idx != BLOCK_NIL && (get_block(oa, next_idx)->flags & BLOCK_FREE)) {
+        va_block_t *next = get_block(oa, next_idx);
+        assert(block->offset + block->size == next->offset);
+        uint32_t next_node = unindex_block(oa, next);
+        if (node == BLOCK_NIL) {
+            node = next_node;
+        } else {
+            put_node(oa, next_node);
+        }
         block->size += next->size;
-        remove_addr_list(oa, next);
-        radixTreeRemove(&next->radix_node);
-        free(next);
+        unlink_block(oa, next_idx);
+    }
+    index_block(oa, idx, node);
+}
+
+//
+// Quick lists (config.arena_quick_list_depth): a freed object block whose
+// exact size already has a list in its arena, or can claim a free slot, is
+// parked there whole instead of being coalesced and indexed. An allocation of
+// that size pops it back without touching the size index, splitting or
+// merging. Each list holds up to the configured depth, and all lists of an
+// arena together at most 1/QUICK_LIST_MAX_SHARE of a reservation. Parked
+// blocks pin their space, so they are flushed back into their reservations
+// when an allocation in the arena misses, and before anything walks the
+// block lists (frag stats, compaction planning, snapshots). Blocks of a
+// reservation being evacuated are never parked.
+//
+static int
+push_quick_list(arena_t *arena, obj_allocator_t *oa, uint32_t idx)
+{
+    va_allocator_arenas_t *arena_impl = (va_allocator_arenas_t *)arena->parent;
+    uint32_t depth = arena_impl->config.arena_quick_list_depth;
+    uint64_t size = get_block(oa, idx)->size;
+    if (!depth || arena->quick_size + size > arena->info.reservation_size / QUICK_LIST_MAX_SHARE) {
+        return 0;
+    }
+
+    quick_list_t *list = NULL;
+    for (uint32_t i = 0; i < QUICK_LISTS_PER_ARENA; i++) {
+        if (arena->quick[i].size == size) {
+            list = &arena->quick[i];
+            break;
+        }
+        if (!list && !arena->quick[i].size) {
+            list = &arena->quick[i];
+        }
+    }
+    if (!list || list->count >= depth) {
+        return 0;
+    }
+    if (!list->entries) {
+        list->entries = (quick_entry_t *)malloc(depth * sizeof(*list->entries));
+        if (!list->entries) {
+            return 0;
+        }
+    }
+
+    list->size = size;
+    list->entries[list->count].oa = oa;
+    list->entries[list->count].block = idx;
+    list->count++;
+    get_block(oa, idx)->flags = BLOCK_QUICK;
+    arena->quick_size += size;
+    return 1;
+}
+
+// Returns a parked block of exactly 'size', or 0 if there is none
+static uint64_t
+take_quick_list(arena_t *arena, uint64_t size)
+{
+    for (uint32_t i = 0; i < QUICK_LISTS_PER_ARENA; i++) {
+        quick_list_t *list = &arena->quick[i];
+        if (list->size != size) {
+            continue;
+        }
+        quick_entry_t *entry = &list->entries[--list->count];
+        if (list->count == 0) {
+            list->size = 0;
+        }
+        arena->quick_size -= size;
+        va_block_t *block = get_block(entry->oa, entry->block);
+        block->flags = 0;
+        return block_addr(entry->oa, block);
+    }
+    return 0;
+}
+
+// Returns the bytes flushed back into their reservations
+static uint64_t
+flush_quick_lists(arena_t *arena)
+{
+    uint64_t flushed = arena->quick_size;
+    for (uint32_t i = 0; i < QUICK_LISTS_PER_ARENA && arena->quick_size; i++) {
+        quick_list_t *list = &arena->quick[i];
+        for (uint32_t j = 0; j < list->count; j++) {
+            release_block(list->entries[j].oa, list->entries[j].block);
+        }
+        arena->quick_size -= list->count * list->size;
+        list->size = 0;
+        list->count = 0;
+    }
+    assert(arena->quick_size == 0);
+    return flushed;
+}
+
+// Returns the size of the freed block, or 0 if addr is not a live block
+static uint64_t
+free_to_obj_allocator(obj_allocator_t *oa, uint64_t addr)
+{
+    assert(oa);
+    uint32_t idx = find_live_block(oa, addr);
+    if (idx == BLOCK_NIL) {
+        return 0;
+    }
+
+    uint64_t freed_size = get_block(oa, idx)->size;
+    if (oa->parent_reservation->evacuating || !push_quick_list(oa->parent_reservation->parent_arena, oa, idx)) {
+        release_block(oa, idx);
+    }
+    return freed_size;
+}
+
+//
+// Frees a sorted batch of addresses with one walk of the address list. Each
+// run of blocks that are adjacent, counting free neighbours, collapses into one
+// free block with a single size-index insert, where separate frees would
+// insert and remove once per block. Addresses that are not live blocks are
+// skipped, as free_to_obj_allocator() would. Returns the bytes freed.
+//
+static uint64_t
+free_batch_to_obj_allocator(obj_allocator_t *oa, const uint64_t *addrs, size_t count)
+{
+    assert(oa);
+    va_stage_stats_t *stats = ARENA_STAGE_STATS(oa->parent_reservation->parent_arena);
+    UNUSED(stats);
+    uint64_t base = oa->parent_reservation->addr;
+    uint64_t freed_size = 0;
+    uint32_t idx = oa->addr_head;
+    size_t i = 0;
+    while (i < count) {
+        VA_STAGE_TIME(stats, VA_STAGE_ADDR_LIST,
+                      while (idx != BLOCK_NIL && base + oa->blocks[idx].offset < addrs[i]) {
+                          idx = oa->blocks[idx].addr_next;
+                      });
+        if (idx == BLOCK_NIL || base + get_block(oa, idx)->offset != addrs[i] || get_block(oa, idx)->flags) {
+            i++;
+            continue;
+        }
+
+        // Start a run, merged into the free block before it if there is one
+        uint32_t run_idx = idx;
+        va_block_t *run = get_block(oa, run_idx);
+        uint32_t node = BLOCK_NIL;
+        freed_size += run->size;
+        run->flags = BLOCK_FREE;
+        i++;
+        uint32_t prev_idx = run->addr_prev;
+        if (prev_idx != BLOCK_NIL && (get_block(oa, prev_idx)->flags & BLOCK_FREE)) {
+            va_block_t *prev = get_block(oa, prev_idx);
+            node = unindex_block(oa, prev);
+            prev->size += run->size;
+            unlink_block(oa, run_idx);
+            run_idx = prev_idx;
+            run = prev;
+        }
+
+        // Absorb what follows while it is free or the next address of the batch
+        uint32_t next_idx = run->addr_next;
+        while (next_idx != BLOCK_NIL) {
+            va_block_t *next = get_block(oa, next_idx);
+            if (next->flags & BLOCK_FREE) {
+                uint32_t next_node = unindex_block(oa, next);
+                if (node == BLOCK_NIL) {
+                    node = next_node;
+                } else {
+                    put_node(oa, next_node);
+                }
+            } else if (i < count && addrs[i] == base + next->offset && !next->flags) {
+                freed_size += next->size;
+                i++;
+            } else {
+                break;
+            }
+            run->size += next->size;
+            unlink_block(oa, next_idx);
+            next_idx = run->addr_next;
+        }
+        index_block(oa, run_idx, node);
+        idx = next_idx;
     }
-    radixTreeInsert(&oa->size_tree, &block->radix_node, block->size);
+    return freed_size;
 }
 
 static uint64_t
@@ -274,34 +731,36 @@ allocate_from_obj_allocator(obj_allocator_t *oa, uint64_t size)
 {
     assert(oa);
 
-    CUradixNode *node = radixTreeFindGEQ(&oa->size_tree, size);
-    if (!node) {
+    CUsizeIndexNode *size_node;
+    VA_STAGE_TIME(ARENA_STAGE_STATS(oa->parent_reservation->parent_arena), VA_STAGE_SIZE_INDEX,
+                  size_node = cuSizeIndexFindGEQ(&oa->size_index, size));
+    if (!size_node) {
         return 0;
     }
 
-    va_block_t *best_fit = container_of(node, va_block_t, radix_node);
-    // Split block if necessary
-    if (best_fit->size > size) {
-        va_block_t *new_block = calloc(1, sizeof(*new_block));
-        if (!new_block) {
+    uint32_t best_idx = container_of(size_node, free_node_t, size_node)->block;
+    if (get_block(oa, best_idx)->size > size) {
+        // Split block, the remainder takes over the size-index node
+        uint32_t rest_idx = new_block(oa);
+        if (rest_idx == BLOCK_NIL) {
             return 0;
         }
-        new_block->start_addr = best_fit->start_addr + size;
-        new_block->size = best_fit->size - size;
-        new_block->is_free = 1;
-        new_block->addr_next = NULL;
-        new_block->addr_prev = NULL;
-
-        // Update the best fit block's size to reflect this split
-        best_fit->size = size;
-        insert_addr_list(oa, new_block);
-        radixTreeInsert(&oa->size_tree, &new_block->radix_node, new_block->size);
+        va_block_t *best_fit = get_block(oa, best_idx);
+        va_block_t *rest = get_block(oa, rest_idx);
+        rest->offset = best_fit->offset + (uint32_t)size;
+        rest->size = best_fit->size - (uint32_t)size;
+        rest->flags = BLOCK_FREE;
+        best_fit->size = (uint32_t)size;
+        link_after(oa, best_idx, rest_idx);
+        index_block(oa, rest_idx, unindex_block(oa, best_fit));
+    } else {
+        put_node(oa, unindex_block(oa, get_block(oa, best_idx)));
     }
 
     // Mark the best fit block as in use
-    best_fit->is_free = 0;
-    radixTreeRemove(&best_fit->radix_node);
-    return best_fit->start_addr;
+    va_block_t *best_fit = get_block(oa, best_idx);
+    best_fit->flags = 0;
+    return block_addr(oa, best_fit);
 }
 
 static void
@@ -309,13 +768,11 @@ deinitialize_obj_allocator(obj_allocator_t *oa)
 {
     assert(oa);
 
-    va_block_t *block = oa->addr_list;
-    while (block) {
-        va_block_t *next = block->addr_next;
-        free(block);
-        block = next;
+    for (uint32_t i = 0; i < oa->node_chunk_count; i++) {
+        free(oa->node_chunks[i]);
     }
-
+    free(oa->node_chunks);
+    free(oa->blocks);
     free(oa);
     return;
 }
@@ -324,6 +781,7 @@ static obj_allocator_t *
 initialize_obj_allocator(arena_reservation_t *reservation)
 {
     assert(reservation && (reservation->strategy == NULL));
+    assert(reservation->size <= UINT32_MAX);
 
     obj_allocator_t *oa = (obj_allocator_t *)calloc(1, sizeof(*oa));
     if (!oa) {
@@ -331,41 +789,111 @@ initialize_obj_allocator(arena_reservation_t *reservation)
     }
 
     oa->parent_reservation = reservation;
-    oa->addr_list = NULL;
-    radixTreeInit(&oa->size_tree, 63);  
+    va_allocator_arenas_t *arena_impl = (va_allocator_arenas_t *)reservation->parent_arena->parent;
+    cuSizeIndexInit(&oa->size_index, SIZE_INDEX_KIND(arena_impl->config.size_index));
 
-    va_block_t *block = (va_block_t *)calloc(1, sizeof(*block));
-    if (!block) {
-        free(oa);
+    uint32_t idx = new_block(oa);
+    if (idx == BLOCK_NIL) {
+        deinitialize_obj_allocator(oa);
         return NULL;
     }
 
-    block->start_addr = reservation->addr;
-    block->size = reservation->size;
-    block->is_free = 1;
-    block->addr_next = NULL;
-    block->addr_prev = NULL;  
-    oa->addr_list = block;
-
-    radixTreeInsert(&oa->size_tree, &block->radix_node, block->size);
+    va_block_t *block = get_block(oa, idx);
+    block->offset = 0;
+    block->size = (uint32_t)reservation->size;
+    block->flags = BLOCK_FREE;
+    oa->addr_head = idx;
+    index_block_untimed(oa, idx);
+    if (block->node == BLOCK_NIL) {
+        deinitialize_obj_allocator(oa);
+        return NULL;
+    }
 
     return oa;
 }
 
+// Bytes of bookkeeping held by the allocator, not counting malloc overhead
+static uint64_t
+obj_metadata_size(obj_allocator_t *oa)
+{
+    return sizeof(*oa) + (uint64_t)oa->block_capacity * sizeof(va_block_t) +
+           (uint64_t)oa->node_chunk_count * (sizeof(free_node_t *) + FREE_NODE_CHUNK * sizeof(free_node_t));
+}
+
 //
 // Reservation functions:
 //
+// prepare_reservation
+// publish_reservation
+// release_reservation
 // destroy_reservation
 // create_reservation
-// allocate_from_reservation
 //
+// A reservation is prepared (VA mapped, strategy initialized) before it is
+// published to the address tracker. Preparing only touches the new
+// reservation and read-only arena state, so the pool thread can do it.
+//
+//
+// Region mode:
+//
+// With config.arena_region_size set, one PROT_NONE mapping is made at init
+// and reservations are bump-allocated from it. Reservations are only released
+// at teardown, so the region never needs to reuse space. A granule table maps
+// (addr - base) >> REGION_GRANULE_SHIFT to the reservation, replacing the
+// res_tracker lookup, and destroy unmaps the whole region at once. Once the
+// region is full, reservations fall back to their own mmap and res_tracker.
+//
+
+// Returns the start of 'size' bytes of the region, or 0 if it is full. Lock
+// free, as the pool thread carves concurrently with the allocating thread.
+static uint64_t
+carve_from_region(va_allocator_arenas_t *arena_impl, uint64_t size)
+{
+    if (!arena_impl->region_base) {
+        return 0;
+    }
+
+    uint64_t used = __atomic_load_n(&arena_impl->region_used, __ATOMIC_RELAXED);
+    do {
+        if (size > arena_impl->region_size - used) {
+            return 0;
+        }
+    } while (!__atomic_compare_exchange_n(&arena_impl->region_used, &used, used + size, 1,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    return arena_impl->region_base + used;
+}
+
+static inline int
+addr_in_region(va_allocator_arenas_t *arena_impl, uint64_t addr)
+{
+    return (addr - arena_impl->region_base) < arena_impl->region_size;
+}
+
 static void
-destroy_reservation(arena_reservation_t *reservation)
+set_region_granules(va_allocator_arenas_t *arena_impl, arena_reservation_t *reservation, arena_reservation_t *value)
 {
-    if (!reservation) {
-        return;
+    uint64_t first = (reservation->addr - arena_impl->region_base) >> REGION_GRANULE_SHIFT;
+    uint64_t count = reservation->size >> REGION_GRANULE_SHIFT;
+    for (uint64_t i = 0; i < count; i++) {
+        arena_impl->region_table[first + i] = value;
+    }
+}
+
+// Reservation containing addr, or NULL
+static arena_reservation_t *
+find_reservation(va_allocator_arenas_t *arena_impl, uint64_t addr)
+{
+    if (arena_impl->region_base && addr_in_region(arena_impl, addr)) {
+        return arena_impl->region_table[(addr - arena_impl->region_base) >> REGION_GRANULE_SHIFT];
     }
-    cuiAddrTrackerUnregisterNode(&reservation->node);
+
+    CUIaddrTrackerNode *node = cuiAddrTrackerFindNode(&arena_impl->res_tracker, addr);
+    return node ? (arena_reservation_t *)node->value : NULL;
+}
+
+static void
+release_reservation(arena_reservation_t *reservation)
+{
     if (reservation->parent_arena->is_slab) {
         // Slab allocation
         deinitialize_slab((slab_allocator_t *)reservation->strategy);
@@ -374,99 +902,508 @@ destroy_reservation(arena_reservation_t *reservation)
         deinitialize_obj_allocator((obj_allocator_t *)reservation->strategy);
     }
 
-    FREE_VA(UINT2PTR(reservation->addr), reservation->size);
+    // Region space goes away with the region mapping
+    if (!reservation->in_region) {
+        FREE_VA(UINT2PTR(reservation->addr), reservation->size);
+    }
+    va_commit_map_deinit(&reservation->commit_map);
     memset(reservation, 0, sizeof(*reservation));
     free(reservation);
+}
+
+static void
+destroy_reservation(arena_reservation_t *reservation)
+{
+    if (!reservation) {
+        return;
+    }
+    if (reservation->in_region) {
+        set_region_granules((va_allocator_arenas_t *)reservation->parent_arena->parent, reservation, NULL);
+    } else {
+        cuiAddrTrackerUnregisterNode(&reservation->node);
+    }
+    release_reservation(reservation);
     return;
 }
 
 static arena_reservation_t *
-create_reservation(arena_t *arena)
+prepare_reservation(arena_t *arena)
 {
     assert(arena);
-    arena_reservation_t *reservation = (arena_reservation_t *)calloc(1, sizeof(*reservation));
+    arena_reservation_t *reservation = (arena_reservation_t *)calloc_cache_aligned(sizeof(*reservation));
     if (!reservation) {
         return NULL;
     }
 
-    uint64_t addr = PTR2UINT(RESERVE_VA(arena->info.reservation_size));
-    if (!addr) {
-        free(reservation);
-        return NULL;
+    va_allocator_arenas_t *arena_impl = (va_allocator_arenas_t *)arena->parent;
+    uint64_t addr = carve_from_region(arena_impl, arena->info.reservation_size);
+    if (addr) {
+        reservation->in_region = 1;
+    } else {
+        void *va = RESERVE_VA(arena->info.reservation_size);
+        if (va == MAP_FAILED) {
+            free(reservation);
+            return NULL;
+        }
+        addr = PTR2UINT(va);
     }
 
     reservation->addr = addr;
     reservation->size = arena->info.reservation_size;
     reservation->parent_arena = arena;
+    va_commit_map_init(&reservation->commit_map, addr, reservation->size);
 
     void *strategy = (arena->is_slab) ? (void *)initialize_slab(reservation) 
                                       : (void *)initialize_obj_allocator(reservation);
     if (!strategy) {
-        FREE_VA(UINT2PTR(addr), arena->info.reservation_size);
+        // Carved space is simply leaked to the region
+        if (!reservation->in_region) {
+            FREE_VA(UINT2PTR(addr), arena->info.reservation_size);
+        }
         free(reservation);
         return NULL;
     }
 
     reservation->strategy = strategy;
-    va_allocator_arenas_t *arena_impl = (va_allocator_arenas_t *)arena->parent;
-    cuiAddrTrackerRegisterNode(&arena_impl->res_tracker, &reservation->node, addr, arena->info.reservation_size, reservation);
-    arena_impl->total_va_size += arena->info.reservation_size;
     return reservation;
 }
 
-static uint64_t
-allocate_from_reservation(arena_reservation_t *reservation, uint64_t size)
+static void
+publish_reservation(arena_t *arena, arena_reservation_t *reservation)
 {
-    uint64_t addr = 0;
-    if (!reservation) {
-        return 0;
-    }
-    if (reservation->parent_arena->is_slab) {
-        // Slab allocation
-        addr = allocate_from_slab((slab_allocator_t *)reservation->strategy);
+    va_allocator_arenas_t *arena_impl = (va_allocator_arenas_t *)arena->parent;
+    if (reservation->in_region) {
+        set_region_granules(arena_impl, reservation, reservation);
     } else {
-        // Object allocation
-        addr = allocate_from_obj_allocator((obj_allocator_t *)reservation->strategy, size);
+        cuiAddrTrackerRegisterNode(&arena_impl->res_tracker, &reservation->node, reservation->addr, reservation->size, reservation);
     }
-
-    return addr;
+    arena_impl->total_va_size += reservation->size;
 }
 
 //
-// Arena functions:
+// Reservation pool functions:
 //
-// allocate_from_arena
+// refill_pool
+// refill_pools
+// pool_thread_main
+// take_pooled_reservation
+// drain_pools
 //
-static uint64_t
-allocate_from_arena(arena_t *arena, uint64_t size)
+// With config.reservation_pool_depth set, every arena that has been used
+// keeps up to that many prepared reservations. Taking one only pops a list,
+// so running out of space no longer costs an mmap in the caller. Pools are
+// topped up once they fall below half their depth: by pool_thread, so the
+// allocating thread makes no syscall at all, or else inline by the
+// allocation that took the reservation. An inline refill prepares at most
+// one reservation per call, so a miss never pays for a whole pool's worth
+// of mmaps. As each take then replaces only what it took, an inline pool
+// holds a single reservation ahead of demand whatever its depth.
+//
+
+// Prepares up to 'limit' reservations for the arena's pool, stopping at the
+// pool depth. When threaded, runs with pool_lock held and drops it around
+// each prepare so allocations never wait on mmap.
+static void
+refill_pool(va_allocator_arenas_t *arena_impl, arena_t *arena, uint32_t limit)
 {
-    UNUSED(size);
-    uint64_t addr = 0;
-    arena_reservation_t *reservation = arena->reservation_head;
-    while (reservation) {
-        addr = allocate_from_reservation(reservation, size);
-        if (addr) {
-            goto Done;
+    while (limit-- && arena->pool_enabled && arena->pool_count < arena_impl->config.reservation_pool_depth &&
+           !arena_impl->pool_stop) {
+        if (arena_impl->pool_threaded) {
+            pthread_mutex_unlock(&arena_impl->pool_lock);
+        }
+        arena_reservation_t *reservation = prepare_reservation(arena);
+        if (arena_impl->pool_threaded) {
+            pthread_mutex_lock(&arena_impl->pool_lock);
         }
-        reservation = reservation->next;
+        if (!reservation) {
+            break;
+        }
+        reservation->next = arena->pool_head;
+        arena->pool_head = reservation;
+        arena->pool_count++;
     }
+}
 
-    reservation = create_reservation(arena);
-    if (!reservation) {
-        goto Done;
+// Tops up the pools of every arena in use, see pool_thread_main()
+static void
+refill_pools(va_allocator_arenas_t *arena_impl)
+{
+    for (uint64_t i = 0; i < NUM_ARENAS; i++) {
+        refill_pool(arena_impl, &arena_impl->arenas[i], UINT32_MAX);
     }
-
-    addr = allocate_from_reservation(reservation, size);
-    reservation->next = arena->reservation_head;
-    arena->reservation_head = reservation;
-
-Done:
-    return addr;
+}
+
+static void *
+pool_thread_main(void *arg)
+{
+    va_allocator_arenas_t *arena_impl = (va_allocator_arenas_t *)arg;
+
+    pthread_mutex_lock(&arena_impl->pool_lock);
+    while (!arena_impl->pool_stop) {
+        refill_pools(arena_impl);
+        if (!arena_impl->pool_stop) {
+            pthread_cond_wait(&arena_impl->pool_cond, &arena_impl->pool_lock);
+        }
+    }
+    pthread_mutex_unlock(&arena_impl->pool_lock);
+    return NULL;
+}
+
+// Pops a prepared reservation, or returns NULL if the pool is off or empty
+static arena_reservation_t *
+take_pooled_reservation(arena_t *arena)
+{
+    va_allocator_arenas_t *arena_impl = (va_allocator_arenas_t *)arena->parent;
+    if (arena_impl->config.reservation_pool_depth == 0) {
+        return NULL;
+    }
+
+    if (arena_impl->pool_threaded) {
+        pthread_mutex_lock(&arena_impl->pool_lock);
+    }
+
+    arena->pool_enabled = 1;
+    arena_reservation_t *reservation = arena->pool_head;
+    if (reservation) {
+        arena->pool_head = reservation->next;
+        arena->pool_count--;
+        reservation->next = NULL;
+    }
+
+    int refill = (arena->pool_count < arena_impl->pool_watermark);
+    if (arena_impl->pool_threaded) {
+        if (refill) {
+            pthread_cond_signal(&arena_impl->pool_cond);
+        }
+        pthread_mutex_unlock(&arena_impl->pool_lock);
+    } else if (refill) {
+        refill_pool(arena_impl, arena, 1);
+    }
+    return reservation;
+}
+
+// Stops the pool thread and releases every prepared reservation
+static void
+drain_pools(va_allocator_arenas_t *arena_impl)
+{
+    if (arena_impl->pool_threaded) {
+        pthread_mutex_lock(&arena_impl->pool_lock);
+        arena_impl->pool_stop = 1;
+        pthread_cond_signal(&arena_impl->pool_cond);
+        pthread_mutex_unlock(&arena_impl->pool_lock);
+        pthread_join(arena_impl->pool_thread, NULL);
+        pthread_cond_destroy(&arena_impl->pool_cond);
+        pthread_mutex_destroy(&arena_impl->pool_lock);
+        arena_impl->pool_threaded = 0;
+    }
+
+    for (uint64_t i = 0; i < NUM_ARENAS; i++) {
+        arena_t *arena = &arena_impl->arenas[i];
+        while (arena->pool_head) {
+            arena_reservation_t *next = arena->pool_head->next;
+            release_reservation(arena->pool_head);
+            arena->pool_head = next;
+        }
+        arena->pool_count = 0;
+    }
+}
+
+static arena_reservation_t *
+create_reservation(arena_t *arena)
+{
+    assert(arena);
+    arena_reservation_t *reservation = take_pooled_reservation(arena);
+    if (!reservation) {
+        reservation = prepare_reservation(arena);
+        if (!reservation) {
+            return NULL;
+        }
+    }
+
+    publish_reservation(arena, reservation);
+    return reservation;
+}
+
+static uint64_t
+allocate_from_reservation(arena_reservation_t *reservation, uint64_t size)
+{
+    uint64_t addr = 0;
+    if (!reservation) {
+        return 0;
+    }
+    if (reservation->parent_arena->is_slab) {
+        // Slab allocation
+        addr = allocate_from_slab((slab_allocator_t *)reservation->strategy);
+    } else {
+        // Object allocation
+        addr = allocate_from_obj_allocator((obj_allocator_t *)reservation->strategy, size);
+    }
+
+    return addr;
+}
+
+// Returns the size of the freed block
+static uint64_t
+free_to_reservation(arena_reservation_t *reservation, uint64_t addr)
+{
+    if (reservation->parent_arena->is_slab) {
+        // Slab allocation
+        return free_to_slab((slab_allocator_t *)reservation->strategy, addr);
+    }
+    // Object allocation
+    return free_to_obj_allocator((obj_allocator_t *)reservation->strategy, addr);
+}
+
+static uint32_t drain_deferred_frees(va_allocator_arenas_t *arena_impl);
+
+//
+// Arena functions:
+//
+// scan_reservations
+// allocate_from_arena
+//
+// First fit over the arena's reservations, newest first
+static uint64_t
+scan_reservations(arena_t *arena, uint64_t size)
+{
+    for (arena_reservation_t *reservation = arena->reservation_head; reservation; reservation = reservation->next) {
+        if (!reservation->evacuating) {
+            uint64_t addr = allocate_from_reservation(reservation, size);
+            if (addr) {
+                return addr;
+            }
+        }
+    }
+    return 0;
+}
+
+static uint64_t
+allocate_from_arena(arena_t *arena, uint64_t size)
+{
+    uint64_t addr = 0;
+    arena_reservation_t *reservation = NULL;
+    if (arena->quick_size) {
+        addr = take_quick_list(arena, size);
+        if (addr) {
+            goto Done;
+        }
+    }
+    VA_STAGE_TIME(ARENA_STAGE_STATS(arena), VA_STAGE_RESERVATION_SCAN, addr = scan_reservations(arena, size));
+    // Queued frees and quick lists may hold the space, release them before reserving more
+    if (!addr && drain_deferred_frees((va_allocator_arenas_t *)arena->parent) + flush_quick_lists(arena)) {
+        VA_STAGE_TIME(ARENA_STAGE_STATS(arena), VA_STAGE_RESERVATION_SCAN, addr = scan_reservations(arena, size));
+    }
+    if (addr) {
+        goto Done;
+    }
+
+    VA_STAGE_TIME(ARENA_STAGE_STATS(arena), VA_STAGE_RESERVE, reservation = create_reservation(arena));
+    if (!reservation) {
+        goto Done;
+    }
+
+    addr = allocate_from_reservation(reservation, size);
+    reservation->next = arena->reservation_head;
+    arena->reservation_head = reservation;
+
+Done:
+    return addr;
+}
+
+//
+// Large object functions:
+//
+// large_extent_create
+// large_extent_destroy
+// large_extent_resize
+// allocate_large
+// free_large
+//
+// Allocations above the last object arena get an exactly sized, page-rounded
+// extent of their own rather than a slice of a fixed reservation, so there is
+// no upper bound below the VA limit. Freed extents are decommitted, merged
+// with adjacent cached extents and kept in a size index of the configured
+// kind, up to config.arena_large_cache_size bytes. An allocation takes the
+// cached extent the index finds before mapping anything new, and splits off
+// the tail when it is large enough to serve another large object.
+//
+static int arena_commit(void *impl, const va_range_t *ranges, size_t count, int commit);
+
+static large_extent_t *
+large_extent_create(va_allocator_arenas_t *arena_impl, uint64_t addr, uint64_t size)
+{
+    large_extent_t *extent = (large_extent_t *)calloc(1, sizeof(*extent));
+    if (!extent) {
+        return NULL;
+    }
+    va_commit_map_init(&extent->commit_map, addr, size);
+    cuiAddrTrackerRegisterNode(&arena_impl->large_tracker, &extent->node, addr, size, extent);
+    return extent;
+}
+
+// Unmaps the extent, which must not be in the cache
+static void
+large_extent_destroy(va_allocator_arenas_t *arena_impl, large_extent_t *extent)
+{
+    FREE_VA(UINT2PTR(extent->node.addr), extent->node.size);
+    arena_impl->total_va_size -= extent->node.size;
+    cuiAddrTrackerUnregisterNode(&extent->node);
+    va_commit_map_deinit(&extent->commit_map);
+    free(extent);
+}
+
+// Moves the extent to [addr, addr + size). Only used on extents with nothing committed.
+static void
+large_extent_resize(va_allocator_arenas_t *arena_impl, large_extent_t *extent, uint64_t addr, uint64_t size)
+{
+    assert(extent->commit_map.committed_pages == 0);
+    cuiAddrTrackerUnregisterNode(&extent->node);
+    cuiAddrTrackerRegisterNode(&arena_impl->large_tracker, &extent->node, addr, size, extent);
+    va_commit_map_deinit(&extent->commit_map);
+    va_commit_map_init(&extent->commit_map, addr, size);
+}
+
+static void
+large_cache_insert(va_allocator_arenas_t *arena_impl, large_extent_t *extent)
+{
+    extent->is_free = 1;
+    extent->requested = 0;
+    cuSizeIndexInsert(&arena_impl->large_cache, &extent->size_node, extent->node.size, extent->node.addr);
+    arena_impl->large_cache_size += extent->node.size;
+}
+
+static void
+large_cache_remove(va_allocator_arenas_t *arena_impl, large_extent_t *extent)
+{
+    cuSizeIndexRemove(&arena_impl->large_cache, &extent->size_node);
+    arena_impl->large_cache_size -= extent->node.size;
+    extent->is_free = 0;
+}
+
+static uint64_t
+allocate_large(va_allocator_arenas_t *arena_impl, uint64_t size)
+{
+    uint64_t mask = va_page_size() - 1;
+    if (size > ~mask) {
+        return 0;
+    }
+    uint64_t extent_size = (size + mask) & ~mask;
+
+    large_extent_t *extent = NULL;
+    CUsizeIndexNode *node;
+    VA_STAGE_TIME(&arena_impl->stage_stats, VA_STAGE_SIZE_INDEX,
+                  node = cuSizeIndexFindGEQ(&arena_impl->large_cache, extent_size));
+    if (!node && drain_deferred_frees(arena_impl)) {
+        VA_STAGE_TIME(&arena_impl->stage_stats, VA_STAGE_SIZE_INDEX,
+                      node = cuSizeIndexFindGEQ(&arena_impl->large_cache, extent_size));
+    }
+    if (node) {
+        extent = container_of(node, large_extent_t, size_node);
+        large_cache_remove(arena_impl, extent);
+
+        // Only split off a tail that can serve another large object
+        uint64_t tail_size = extent->node.size - extent_size;
+        if (tail_size > arena_info_table[LARGE_ARENA_IDX - 1].max_per_alloc_size) {
+            uint64_t tail_addr = extent->node.addr + extent_size;
+            large_extent_resize(arena_impl, extent, extent->node.addr, extent_size);
+            large_extent_t *tail = large_extent_create(arena_impl, tail_addr, tail_size);
+            if (tail) {
+                large_cache_insert(arena_impl, tail);
+            } else {
+                // Keep the VA with the allocation rather than lose track of it
+                large_extent_resize(arena_impl, extent, extent->node.addr, extent_size + tail_size);
+            }
+        }
+    } else {
+        void *va;
+        VA_STAGE_TIME(&arena_impl->stage_stats, VA_STAGE_RESERVE, va = RESERVE_VA(extent_size));
+        if (va == MAP_FAILED) {
+            return 0;
+        }
+        extent = large_extent_create(arena_impl, PTR2UINT(va), extent_size);
+        if (!extent) {
+            FREE_VA(va, extent_size);
+            return 0;
+        }
+        arena_impl->total_va_size += extent_size;
+    }
+
+    extent->requested = size;
+    return extent->node.addr;
+}
+
+// Returns the size that was allocated, or 0 if addr is not a live large object
+static uint64_t
+free_large(va_allocator_arenas_t *arena_impl, large_extent_t *extent, uint64_t addr)
+{
+    if (extent->is_free || extent->node.addr != addr) {
+        return 0;
+    }
+    uint64_t freed_size = extent->requested;
+
+    // Cached extents hold no memory, so merging and splitting them is bookkeeping only
+    if (extent->commit_map.committed_pages) {
+        va_range_t range = {extent->node.addr, extent->node.size};
+        arena_commit(arena_impl, &range, 1, 0);
+    }
+
+    uint64_t addr_lo = extent->node.addr;
+    uint64_t addr_hi = extent->node.addr + extent->node.size;
+    CUIaddrTrackerNode *prev_node = cuiAddrTrackerFindNode(&arena_impl->large_tracker, addr_lo - 1);
+    if (prev_node && ((large_extent_t *)prev_node->value)->is_free) {
+        large_extent_t *prev = (large_extent_t *)prev_node->value;
+        large_cache_remove(arena_impl, prev);
+        addr_lo = prev->node.addr;
+        cuiAddrTrackerUnregisterNode(&prev->node);
+        va_commit_map_deinit(&prev->commit_map);
+        free(prev);
+    }
+    CUIaddrTrackerNode *next_node = cuiAddrTrackerFindNode(&arena_impl->large_tracker, addr_hi);
+    if (next_node && ((large_extent_t *)next_node->value)->is_free) {
+        large_extent_t *next = (large_extent_t *)next_node->value;
+        large_cache_remove(arena_impl, next);
+        addr_hi = next->node.addr + next->node.size;
+        cuiAddrTrackerUnregisterNode(&next->node);
+        va_commit_map_deinit(&next->commit_map);
+        free(next);
+    }
+    if (addr_lo != extent->node.addr || addr_hi != extent->node.addr + extent->node.size) {
+        large_extent_resize(arena_impl, extent, addr_lo, addr_hi - addr_lo);
+    }
+
+    uint64_t limit = arena_impl->config.arena_large_cache_size;
+    if (limit && arena_impl->large_cache_size + extent->node.size > limit) {
+        large_extent_destroy(arena_impl, extent);
+    } else {
+        large_cache_insert(arena_impl, extent);
+    }
+    return freed_size;
 }
 
 //
 // Interface functions for the arena allocator
 //
+static uint64_t
+allocate_in_arena_idx(va_allocator_arenas_t *arena_impl, uint64_t arena_idx, uint64_t size)
+{
+    assert(arena_idx < NUM_ARENAS);
+    if (arena_idx == LARGE_ARENA_IDX) {
+        uint64_t addr = allocate_large(arena_impl, size);
+        if (addr) {
+            arena_impl->used_va_size += size;
+        }
+        return addr;
+    }
+
+    arena_t *arena = &arena_impl->arenas[arena_idx];
+    uint64_t addr = allocate_from_arena(arena, size);
+    if (addr) {
+        // Slabs hand out whole blocks, so account for the block rather than the request
+        arena_impl->used_va_size += arena->is_slab ? arena->info.max_per_alloc_size : size;
+    }
+    return addr;
+}
+
 static uint64_t
 arena_alloc(void *impl, uint64_t size)
 {
@@ -475,17 +1412,89 @@ arena_alloc(void *impl, uint64_t size)
         return 0;
     }
 
-    uint64_t arena_idx = get_arena_idx_for_size(size);
-    assert(arena_idx < NUM_ARENAS);
+    uint64_t arena_idx;
+    VA_STAGE_TIME(&arena_impl->stage_stats, VA_STAGE_SIZE_CLASS, arena_idx = get_arena_idx_for_size(size));
+    return allocate_in_arena_idx(arena_impl, arena_idx, size);
+}
 
-    uint64_t addr = allocate_from_arena(&arena_impl->arenas[arena_idx], size);
-    if (addr) {
-        // Note: This is not quite right because the actual size of the block may be different
-        // from the requested size. For example the slab allocator may return a block of size 4KB
-        // even if the requested size is 1KB. But this is good enough for a prototype.
-        arena_impl->used_va_size += size;
+static void
+free_now(va_allocator_arenas_t *arena_impl, uint64_t addr)
+{
+    arena_reservation_t *reservation;
+    CUIaddrTrackerNode *node = NULL;
+    VA_STAGE_TIME(&arena_impl->stage_stats, VA_STAGE_RESERVATION_LOOKUP,
+                  reservation = find_reservation(arena_impl, addr);
+                  if (!reservation) {
+                      node = cuiAddrTrackerFindNode(&arena_impl->large_tracker, addr);
+                  });
+    if (!reservation) {
+        if (!node) {
+            assert(0);
+            return;
+        }
+        arena_impl->used_va_size -= free_large(arena_impl, (large_extent_t *)node->value, addr);
+        return;
+    }
+
+    arena_impl->used_va_size -= free_to_reservation(reservation, addr);
+    return;
+}
+
+static int
+compare_addrs(const void *a, const void *b)
+{
+    uint64_t lhs = *(const uint64_t *)a;
+    uint64_t rhs = *(const uint64_t *)b;
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+//
+// Deferred frees (config.arena_deferred_free_batch): arena_free() only queues
+// the address. The queue is drained when it is full, when an allocation finds
+// no space, and before anything reports or walks the allocator's state. A
+// drain sorts the queue, so each object reservation gets its frees as one
+// ascending batch that free_batch_to_obj_allocator() handles in a single
+// pass. Slab and large-object frees are released one by one. Returns the
+// number of frees drained.
+//
+static uint32_t
+drain_deferred_frees(va_allocator_arenas_t *arena_impl)
+{
+    uint32_t count = arena_impl->deferred_count;
+    if (!count) {
+        return 0;
+    }
+    arena_impl->deferred_count = 0;
+
+    uint64_t *addrs = arena_impl->deferred;
+    qsort(addrs, count, sizeof(*addrs), compare_addrs);
+    for (uint32_t i = 0; i < count;) {
+        arena_reservation_t *reservation = find_reservation(arena_impl, addrs[i]);
+        if (!reservation || reservation->parent_arena->is_slab) {
+            free_now(arena_impl, addrs[i]);
+            i++;
+            continue;
+        }
+        uint32_t end = i + 1;
+        while (end < count && addrs[end] - reservation->addr < reservation->size) {
+            end++;
+        }
+        arena_impl->used_va_size -=
+            free_batch_to_obj_allocator((obj_allocator_t *)reservation->strategy, addrs + i, end - i);
+        i = end;
+    }
+    return count;
+}
+
+// Returns queued frees and quick-list blocks to their reservations, so the
+// block lists show every free extent
+static void
+release_held_blocks(va_allocator_arenas_t *arena_impl)
+{
+    drain_deferred_frees(arena_impl);
+    for (uint64_t i = 0; i < LARGE_ARENA_IDX; i++) {
+        flush_quick_lists(&arena_impl->arenas[i]);
     }
-    return addr;
 }
 
 static void
@@ -496,22 +1505,22 @@ arena_free(void *impl, uint64_t addr)
         return;
     }
 
-    CUIaddrTrackerNode *node = cuiAddrTrackerFindNode(&arena_impl->res_tracker, addr);
-    if (!node) {
-        assert(0);
+    uint32_t batch = arena_impl->config.arena_deferred_free_batch;
+    if (!batch) {
+        free_now(arena_impl, addr);
         return;
     }
-
-    arena_reservation_t *reservation = (arena_reservation_t *)node->value;
-    if (reservation->parent_arena->is_slab) {
-        // Slab allocation
-        free_to_slab((slab_allocator_t *)reservation->strategy, addr);
-    } else {
-        // Object allocation
-        free_to_obj_allocator((obj_allocator_t *)reservation->strategy, addr);
+    if (!arena_impl->deferred) {
+        arena_impl->deferred = (uint64_t *)malloc(batch * sizeof(*arena_impl->deferred));
+        if (!arena_impl->deferred) {
+            free_now(arena_impl, addr);
+            return;
+        }
+    }
+    arena_impl->deferred[arena_impl->deferred_count++] = addr;
+    if (arena_impl->deferred_count == batch) {
+        drain_deferred_frees(arena_impl);
     }
-    arena_impl->used_va_size -= node->size;
-    return;
 }
 
 static uint64_t
@@ -534,9 +1543,60 @@ arena_get_used_size(void *impl)
         return 0;
     }
 
+    drain_deferred_frees(arena_impl);
     return arena_impl->used_va_size;
 }
 
+static va_commit_map_t *
+arena_commit_lookup(void *impl, uint64_t addr, uint64_t size)
+{
+    va_allocator_arenas_t *arena_impl = (va_allocator_arenas_t *)impl;
+    arena_reservation_t *reservation = find_reservation(arena_impl, addr);
+    if (!reservation) {
+        // Cached extents are not handed out, so they cannot be committed
+        CUIaddrTrackerNode *node = cuiAddrTrackerFindNode(&arena_impl->large_tracker, addr);
+        large_extent_t *extent = node ? (large_extent_t *)node->value : NULL;
+        if (!extent || extent->is_free || size > node->size || addr - node->addr > node->size - size) {
+            return NULL;
+        }
+        return &extent->commit_map;
+    }
+    if (size > reservation->size || addr - reservation->addr > reservation->size - size) {
+        return NULL;
+    }
+    return &reservation->commit_map;
+}
+
+static int
+arena_commit(void *impl, const va_range_t *ranges, size_t count, int commit)
+{
+    return va_commit_apply_ranges(impl, arena_commit_lookup, ranges, count, commit);
+}
+
+static uint64_t
+arena_get_committed_size(void *impl)
+{
+    va_allocator_arenas_t *arena_impl = (va_allocator_arenas_t *)impl;
+    if (!arena_impl) {
+        return 0;
+    }
+
+    drain_deferred_frees(arena_impl);
+    uint64_t committed = 0;
+    for (uint64_t i = 0; i < NUM_ARENAS; i++) {
+        arena_reservation_t *reservation = arena_impl->arenas[i].reservation_head;
+        for (; reservation; reservation = reservation->next) {
+            committed += va_commit_map_committed_size(&reservation->commit_map);
+        }
+    }
+
+    CUIaddrTrackerNode *node = cuiAddrTrackerFindFirstNodeInRange(&arena_impl->large_tracker, 0, 1ULL << 57);
+    for (; node; node = cuiAddrTrackerNodeNext(node)) {
+        committed += va_commit_map_committed_size(&((large_extent_t *)node->value)->commit_map);
+    }
+    return committed;
+}
+
 static void
 arena_destroy(void *impl)
 {
@@ -545,8 +1605,15 @@ arena_destroy(void *impl)
         return;
     }
 
+    // Slabs must be empty when torn down
+    drain_deferred_frees(arena_impl);
+    free(arena_impl->deferred);
+
     for (uint64_t i = 0; i < NUM_ARENAS; i++) {
         arena_t *arena = &arena_impl->arenas[i];
+        for (uint32_t j = 0; j < QUICK_LISTS_PER_ARENA; j++) {
+            free(arena->quick[j].entries);
+        }
         arena_reservation_t *reservation = arena->reservation_head;
         while (reservation) {
             arena_reservation_t *next = reservation->next;
@@ -556,11 +1623,740 @@ arena_destroy(void *impl)
         arena->reservation_head = NULL;
     }
 
+    CUIaddrTrackerNode *node = cuiAddrTrackerFindFirstNodeInRange(&arena_impl->large_tracker, 0, 1ULL << 57);
+    while (node) {
+        large_extent_t *extent = (large_extent_t *)node->value;
+        node = cuiAddrTrackerNodeNext(node);
+        if (extent->is_free) {
+            large_cache_remove(arena_impl, extent);
+        }
+        large_extent_destroy(arena_impl, extent);
+    }
+    cuiAddrTrackerDeinit(&arena_impl->large_tracker);
+
+    drain_pools(arena_impl);
+    if (arena_impl->region_base) {
+        FREE_VA(UINT2PTR(arena_impl->region_base), arena_impl->region_size);
+        free(arena_impl->region_table);
+    }
     cuiAddrTrackerDeinit(&arena_impl->res_tracker);
     free(arena_impl);
     return;
 }
 
+// Bytes of bookkeeping behind a reservation, including its strategy
+static uint64_t
+reservation_metadata_size(arena_reservation_t *reservation)
+{
+    uint64_t size = sizeof(*reservation);
+    if (reservation->parent_arena->is_slab) {
+        slab_allocator_t *sa = (slab_allocator_t *)reservation->strategy;
+        return size + sizeof(*sa) + (sa->blocks_per_slab + 7) / 8;
+    }
+    return size + obj_metadata_size((obj_allocator_t *)reservation->strategy);
+}
+
+static void
+arena_get_frag_stats(void *impl, va_allocator_frag_stats_t *stats)
+{
+    va_allocator_arenas_t *arena_impl = (va_allocator_arenas_t *)impl;
+    if (!arena_impl) {
+        return;
+    }
+
+    release_held_blocks(arena_impl);
+    stats->reserved_size = arena_impl->total_va_size;
+    stats->used_size = arena_impl->used_va_size;
+    stats->committed_size = arena_get_committed_size(impl);
+    stats->metadata_size = sizeof(*arena_impl);
+    if (arena_impl->region_base) {
+        stats->metadata_size += (arena_impl->region_size >> REGION_GRANULE_SHIFT) * sizeof(arena_reservation_t *);
+    }
+    for (uint64_t i = 0; i < NUM_ARENAS; i++) {
+        arena_t *arena = &arena_impl->arenas[i];
+        for (uint32_t j = 0; j < QUICK_LISTS_PER_ARENA; j++) {
+            if (arena->quick[j].entries) {
+                stats->metadata_size += arena_impl->config.arena_quick_list_depth * sizeof(quick_entry_t);
+            }
+        }
+        if (arena_impl->pool_threaded) {
+            pthread_mutex_lock(&arena_impl->pool_lock);
+        }
+        for (arena_reservation_t *reservation = arena->pool_head; reservation; reservation = reservation->next) {
+            stats->metadata_size += reservation_metadata_size(reservation);
+        }
+        if (arena_impl->pool_threaded) {
+            pthread_mutex_unlock(&arena_impl->pool_lock);
+        }
+        for (arena_reservation_t *reservation = arena->reservation_head; reservation; reservation = reservation->next) {
+            stats->metadata_size += reservation_metadata_size(reservation);
+            if (arena->is_slab) {
+                slab_allocator_t *sa = (slab_allocator_t *)reservation->strategy;
+                stats->free_size += sa->free_blocks * sa->block_size;
+                stats->free_extents += sa->free_blocks;
+                if (sa->free_blocks && sa->block_size > stats->largest_free) {
+                    stats->largest_free = sa->block_size;
+                }
+                continue;
+            }
+
+            obj_allocator_t *oa = (obj_allocator_t *)reservation->strategy;
+            for (uint32_t idx = oa->addr_head; idx != BLOCK_NIL; idx = oa->blocks[idx].addr_next) {
+                const va_block_t *block = get_block(oa, idx);
+                if (!(block->flags & BLOCK_FREE)) {
+                    continue;
+                }
+                stats->free_size += block->size;
+                stats->free_extents++;
+                if (block->size > stats->largest_free) {
+                    stats->largest_free = block->size;
+                }
+            }
+        }
+    }
+
+    CUIaddrTrackerNode *node = cuiAddrTrackerFindFirstNodeInRange(&arena_impl->large_tracker, 0, 1ULL << 57);
+    for (; node; node = cuiAddrTrackerNodeNext(node)) {
+        large_extent_t *extent = (large_extent_t *)node->value;
+        stats->metadata_size += sizeof(*extent);
+        if (!extent->is_free) {
+            // Page rounding and unsplit tails are free space nothing else can use
+            stats->free_size += node->size - extent->requested;
+            continue;
+        }
+        stats->free_size += node->size;
+        stats->free_extents++;
+        if (node->size > stats->largest_free) {
+            stats->largest_free = node->size;
+        }
+    }
+}
+
+//
+// Compaction functions:
+//
+// reservation_live_size
+// reservation_is_empty
+// allocate_for_plan
+// plan_evacuation
+// plan_arena_compaction
+// arena_compact_plan
+// arena_compact_apply
+//
+// A plan empties whole reservations, least occupied first. A reservation is
+// only picked if all its live blocks fit into the other reservations of its
+// arena, fullest first, without creating new ones. Destinations are allocated
+// while planning so that allocations made before the plan is applied cannot
+// take them, and picked reservations are marked evacuating so those
+// allocations stay out of them. A reservation that received destinations is
+// not evacuated by the same plan. Region reservations are left alone, as their
+// space cannot be returned.
+//
+typedef struct {
+    arena_reservation_t *reservation;
+    uint64_t live_size;
+} compaction_candidate_t;
+
+typedef struct {
+    arena_reservation_t **victims;  // Reservations being evacuated
+    size_t victim_count;
+    size_t victim_capacity;
+    size_t move_capacity;
+} compaction_state_t;
+
+static uint64_t
+reservation_live_size(arena_reservation_t *reservation)
+{
+    if (reservation->parent_arena->is_slab) {
+        slab_allocator_t *sa = (slab_allocator_t *)reservation->strategy;
+        return (sa->blocks_per_slab - sa->free_blocks) * sa->block_size;
+    }
+
+    uint64_t live = 0;
+    obj_allocator_t *oa = (obj_allocator_t *)reservation->strategy;
+    for (uint32_t idx = oa->addr_head; idx != BLOCK_NIL; idx = oa->blocks[idx].addr_next) {
+        live += (oa->blocks[idx].flags & BLOCK_FREE) ? 0 : oa->blocks[idx].size;
+    }
+    return live;
+}
+
+static int
+reservation_is_empty(arena_reservation_t *reservation)
+{
+    if (reservation->parent_arena->is_slab) {
+        slab_allocator_t *sa = (slab_allocator_t *)reservation->strategy;
+        return sa->free_blocks == sa->blocks_per_slab;
+    }
+    obj_allocator_t *oa = (obj_allocator_t *)reservation->strategy;
+    const va_block_t *head = get_block(oa, oa->addr_head);
+    return (head->flags & BLOCK_FREE) && head->addr_next == BLOCK_NIL;
+}
+
+static int
+compare_candidates(const void *a, const void *b)
+{
+    uint64_t la = ((const compaction_candidate_t *)a)->live_size;
+    uint64_t lb = ((const compaction_candidate_t *)b)->live_size;
+    return (la < lb) ? -1 : (la > lb) ? 1 : 0;
+}
+
+// Allocates 'size' in the fullest reservation that can take it and is not evacuating
+static uint64_t
+allocate_for_plan(compaction_candidate_t *candidates, size_t count, uint64_t size)
+{
+    for (size_t i = count; i-- > 0;) {
+        arena_reservation_t *reservation = candidates[i].reservation;
+        if (reservation->evacuating) {
+            continue;
+        }
+        uint64_t addr = allocate_from_reservation(reservation, size);
+        if (addr) {
+            reservation->plan_target = 1;
+            return addr;
+        }
+    }
+    return 0;
+}
+
+static int
+append_move(va_compaction_plan_t *plan, compaction_state_t *state, uint64_t src, uint64_t dst, uint64_t size)
+{
+    if (plan->move_count == state->move_capacity) {
+        size_t capacity = state->move_capacity ? state->move_capacity * 2 : 64;
+        va_relocation_t *moves = (va_relocation_t *)realloc(plan->moves, capacity * sizeof(*moves));
+        if (!moves) {
+            return -1;
+        }
+        plan->moves = moves;
+        state->move_capacity = capacity;
+    }
+    va_relocation_t *move = &plan->moves[plan->move_count++];
+    move->src = src;
+    move->dst = dst;
+    move->size = size;
+    return 0;
+}
+
+// Plans a destination for every live block of 'victim', or none of them
+static int
+plan_evacuation(va_compaction_plan_t *plan, compaction_state_t *state, arena_reservation_t *victim,
+                compaction_candidate_t *candidates, size_t count)
+{
+    va_allocator_arenas_t *arena_impl = (va_allocator_arenas_t *)victim->parent_arena->parent;
+    size_t first_move = plan->move_count;
+    int status = 0;
+
+    victim->evacuating = 1;
+    if (victim->parent_arena->is_slab) {
+        slab_allocator_t *sa = (slab_allocator_t *)victim->strategy;
+        NvU64 bit = 0;
+        NvU64 pos = 0;
+        while (status == 0 && pos < sa->blocks_per_slab &&
+               cubitvectorFindLowestSetBitInRange(sa->bitmap, pos, sa->blocks_per_slab - 1, &bit)) {
+            uint64_t src = victim->addr + bit * sa->block_size;
+            uint64_t dst = allocate_for_plan(candidates, count, sa->block_size);
+            status = (dst && append_move(plan, state, src, dst, sa->block_size) == 0) ? 0 : -1;
+            if (status != 0 && dst) {
+                free_to_reservation(find_reservation(arena_impl, dst), dst);
+            }
+            pos = bit + 1;
+        }
+    } else {
+        obj_allocator_t *oa = (obj_allocator_t *)victim->strategy;
+        for (uint32_t idx = oa->addr_head; idx != BLOCK_NIL && status == 0; idx = oa->blocks[idx].addr_next) {
+            const va_block_t *block = get_block(oa, idx);
+            if (block->flags & BLOCK_FREE) {
+                continue;
+            }
+            uint64_t dst = allocate_for_plan(candidates, count, block->size);
+            status = (dst && append_move(plan, state, block_addr(oa, block), dst, block->size) == 0) ? 0 : -1;
+            if (status != 0 && dst) {
+                free_to_reservation(find_reservation(arena_impl, dst), dst);
+            }
+        }
+    }
+
+    if (status == 0 && state->victim_count == state->victim_capacity) {
+        size_t capacity = state->victim_capacity ? state->victim_capacity * 2 : 16;
+        arena_reservation_t **victims = (arena_reservation_t **)realloc(state->victims, capacity * sizeof(*victims));
+        if (victims) {
+            state->victims = victims;
+            state->victim_capacity = capacity;
+        } else {
+            status = -1;
+        }
+    }
+
+    if (status != 0) {
+        for (size_t i = first_move; i < plan->move_count; i++) {
+            free_to_reservation(find_reservation(arena_impl, plan->moves[i].dst), plan->moves[i].dst);
+        }
+        plan->move_count = first_move;
+        victim->evacuating = 0;
+        return -1;
+    }
+
+    state->victims[state->victim_count++] = victim;
+    plan->reclaim_size += victim->size;
+    return 0;
+}
+
+static int
+plan_arena_compaction(va_compaction_plan_t *plan, compaction_state_t *state, arena_t *arena)
+{
+    size_t count = 0;
+    for (arena_reservation_t *reservation = arena->reservation_head; reservation; reservation = reservation->next) {
+        count += reservation->in_region ? 0 : 1;
+    }
+    if (count == 0) {
+        return 0;
+    }
+
+    compaction_candidate_t *candidates = (compaction_candidate_t *)malloc(count * sizeof(*candidates));
+    if (!candidates) {
+        return -1;
+    }
+    size_t i = 0;
+    for (arena_reservation_t *reservation = arena->reservation_head; reservation; reservation = reservation->next) {
+        if (!reservation->in_region) {
+            candidates[i].reservation = reservation;
+            candidates[i].live_size = reservation_live_size(reservation);
+            i++;
+        }
+    }
+    qsort(candidates, count, sizeof(*candidates), compare_candidates);
+
+    // Stop at the first reservation that does not fit: fuller ones fit even less
+    for (i = 0; i < count; i++) {
+        if (candidates[i].reservation->plan_target ||
+            plan_evacuation(plan, state, candidates[i].reservation, candidates, count) != 0) {
+            break;
+        }
+    }
+
+    for (i = 0; i < count; i++) {
+        candidates[i].reservation->plan_target = 0;
+    }
+    free(candidates);
+    return 0;
+}
+
+static uint64_t arena_compact_apply(void *impl, va_compaction_plan_t *plan, va_relocate_fn relocate, void *ctx);
+
+static int
+arena_compact_plan(void *impl, va_compaction_plan_t *plan)
+{
+    va_allocator_arenas_t *arena_impl = (va_allocator_arenas_t *)impl;
+    if (!arena_impl) {
+        return -1;
+    }
+
+    release_held_blocks(arena_impl);
+    compaction_state_t *state = (compaction_state_t *)calloc(1, sizeof(*state));
+    if (!state) {
+        return -1;
+    }
+    plan->state = state;
+
+    // Large objects each have their own extent, there is nothing to empty
+    for (uint64_t i = 0; i < LARGE_ARENA_IDX; i++) {
+        if (plan_arena_compaction(plan, state, &arena_impl->arenas[i]) != 0) {
+            arena_compact_apply(impl, plan, NULL, NULL);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static uint64_t
+arena_compact_apply(void *impl, va_compaction_plan_t *plan, va_relocate_fn relocate, void *ctx)
+{
+    va_allocator_arenas_t *arena_impl = (va_allocator_arenas_t *)impl;
+    compaction_state_t *state = (compaction_state_t *)plan->state;
+    if (!arena_impl || !state) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < plan->move_count; i++) {
+        const va_relocation_t *move = &plan->moves[i];
+        if (relocate && relocate(ctx, move) == 0) {
+            // Not arena_free(), a queued free would leave the victim in use
+            arena_impl->used_va_size += move->size;
+            free_now(arena_impl, move->src);
+        } else {
+            free_to_reservation(find_reservation(arena_impl, move->dst), move->dst);
+        }
+    }
+
+    uint64_t released = 0;
+    for (size_t i = 0; i < state->victim_count; i++) {
+        arena_reservation_t *victim = state->victims[i];
+        victim->evacuating = 0;
+        if (!reservation_is_empty(victim)) {
+            continue;
+        }
+
+        arena_reservation_t **link = &victim->parent_arena->reservation_head;
+        while (*link != victim) {
+            link = &(*link)->next;
+        }
+        *link = victim->next;
+        arena_impl->total_va_size -= victim->size;
+        released += victim->size;
+        destroy_reservation(victim);
+    }
+
+    free(state->victims);
+    free(state);
+    free(plan->moves);
+    memset(plan, 0, sizeof(*plan));
+    return released;
+}
+
+//
+// Snapshot functions:
+//
+// arena_snapshot
+// validate_reservation_blocks
+// restore_reservation
+// restore_large_extent
+// restore_arena_allocator
+//
+// Records: the header, then each reservation of arenas 0..6 in list order
+// followed by its blocks (object arenas) or runs of set bits (slabs), then the
+// large extents in address order. Pooled reservations and pending compaction
+// plans are not recorded. Restore validates every record before mapping it,
+// builds each block list in a single pass and recomputes the totals.
+//
+typedef struct {
+    uint64_t region_base;
+    uint64_t region_size;
+    uint64_t region_used;
+    uint64_t reservation_count;
+    uint64_t large_count;
+} arena_snapshot_t;
+
+typedef struct {
+    uint64_t arena_idx;
+    uint64_t addr;
+    uint64_t size;
+    uint64_t in_region;
+    uint64_t block_count;
+} arena_reservation_record_t;
+
+typedef struct {
+    uint64_t addr;
+    uint64_t size;
+    uint64_t requested;  // 0 for a cached extent
+} arena_large_record_t;
+
+static void
+snapshot_slab_runs(slab_allocator_t *sa, va_snapshot_writer_t *writer, uint64_t *count)
+{
+    NvU64 pos = 0;
+    NvU64 start = 0;
+    NvU64 end = 0;
+    while (pos < sa->blocks_per_slab &&
+           cubitvectorFindLowestSetBitInRange(sa->bitmap, pos, sa->blocks_per_slab - 1, &start)) {
+        if (!cubitvectorFindLowestClearBitInRange(sa->bitmap, start, sa->blocks_per_slab - 1, &end)) {
+            end = sa->blocks_per_slab;
+        }
+        if (writer) {
+            va_snapshot_block_t run = { start, end - start, 0 };
+            va_snapshot_write(writer, &run, sizeof(run));
+        }
+        (*count)++;
+        pos = end;
+    }
+}
+
+static void
+arena_snapshot(void *impl, va_snapshot_writer_t *writer)
+{
+    va_allocator_arenas_t *arena_impl = (va_allocator_arenas_t *)impl;
+    release_held_blocks(arena_impl);
+    arena_snapshot_t header = { arena_impl->region_base, arena_impl->region_size,
+                                __atomic_load_n(&arena_impl->region_used, __ATOMIC_RELAXED), 0, 0 };
+    for (uint64_t i = 0; i < LARGE_ARENA_IDX; i++) {
+        for (arena_reservation_t *reservation = arena_impl->arenas[i].reservation_head; reservation;
+             reservation = reservation->next) {
+            header.reservation_count++;
+        }
+    }
+    CUIaddrTrackerNode *node = cuiAddrTrackerFindFirstNodeInRange(&arena_impl->large_tracker, 0, 1ULL << 57);
+    for (; node; node = cuiAddrTrackerNodeNext(node)) {
+        header.large_count++;
+    }
+    va_snapshot_write(writer, &header, sizeof(header));
+
+    for (uint64_t i = 0; i < LARGE_ARENA_IDX; i++) {
+        arena_t *arena = &arena_impl->arenas[i];
+        for (arena_reservation_t *reservation = arena->reservation_head; reservation; reservation = reservation->next) {
+            arena_reservation_record_t record = { i, reservation->addr, reservation->size,
+                                                  (uint64_t)reservation->in_region, 0 };
+            if (arena->is_slab) {
+                slab_allocator_t *sa = (slab_allocator_t *)reservation->strategy;
+                snapshot_slab_runs(sa, NULL, &record.block_count);
+                va_snapshot_write(writer, &record, sizeof(record));
+                snapshot_slab_runs(sa, writer, &record.block_count);
+                continue;
+            }
+
+            obj_allocator_t *oa = (obj_allocator_t *)reservation->strategy;
+            for (uint32_t idx = oa->addr_head; idx != BLOCK_NIL; idx = oa->blocks[idx].addr_next) {
+                record.block_count++;
+            }
+            va_snapshot_write(writer, &record, sizeof(record));
+            for (uint32_t idx = oa->addr_head; idx != BLOCK_NIL; idx = oa->blocks[idx].addr_next) {
+                const va_block_t *block = get_block(oa, idx);
+                va_snapshot_block_t entry = { block_addr(oa, block), block->size,
+                                              (uint64_t)(block->flags & BLOCK_FREE) };
+                va_snapshot_write(writer, &entry, sizeof(entry));
+            }
+        }
+    }
+
+    node = cuiAddrTrackerFindFirstNodeInRange(&arena_impl->large_tracker, 0, 1ULL << 57);
+    for (; node; node = cuiAddrTrackerNodeNext(node)) {
+        large_extent_t *extent = (large_extent_t *)node->value;
+        arena_large_record_t record = { node->addr, node->size, extent->is_free ? 0 : extent->requested };
+        va_snapshot_write(writer, &record, sizeof(record));
+    }
+}
+
+// Slab runs must be ascending, disjoint and inside the slab; object blocks
+// must tile the reservation
+static int
+validate_reservation_blocks(arena_t *arena, const arena_reservation_record_t *record,
+                            const va_snapshot_block_t *blocks)
+{
+    if (arena->is_slab) {
+        uint64_t slab_blocks = arena->info.reservation_size / arena->info.max_per_alloc_size;
+        uint64_t next = 0;
+        for (uint64_t i = 0; i < record->block_count; i++) {
+            if (blocks[i].addr < next || blocks[i].addr >= slab_blocks || blocks[i].size == 0 ||
+                blocks[i].size > slab_blocks - blocks[i].addr) {
+                return 0;
+            }
+            next = blocks[i].addr + blocks[i].size;
+        }
+        return 1;
+    }
+
+    uint64_t end = record->addr;
+    for (uint64_t i = 0; i < record->block_count; i++) {
+        if (blocks[i].addr != end || blocks[i].size == 0 || blocks[i].size > record->addr + record->size - end) {
+            return 0;
+        }
+        end += blocks[i].size;
+    }
+    return record->block_count && end == record->addr + record->size;
+}
+
+static arena_reservation_t *
+restore_reservation(va_allocator_arenas_t *arena_impl, const arena_reservation_record_t *record,
+                    const va_snapshot_block_t *blocks)
+{
+    if (record->arena_idx >= LARGE_ARENA_IDX) {
+        return NULL;
+    }
+    arena_t *arena = &arena_impl->arenas[record->arena_idx];
+    if (record->size != arena->info.reservation_size || record->addr >= (1ULL << 57) - record->size ||
+        !validate_reservation_blocks(arena, record, blocks)) {
+        return NULL;
+    }
+
+    if (record->in_region) {
+        uint64_t offset = record->addr - arena_impl->region_base;
+        if (!arena_impl->region_base || offset > arena_impl->region_used ||
+            record->size > arena_impl->region_used - offset || (offset & (REGION_GRANULE_SIZE - 1)) ||
+            arena_impl->region_table[offset >> REGION_GRANULE_SHIFT]) {
+            return NULL;
+        }
+    } else if (va_snapshot_reserve_at(record->addr, record->size) != 0) {
+        return NULL;
+    }
+
+    arena_reservation_t *reservation = (arena_reservation_t *)calloc_cache_aligned(sizeof(*reservation));
+    if (!reservation) {
+        if (!record->in_region) {
+            FREE_VA(UINT2PTR(record->addr), record->size);
+        }
+        return NULL;
+    }
+    reservation->addr = record->addr;
+    reservation->size = record->size;
+    reservation->in_region = record->in_region ? 1 : 0;
+    reservation->parent_arena = arena;
+    va_commit_map_init(&reservation->commit_map, record->addr, record->size);
+
+    reservation->strategy = arena->is_slab ? (void *)initialize_slab(reservation)
+                                           : (void *)initialize_obj_allocator(reservation);
+    if (!reservation->strategy) {
+        if (!reservation->in_region) {
+            FREE_VA(UINT2PTR(record->addr), record->size);
+        }
+        free(reservation);
+        return NULL;
+    }
+
+    if (arena->is_slab) {
+        slab_allocator_t *sa = (slab_allocator_t *)reservation->strategy;
+        for (uint64_t i = 0; i < record->block_count; i++) {
+            cubitvectorSetBitsInRange(sa->bitmap, blocks[i].addr, blocks[i].addr + blocks[i].size - 1);
+            sa->free_blocks -= blocks[i].size;
+            arena_impl->used_va_size += blocks[i].size * sa->block_size;
+        }
+    } else {
+        // Replace the single free block the allocator starts with
+        obj_allocator_t *oa = (obj_allocator_t *)reservation->strategy;
+        va_block_t *initial = get_block(oa, oa->addr_head);
+        put_node(oa, unindex_block(oa, initial));
+        unlink_block(oa, oa->addr_head);
+
+        uint32_t prev_idx = BLOCK_NIL;
+        uint64_t live = 0;
+        for (uint64_t i = 0; i < record->block_count; i++) {
+            uint32_t idx = new_block(oa);
+            if (idx == BLOCK_NIL) {
+                release_reservation(reservation);
+                return NULL;
+            }
+            va_block_t *block = get_block(oa, idx);
+            block->offset = (uint32_t)(blocks[i].addr - record->addr);
+            block->size = (uint32_t)blocks[i].size;
+            if (prev_idx != BLOCK_NIL) {
+                link_after(oa, prev_idx, idx);
+            } else {
+                oa->addr_head = idx;
+            }
+            if (blocks[i].is_free) {
+                block->flags = BLOCK_FREE;
+                index_block(oa, idx, BLOCK_NIL);
+                if (block->node == BLOCK_NIL) {
+                    release_reservation(reservation);
+                    return NULL;
+                }
+            } else {
+                live += block->size;
+            }
+            prev_idx = idx;
+        }
+        arena_impl->used_va_size += live;
+    }
+
+    publish_reservation(arena, reservation);
+    return reservation;
+}
+
+static int
+restore_large_extent(va_allocator_arenas_t *arena_impl, const arena_large_record_t *record)
+{
+    uint64_t mask = va_page_size() - 1;
+    if (record->size == 0 || ((record->addr | record->size) & mask) || record->requested > record->size ||
+        record->size > (1ULL << 57) || record->addr >= (1ULL << 57) - record->size || va_snapshot_reserve_at(record->addr, record->size) != 0) {
+        return -1;
+    }
+
+    large_extent_t *extent = large_extent_create(arena_impl, record->addr, record->size);
+    if (!extent) {
+        FREE_VA(UINT2PTR(record->addr), record->size);
+        return -1;
+    }
+    arena_impl->total_va_size += record->size;
+    if (record->requested) {
+        extent->requested = record->requested;
+        arena_impl->used_va_size += record->requested;
+    } else {
+        large_cache_insert(arena_impl, extent);
+    }
+    return 0;
+}
+
+void *
+restore_arena_allocator(const va_allocator_config_t *config, va_snapshot_reader_t *reader)
+{
+    // The region must come back at its recorded base, so it is mapped here
+    va_allocator_config_t init_config = *config;
+    init_config.arena_region_size = 0;
+    va_allocator_arenas_t *arena_impl = (va_allocator_arenas_t *)init_arena_allocator(&init_config);
+    if (!arena_impl) {
+        return NULL;
+    }
+    arena_impl->config = *config;
+
+    const arena_snapshot_t *header = (const arena_snapshot_t *)va_snapshot_read(reader, sizeof(*header), 1);
+    if (!header) {
+        goto Fail;
+    }
+    if (header->region_size) {
+        if ((header->region_size & (REGION_GRANULE_SIZE - 1)) || header->region_used > header->region_size ||
+            header->region_size > (1ULL << 57) || header->region_base >= (1ULL << 57) - header->region_size) {
+            goto Fail;
+        }
+        arena_impl->region_table = (arena_reservation_t **)calloc(header->region_size >> REGION_GRANULE_SHIFT,
+                                                                  sizeof(*arena_impl->region_table));
+        if (!arena_impl->region_table || va_snapshot_reserve_at(header->region_base, header->region_size) != 0) {
+            free(arena_impl->region_table);
+            arena_impl->region_table = NULL;
+            goto Fail;
+        }
+        arena_impl->region_base = header->region_base;
+        arena_impl->region_size = header->region_size;
+        arena_impl->region_used = header->region_used;
+    }
+
+    // Keep each arena's list order by appending at the tail
+    arena_reservation_t **tails[NUM_ARENAS];
+    for (uint64_t i = 0; i < NUM_ARENAS; i++) {
+        tails[i] = &arena_impl->arenas[i].reservation_head;
+    }
+    for (uint64_t i = 0; i < header->reservation_count; i++) {
+        const arena_reservation_record_t *record =
+            (const arena_reservation_record_t *)va_snapshot_read(reader, sizeof(*record), 1);
+        const va_snapshot_block_t *blocks = record ?
+            (const va_snapshot_block_t *)va_snapshot_read(reader, sizeof(*blocks), record->block_count) : NULL;
+        arena_reservation_t *reservation = blocks ? restore_reservation(arena_impl, record, blocks) : NULL;
+        if (!reservation) {
+            goto Fail;
+        }
+        *tails[record->arena_idx] = reservation;
+        tails[record->arena_idx] = &reservation->next;
+    }
+
+    for (uint64_t i = 0; i < header->large_count; i++) {
+        const arena_large_record_t *record =
+            (const arena_large_record_t *)va_snapshot_read(reader, sizeof(*record), 1);
+        if (!record || restore_large_extent(arena_impl, record) != 0) {
+            goto Fail;
+        }
+    }
+    return arena_impl;
+
+Fail:
+    // Teardown treats blocks still set in a slab as leaked
+    for (uint64_t i = 0; i < LARGE_ARENA_IDX; i++) {
+        if (!arena_impl->arenas[i].is_slab) {
+            continue;
+        }
+        for (arena_reservation_t *reservation = arena_impl->arenas[i].reservation_head; reservation;
+             reservation = reservation->next) {
+            slab_allocator_t *sa = (slab_allocator_t *)reservation->strategy;
+            cubitvectorClearBitsInRange(sa->bitmap, 0, sa->blocks_per_slab - 1);
+        }
+    }
+    arena_destroy(arena_impl);
+    return NULL;
+}
+
+#ifdef VA_STAGE_TIMERS
+static va_stage_stats_t *
+arena_stage_stats(void *impl)
+{
+    return &((va_allocator_arenas_t *)impl)->stage_stats;
+}
+#endif
+
 static void
 arena_allocator_print(void *impl)
 {
@@ -570,31 +2366,71 @@ arena_allocator_print(void *impl)
 }
 
 // Function to get the default implementation operations
-va_allocator_ops_t *
+const va_allocator_ops_t *
 get_arena_allocator_ops(void)
 {
-    static va_allocator_ops_t ops = {
+    static const va_allocator_ops_t ops = {
         .alloc = arena_alloc,
         .free = arena_free,
         .get_total_size = arena_get_total_size,
         .get_used_size = arena_get_used_size,
         .print = arena_allocator_print,
         .destroy = arena_destroy,
-        .impl = NULL
+        .get_frag_stats = arena_get_frag_stats,
+        .commit = arena_commit,
+        .get_committed_size = arena_get_committed_size,
+        .compact_plan = arena_compact_plan,
+        .compact_apply = arena_compact_apply,
+        .snapshot = arena_snapshot,
+#ifdef VA_STAGE_TIMERS
+        .stage_stats = arena_stage_stats,
+#endif
     };
     return &ops;
 }
 
+//
+// Direct entry points for the C++ front end, see va_allocator.hpp
+//
+uint64_t
+va_arena_alloc(void *impl, uint64_t size)
+{
+    return arena_alloc(impl, size);
+}
+
+uint64_t
+va_arena_alloc_class(void *impl, uint32_t arena_idx, uint64_t size)
+{
+    // A size above the arena's blocks would get an undersized slab block
+    if (arena_idx >= NUM_ARENAS || get_arena_idx_for_size(size) != arena_idx) {
+        return 0;
+    }
+    return allocate_in_arena_idx((va_allocator_arenas_t *)impl, arena_idx, size);
+}
+
+void
+va_arena_free(void *impl, uint64_t addr)
+{
+    arena_free(impl, addr);
+}
+
+uint64_t
+va_arena_class_size(uint32_t arena_idx)
+{
+    return arena_idx < NUM_ARENAS ? arena_info_table[arena_idx].max_per_alloc_size : 0;
+}
+
 void *
-init_arena_allocator(void)
+init_arena_allocator(const va_allocator_config_t *config)
 {
-    va_allocator_arenas_t *arena_impl = (va_allocator_arenas_t *)calloc(1, sizeof(*arena_impl));
+    va_allocator_arenas_t *arena_impl = (va_allocator_arenas_t *)calloc_cache_aligned(sizeof(*arena_impl));
     if (!arena_impl) {
         return NULL;
     }
 
     arena_impl->total_va_size = 0;
     arena_impl->used_va_size = 0;
+    arena_impl->config = *config;
 
     for (uint64_t i = 0; i < NUM_ARENAS; i++) {
         arena_impl->arenas[i].info = arena_info_table[i];
@@ -606,6 +2442,46 @@ init_arena_allocator(void)
 
     // Max VA width
     cuiAddrTrackerInit(&arena_impl->res_tracker, 0, 1ULL << 57);
+    cuiAddrTrackerInit(&arena_impl->large_tracker, 0, 1ULL << 57);
+    cuSizeIndexInit(&arena_impl->large_cache, SIZE_INDEX_KIND(config->size_index));
+
+    if (config->arena_region_size) {
+        uint64_t region_size = (config->arena_region_size + REGION_GRANULE_SIZE - 1) & ~(REGION_GRANULE_SIZE - 1);
+        void *va = RESERVE_VA(region_size);
+        arena_impl->region_table = (arena_reservation_t **)calloc(region_size >> REGION_GRANULE_SHIFT,
+                                                                  sizeof(*arena_impl->region_table));
+        if (va == MAP_FAILED || !arena_impl->region_table) {
+            if (va != MAP_FAILED) {
+                FREE_VA(va, region_size);
+            }
+            free(arena_impl->region_table);
+            cuiAddrTrackerDeinit(&arena_impl->large_tracker);
+            cuiAddrTrackerDeinit(&arena_impl->res_tracker);
+            free(arena_impl);
+            return NULL;
+        }
+        arena_impl->region_base = PTR2UINT(va);
+        arena_impl->region_size = region_size;
+    }
+
+    arena_impl->pool_watermark = (config->reservation_pool_depth + 1) / 2;
+    if (config->reservation_pool_depth && config->reservation_pool_thread) {
+        pthread_mutex_init(&arena_impl->pool_lock, NULL);
+        pthread_cond_init(&arena_impl->pool_cond, NULL);
+        if (pthread_create(&arena_impl->pool_thread, NULL, pool_thread_main, arena_impl) != 0) {
+            pthread_cond_destroy(&arena_impl->pool_cond);
+            pthread_mutex_destroy(&arena_impl->pool_lock);
+            if (arena_impl->region_base) {
+                FREE_VA(UINT2PTR(arena_impl->region_base), arena_impl->region_size);
+                free(arena_impl->region_table);
+            }
+            cuiAddrTrackerDeinit(&arena_impl->large_tracker);
+            cuiAddrTrackerDeinit(&arena_impl->res_tracker);
+            free(arena_impl);
+            return NULL;
+        }
+        arena_impl->pool_threaded = 1;
+    }
 
     return arena_impl;
 }
\ No newline at end of file
@@ -1,8 +1,12 @@
 #include "va_allocator_default.h"
 #include "common.h"
-#include "radix.h"
+#include "sizeindex.h"
+#include "addrtracker.h"
+#include "va_commit.h"
+#include "va_stage_timer.h"
 
-#define VA_RESERVATION_SIZE (2 * PHYSICAL_MEMORY_SIZE)
+// Upper bound of the address tracker that maps addresses to chunks (max VA width)
+#define VA_CHUNK_TRACKER_LIMIT (1ULL << 57)
 
 // Structure to represent a memory block
 typedef struct va_block {
@@ -11,79 +15,171 @@ typedef struct va_block {
     int is_free;            // Whether the block is free
     struct va_block *addr_next;  // Next block in address-ordered list
     struct va_block *addr_prev;  // Previous block in address-ordered list
-    CUradixNode radix_node;     // Node in size-ordered radix tree
+    CUsizeIndexNode size_node;  // Node in the size index while the block is free
 } va_block_t;
 
+//
+// One VA reservation of the default allocator. Blocks never span chunks, so
+// each chunk keeps its own address-ordered list and coalescing stays inside it.
+//
+typedef struct va_chunk {
+    CUIaddrTrackerNode node;    // Node in the chunk tracker, covers [base, base + size)
+    va_block_t *addr_list;      // Blocks of this chunk ordered by address
+    va_commit_map_t commit_map; // Committed pages of the chunk
+    struct va_chunk *next;      // Next chunk in creation order
+} va_chunk_t;
+
 // Default implementation structure
 typedef struct {
-    va_block_t *addr_list;      // List ordered by address
-    CUradixTree size_tree;      // Tree ordered by size
+    va_chunk_t *chunks;         // All chunks, newest first
+    CUIaddrTracker chunk_tracker; // Address to chunk lookup
+    CUsizeIndex size_index;     // Free blocks of every chunk ordered by size
     uint64_t total_va_size;     // Total VA space size
     uint64_t used_va_size;      // Currently used VA space
+    uint64_t chunk_size;        // Minimum size of a new chunk
+    uint64_t max_va_size;       // Cap on total_va_size, 0 for none
+    va_stage_stats_t stage_stats; // Only updated when built with VA_STAGE_TIMERS
 } va_allocator_default_t;
 
+// Snapshot records: the header, then for each chunk (newest first) its record
+// followed by its blocks in address order
+typedef struct {
+    uint64_t chunk_count;
+} default_snapshot_t;
+
+typedef struct {
+    uint64_t addr;
+    uint64_t size;
+    uint64_t block_count;
+} default_chunk_record_t;
+
 // Helper function to print the va blocks
 static void
 default_allocator_print(void *impl) {
     va_allocator_default_t *default_impl = (va_allocator_default_t *)impl;
-    va_block_t *current = default_impl->addr_list;
-    while (current) {
-        printf("Block: start_addr: %lu, size: %lu, is_free: %d\n",
-            (unsigned long)current->start_addr,
-            (unsigned long)current->size,
-            current->is_free);
-        current = current->addr_next;
-    }
-} 
-
-// Helper function to insert block into address-ordered list
-static void
-insert_addr_list(va_allocator_default_t *impl, va_block_t *block) {
-    va_block_t *current = impl->addr_list;
-    va_block_t *prev = NULL;
-    while (current && current->start_addr < block->start_addr) {
-        prev = current;
-        current = current->addr_next;
-    }
-    block->addr_next = current;
-    block->addr_prev = prev;
-    if (prev) {
-        prev->addr_next = block;
-    } else {
-        impl->addr_list = block;
-    }
-    if (current) {
-        current->addr_prev = block;
+    for (va_chunk_t *chunk = default_impl->chunks; chunk; chunk = chunk->next) {
+        printf("Chunk: start_addr: %lu, size: %lu\n",
+            (unsigned long)chunk->node.addr,
+            (unsigned long)chunk->node.size);
+        va_block_t *current = chunk->addr_list;
+        while (current) {
+            printf("Block: start_addr: %lu, size: %lu, is_free: %d\n",
+                (unsigned long)current->start_addr,
+                (unsigned long)current->size,
+                current->is_free);
+            current = current->addr_next;
+        }
     }
 }
 
 // Helper function to remove block from address-ordered list
 static void
-remove_addr_list(va_allocator_default_t *impl, va_block_t *block) {
+remove_addr_list(va_chunk_t *chunk, va_block_t *block) {
     if (block->addr_prev) {
         block->addr_prev->addr_next = block->addr_next;
     } else {
-        impl->addr_list = block->addr_next;
+        chunk->addr_list = block->addr_next;
     }
     if (block->addr_next) {
         block->addr_next->addr_prev = block->addr_prev;
     }
 }
 
+static va_chunk_t *
+find_chunk(va_allocator_default_t *impl, uint64_t addr) {
+    CUIaddrTrackerNode *node = cuiAddrTrackerFindNode(&impl->chunk_tracker, addr);
+    return node ? (va_chunk_t *)node->value : NULL;
+}
+
+static void
+destroy_chunk(va_chunk_t *chunk) {
+    va_block_t *current = chunk->addr_list;
+    while (current) {
+        va_block_t *next = current->addr_next;
+        free(current);
+        current = next;
+    }
+    FREE_VA(UINT2PTR(chunk->node.addr), chunk->node.size);
+    va_commit_map_deinit(&chunk->commit_map);
+    free(chunk);
+}
+
+//
+// Reserves a new chunk able to hold 'min_size' and adds its single free block
+// to the size index. Chunks grow geometrically (at least the VA reserved so
+// far) so the number of chunks stays logarithmic in the peak demand.
+//
+static int
+add_chunk(va_allocator_default_t *impl, uint64_t min_size) {
+    uint64_t granule = impl->chunk_size;
+    uint64_t size = MAX(granule, impl->total_va_size);
+    if (min_size > size) {
+        if (min_size > UINT64_MAX - granule) {
+            return 0;
+        }
+        size = (min_size + granule - 1) / granule * granule;
+    }
+    if (impl->max_va_size) {
+        if (impl->total_va_size >= impl->max_va_size || min_size > impl->max_va_size - impl->total_va_size) {
+            return 0;
+        }
+        if (size > impl->max_va_size - impl->total_va_size) {
+            size = impl->max_va_size - impl->total_va_size;
+        }
+    }
+
+    va_chunk_t *chunk = (va_chunk_t *)calloc(1, sizeof(*chunk));
+    va_block_t *block = (va_block_t *)calloc(1, sizeof(*block));
+    void *va_base = RESERVE_VA(size);
+    if (!chunk || !block || va_base == MAP_FAILED ||
+        PTR2UINT(va_base) + size > VA_CHUNK_TRACKER_LIMIT) {
+        if (va_base != MAP_FAILED) {
+            FREE_VA(va_base, size);
+        }
+        free(chunk);
+        free(block);
+        return 0;
+    }
+
+    block->start_addr = PTR2UINT(va_base);
+    block->size = size;
+    block->is_free = 1;
+    chunk->addr_list = block;
+    va_commit_map_init(&chunk->commit_map, block->start_addr, size);
+    cuiAddrTrackerRegisterNode(&impl->chunk_tracker, &chunk->node, block->start_addr, size, chunk);
+    chunk->next = impl->chunks;
+    impl->chunks = chunk;
+
+    impl->total_va_size += size;
+    cuSizeIndexInsert(&impl->size_index, &block->size_node, block->size, block->start_addr);
+    return 1;
+}
+
 // Implementation of alloc function
 static uint64_t
 default_alloc(void *impl, uint64_t size) {
     va_allocator_default_t *default_impl = (va_allocator_default_t *)impl;
-    if (size == 0 || size > default_impl->total_va_size) {
+    if (size == 0) {
         return 0;
     }
 
-    CUradixNode *node = radixTreeFindGEQ(&default_impl->size_tree, size);
+    va_stage_stats_t *stats = &default_impl->stage_stats;
+    UNUSED(stats);
+    CUsizeIndexNode *node;
+    VA_STAGE_TIME(stats, VA_STAGE_SIZE_INDEX, node = cuSizeIndexFindGEQ(&default_impl->size_index, size));
     if (!node) {
-        return 0;  // No suitable block found
+        int added;
+        VA_STAGE_TIME(stats, VA_STAGE_RESERVE, added = add_chunk(default_impl, size));
+        if (!added) {
+            return 0;
+        }
+        VA_STAGE_TIME(stats, VA_STAGE_SIZE_INDEX, node = cuSizeIndexFindGEQ(&default_impl->size_index, size));
+        if (!node) {
+            return 0;  // No suitable block found
+        }
     }
 
-    va_block_t *best_fit = container_of(node, va_block_t, radix_node);
+    va_block_t *best_fit = container_of(node, va_block_t, size_node);
     // Split block if necessary
     if (best_fit->size > size) {
         va_block_t *new_block = calloc(1, sizeof(*new_block));
@@ -96,16 +192,24 @@ default_alloc(void *impl, uint64_t size) {
         new_block->addr_next = NULL;
         new_block->addr_prev = NULL;
 
-        // Update the best fit block's size to reflect this split
+        // Update the best fit block's size to reflect this split. The new
+        // block directly follows it, so link it in place rather than walking the list.
         best_fit->size = size;
-        insert_addr_list(default_impl, new_block);
-        radixTreeInsert(&default_impl->size_tree, &new_block->radix_node, new_block->size);
+        new_block->addr_prev = best_fit;
+        new_block->addr_next = best_fit->addr_next;
+        if (best_fit->addr_next) {
+            best_fit->addr_next->addr_prev = new_block;
+        }
+        best_fit->addr_next = new_block;
+        VA_STAGE_TIME(stats, VA_STAGE_SIZE_INDEX,
+                      cuSizeIndexInsert(&default_impl->size_index, &new_block->size_node, new_block->size,
+                                        new_block->start_addr));
     }
 
     // Mark the best fit block as in use
     best_fit->is_free = 0;
     default_impl->used_va_size += best_fit->size;
-    radixTreeRemove(&best_fit->radix_node);
+    VA_STAGE_TIME(stats, VA_STAGE_SIZE_INDEX, cuSizeIndexRemove(&default_impl->size_index, &best_fit->size_node));
     return best_fit->start_addr;
 }
 
@@ -117,10 +221,19 @@ default_free(void *impl, uint64_t addr) {
         return;
     }
 
-    va_block_t *block = default_impl->addr_list;
-    while (block && block->start_addr != addr) {
-        block = block->addr_next;
+    va_stage_stats_t *stats = &default_impl->stage_stats;
+    UNUSED(stats);
+    va_chunk_t *chunk;
+    VA_STAGE_TIME(stats, VA_STAGE_RESERVATION_LOOKUP, chunk = find_chunk(default_impl, addr));
+    if (!chunk) {
+        return;
     }
+
+    va_block_t *block = chunk->addr_list;
+    VA_STAGE_TIME(stats, VA_STAGE_ADDR_LIST,
+                  while (block && block->start_addr != addr) {
+                      block = block->addr_next;
+                  });
     if (!block || block->is_free) {
         return;
     }
@@ -133,8 +246,8 @@ default_free(void *impl, uint64_t addr) {
     assert(!prev || (prev && (block->start_addr == prev->start_addr + prev->size)));
     if (prev && prev->is_free) {
         prev->size += block->size;
-        remove_addr_list(default_impl, block);
-        radixTreeRemove(&prev->radix_node);
+        remove_addr_list(chunk, block);
+        VA_STAGE_TIME(stats, VA_STAGE_SIZE_INDEX, cuSizeIndexRemove(&default_impl->size_index, &prev->size_node));
         free(block);
         block = prev;
     }
@@ -142,11 +255,12 @@ default_free(void *impl, uint64_t addr) {
     assert(!next || (next && (block->start_addr + block->size == next->start_addr)));
     if (next && next->is_free) {
         block->size += next->size;
-        remove_addr_list(default_impl, next);
-        radixTreeRemove(&next->radix_node);
+        remove_addr_list(chunk, next);
+        VA_STAGE_TIME(stats, VA_STAGE_SIZE_INDEX, cuSizeIndexRemove(&default_impl->size_index, &next->size_node));
         free(next);
     }
-    radixTreeInsert(&default_impl->size_tree, &block->radix_node, block->size);
+    VA_STAGE_TIME(stats, VA_STAGE_SIZE_INDEX,
+                  cuSizeIndexInsert(&default_impl->size_index, &block->size_node, block->size, block->start_addr));
 }
 
 // Implementation of get_total_size function
@@ -163,6 +277,60 @@ default_get_used_size(void *impl) {
     return default_impl->used_va_size;
 }
 
+static va_commit_map_t *
+default_commit_lookup(void *impl, uint64_t addr, uint64_t size) {
+    va_chunk_t *chunk = find_chunk((va_allocator_default_t *)impl, addr);
+    if (!chunk) {
+        return NULL;
+    }
+    va_commit_map_t *map = &chunk->commit_map;
+    if (size > map->size || addr - map->base > map->size - size) {
+        return NULL;
+    }
+    return map;
+}
+
+// Implementation of commit function
+static int
+default_commit(void *impl, const va_range_t *ranges, size_t count, int commit) {
+    return va_commit_apply_ranges(impl, default_commit_lookup, ranges, count, commit);
+}
+
+// Implementation of get_committed_size function
+static uint64_t
+default_get_committed_size(void *impl) {
+    va_allocator_default_t *default_impl = (va_allocator_default_t *)impl;
+    uint64_t committed = 0;
+    for (va_chunk_t *chunk = default_impl->chunks; chunk; chunk = chunk->next) {
+        committed += va_commit_map_committed_size(&chunk->commit_map);
+    }
+    return committed;
+}
+
+// Implementation of get_frag_stats function
+static void
+default_get_frag_stats(void *impl, va_allocator_frag_stats_t *stats) {
+    va_allocator_default_t *default_impl = (va_allocator_default_t *)impl;
+    stats->reserved_size = default_impl->total_va_size;
+    stats->used_size = default_impl->used_va_size;
+    stats->committed_size = default_get_committed_size(impl);
+    stats->metadata_size = sizeof(*default_impl);
+    for (va_chunk_t *chunk = default_impl->chunks; chunk; chunk = chunk->next) {
+        stats->metadata_size += sizeof(*chunk);
+        for (va_block_t *block = chunk->addr_list; block; block = block->addr_next) {
+            stats->metadata_size += sizeof(*block);
+            if (!block->is_free) {
+                continue;
+            }
+            stats->free_size += block->size;
+            stats->free_extents++;
+            if (block->size > stats->largest_free) {
+                stats->largest_free = block->size;
+            }
+        }
+    }
+}
+
 // Implementation of destroy function
 static void
 default_destroy(void *impl) {
@@ -171,64 +339,209 @@ default_destroy(void *impl) {
         return;
     }
 
-    va_block_t *current = default_impl->addr_list;
-    while (current) {
-        va_block_t *next = current->addr_next;
-        free(current);
-        current = next;
-    }
-    if (default_impl->addr_list) {
-        FREE_VA((void *)default_impl->addr_list->start_addr, default_impl->total_va_size);
+    va_chunk_t *chunk = default_impl->chunks;
+    while (chunk) {
+        va_chunk_t *next = chunk->next;
+        cuiAddrTrackerUnregisterNode(&chunk->node);
+        destroy_chunk(chunk);
+        chunk = next;
     }
+    cuiAddrTrackerDeinit(&default_impl->chunk_tracker);
     free(default_impl);
 }
 
+// Implementation of snapshot function
+static void
+default_snapshot(void *impl, va_snapshot_writer_t *writer) {
+    va_allocator_default_t *default_impl = (va_allocator_default_t *)impl;
+    default_snapshot_t header = { 0 };
+    for (va_chunk_t *chunk = default_impl->chunks; chunk; chunk = chunk->next) {
+        header.chunk_count++;
+    }
+    va_snapshot_write(writer, &header, sizeof(header));
+
+    for (va_chunk_t *chunk = default_impl->chunks; chunk; chunk = chunk->next) {
+        default_chunk_record_t record = { chunk->node.addr, chunk->node.size, 0 };
+        for (va_block_t *block = chunk->addr_list; block; block = block->addr_next) {
+            record.block_count++;
+        }
+        va_snapshot_write(writer, &record, sizeof(record));
+        for (va_block_t *block = chunk->addr_list; block; block = block->addr_next) {
+            va_snapshot_block_t entry = { block->start_addr, block->size, (uint64_t)block->is_free };
+            va_snapshot_write(writer, &entry, sizeof(entry));
+        }
+    }
+}
+
+#ifdef VA_STAGE_TIMERS
+static va_stage_stats_t *
+default_stage_stats(void *impl) {
+    return &((va_allocator_default_t *)impl)->stage_stats;
+}
+#endif
+
 // Function to get the default implementation operations
-va_allocator_ops_t *
+const va_allocator_ops_t *
 get_default_allocator_ops(void) {
-    static va_allocator_ops_t ops = {
+    static const va_allocator_ops_t ops = {
         .alloc = default_alloc,
         .free = default_free,
         .get_total_size = default_get_total_size,
         .get_used_size = default_get_used_size,
         .print = default_allocator_print,
         .destroy = default_destroy,
-        .impl = NULL
+        .get_frag_stats = default_get_frag_stats,
+        .commit = default_commit,
+        .get_committed_size = default_get_committed_size,
+        .snapshot = default_snapshot,
+#ifdef VA_STAGE_TIMERS
+        .stage_stats = default_stage_stats,
+#endif
     };
     return &ops;
 }
 
-// Function to initialize the default implementation
-void *
-init_default_allocator(void) {
+// Direct entry points for the C++ front end, see va_allocator.hpp
+uint64_t
+va_default_alloc(void *impl, uint64_t size) {
+    return default_alloc(impl, size);
+}
+
+void
+va_default_free(void *impl, uint64_t addr) {
+    default_free(impl, addr);
+}
+
+static va_allocator_default_t *
+create_default_impl(const va_allocator_config_t *config) {
+    if (config->default_chunk_size == 0 ||
+        (config->default_chunk_size & ((uint64_t)sysconf(_SC_PAGESIZE) - 1)) != 0) {
+        return NULL;
+    }
+
     va_allocator_default_t *impl = (va_allocator_default_t *)calloc(1, sizeof(*impl));
     if (!impl) {
         return NULL;
     }
 
-    impl->total_va_size = VA_RESERVATION_SIZE;
+    impl->total_va_size = 0;
     impl->used_va_size = 0;
-    impl->addr_list = NULL;
-    radixTreeInit(&impl->size_tree, 63);  // Use 63 bits for size keys
-    void *va_base = RESERVE_VA(impl->total_va_size);
-    if (va_base == MAP_FAILED) {
-        free(impl);
+    impl->chunks = NULL;
+    impl->chunk_size = config->default_chunk_size;
+    impl->max_va_size = config->default_max_size;
+    cuSizeIndexInit(&impl->size_index, SIZE_INDEX_KIND(config->size_index));
+    cuiAddrTrackerInit(&impl->chunk_tracker, 0, VA_CHUNK_TRACKER_LIMIT);
+    return impl;
+}
+
+// Function to initialize the default implementation
+void *
+init_default_allocator(const va_allocator_config_t *config) {
+    va_allocator_default_t *impl = create_default_impl(config);
+    if (!impl) {
         return NULL;
     }
 
-    va_block_t *initial_block = calloc(1, sizeof(va_block_t));
-    if (!initial_block) {
-        FREE_VA(va_base, impl->total_va_size);
+    // Start with one chunk so the first allocations do not pay for a reservation
+    if (!add_chunk(impl, impl->chunk_size)) {
+        cuiAddrTrackerDeinit(&impl->chunk_tracker);
         free(impl);
         return NULL;
     }
+    return impl;
+}
+
+//
+// Maps a chunk back at its recorded address and rebuilds its block list.
+// The blocks must tile the chunk exactly; the list is built in one pass and
+// only free blocks touch the size index.
+//
+static va_chunk_t *
+restore_chunk(va_allocator_default_t *impl, const default_chunk_record_t *record,
+              const va_snapshot_block_t *blocks) {
+    uint64_t page_mask = (uint64_t)sysconf(_SC_PAGESIZE) - 1;
+    if (record->size == 0 || record->block_count == 0 || (record->addr & page_mask) != 0 ||
+        record->addr >= VA_CHUNK_TRACKER_LIMIT || record->size > VA_CHUNK_TRACKER_LIMIT - record->addr) {
+        return NULL;
+    }
+    uint64_t end = record->addr;
+    for (uint64_t i = 0; i < record->block_count; i++) {
+        if (blocks[i].addr != end || blocks[i].size == 0 || blocks[i].size > record->addr + record->size - end) {
+            return NULL;
+        }
+        end += blocks[i].size;
+    }
+    if (end != record->addr + record->size || va_snapshot_reserve_at(record->addr, record->size) != 0) {
+        return NULL;
+    }
+
+    va_chunk_t *chunk = (va_chunk_t *)calloc(1, sizeof(*chunk));
+    if (!chunk) {
+        FREE_VA(UINT2PTR(record->addr), record->size);
+        return NULL;
+    }
+    chunk->node.addr = record->addr;
+    chunk->node.size = record->size;
+    va_commit_map_init(&chunk->commit_map, record->addr, record->size);
+
+    va_block_t *prev = NULL;
+    for (uint64_t i = 0; i < record->block_count; i++) {
+        va_block_t *block = (va_block_t *)calloc(1, sizeof(*block));
+        if (!block) {
+            destroy_chunk(chunk);
+            return NULL;
+        }
+        block->start_addr = blocks[i].addr;
+        block->size = blocks[i].size;
+        block->is_free = blocks[i].is_free ? 1 : 0;
+        block->addr_prev = prev;
+        if (prev) {
+            prev->addr_next = block;
+        } else {
+            chunk->addr_list = block;
+        }
+        prev = block;
+    }
+
+    cuiAddrTrackerRegisterNode(&impl->chunk_tracker, &chunk->node, record->addr, record->size, chunk);
+    for (va_block_t *block = chunk->addr_list; block; block = block->addr_next) {
+        if (block->is_free) {
+            cuSizeIndexInsert(&impl->size_index, &block->size_node, block->size, block->start_addr);
+        } else {
+            impl->used_va_size += block->size;
+        }
+    }
+    impl->total_va_size += record->size;
+    return chunk;
+}
+
+void *
+restore_default_allocator(const va_allocator_config_t *config, va_snapshot_reader_t *reader) {
+    va_allocator_default_t *impl = create_default_impl(config);
+    if (!impl) {
+        return NULL;
+    }
+
+    const default_snapshot_t *header = (const default_snapshot_t *)va_snapshot_read(reader, sizeof(*header), 1);
+    if (!header) {
+        default_destroy(impl);
+        return NULL;
+    }
 
-    initial_block->start_addr = (uint64_t)va_base;
-    initial_block->size = VA_RESERVATION_SIZE;
-    initial_block->is_free = 1;
-    initial_block->addr_next = NULL;
-    initial_block->addr_prev = NULL;
-    impl->addr_list = initial_block;
-    radixTreeInsert(&impl->size_tree, &initial_block->radix_node, VA_RESERVATION_SIZE);
+    // Keep the snapshot's chunk order, newest first
+    va_chunk_t **tail = &impl->chunks;
+    for (uint64_t i = 0; i < header->chunk_count; i++) {
+        const default_chunk_record_t *record =
+            (const default_chunk_record_t *)va_snapshot_read(reader, sizeof(*record), 1);
+        const va_snapshot_block_t *blocks = record ?
+            (const va_snapshot_block_t *)va_snapshot_read(reader, sizeof(*blocks), record->block_count) : NULL;
+        va_chunk_t *chunk = blocks ? restore_chunk(impl, record, blocks) : NULL;
+        if (!chunk) {
+            default_destroy(impl);
+            return NULL;
+        }
+        *tail = chunk;
+        tail = &chunk->next;
+    }
     return impl;
-}
\ No newline at end of file
+}
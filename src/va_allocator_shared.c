@@ -0,0 +1,513 @@
+#define _GNU_SOURCE
+#include "va_allocator_shared.h"
+#include "common.h"
+#include "va_commit.h"
+#include "va_snapshot.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+//
+// Shared allocator.
+//
+// All metadata lives in one memfd segment that every cooperating process maps
+// MAP_SHARED, so it refers to blocks by node index and to addresses by offset
+// from the VA range base, never by pointer. The VA range itself is reserved at
+// the same address in every process: inherited across fork(), or mapped by
+// attach_shared_allocator() with MAP_FIXED_NOREPLACE.
+//
+// Blocks are multiples of the page size. Free blocks sit in one list per
+// floor(log2(size)), with a bitmap of the non-empty lists; a block is found by
+// scanning its own class for a fit, else taking the head of the next non-empty
+// class. A table with one entry per page maps a block's start to its node, so
+// free is a direct lookup, and blocks keep address-order links for coalescing.
+// Every block covers at least one page, so the node array sized to the page
+// count never runs out.
+//
+// One robust process-shared mutex guards the segment. If a process dies
+// holding it, the next locker marks it consistent and carries on; a process
+// killed in the middle of an update can leave that update half done.
+//
+// Commit state is per process, as page protections are: each process tracks
+// its own commits of the range.
+//
+
+#define SHARED_MAGIC 0x4445524148534156ULL  // "VASHARED" little endian
+#define SHARED_NUM_CLASSES 64
+#define SHARED_NIL 0                        // Node 0 is never a block
+#define SHARED_ALIGN(x) (((x) + 63) & ~63ULL)
+
+typedef struct {
+    uint64_t offset;     // Start of the block relative to the range base
+    uint64_t size;
+    uint32_t addr_prev;  // Neighbours in address order
+    uint32_t addr_next;
+    uint32_t list_prev;  // Neighbours in the free list of the block's class, or the spare list
+    uint32_t list_next;
+    uint32_t is_free;
+    uint32_t pad;
+} shared_node_t;
+
+typedef struct {
+    uint64_t magic;
+    uint64_t segment_size;
+    uint64_t base;                           // VA range, at this address in every process
+    uint64_t size;
+    uint64_t page_shift;
+    uint64_t used_va_size;
+    uint64_t free_class_map;                 // Bit per non-empty free_heads entry
+    uint32_t free_heads[SHARED_NUM_CLASSES]; // Free blocks by floor(log2(size))
+    uint32_t spare_head;                     // Nodes of blocks that were merged away
+    uint32_t node_count;                     // Nodes handed out, including node 0
+    uint32_t node_capacity;
+    uint32_t pad;
+    uint64_t nodes_offset;                   // Segment offsets of the node array and page table
+    uint64_t table_offset;
+    pthread_mutex_t lock;
+} shared_header_t;
+
+typedef struct {
+    shared_header_t *header;    // Mapped segment
+    shared_node_t *nodes;
+    uint32_t *table;            // Node of the block starting at each page, SHARED_NIL elsewhere
+    int fd;
+    va_commit_map_t commit_map; // Pages this process committed
+} va_allocator_shared_t;
+
+static void
+shared_lock(shared_header_t *header)
+{
+    if (pthread_mutex_lock(&header->lock) == EOWNERDEAD) {
+        pthread_mutex_consistent(&header->lock);
+    }
+}
+
+static void
+shared_unlock(shared_header_t *header)
+{
+    pthread_mutex_unlock(&header->lock);
+}
+
+static inline uint32_t
+size_class(uint64_t size)
+{
+    return 63 - __builtin_clzll(size);
+}
+
+static void
+free_list_insert(va_allocator_shared_t *impl, uint32_t idx)
+{
+    shared_header_t *header = impl->header;
+    shared_node_t *node = &impl->nodes[idx];
+    uint32_t cls = size_class(node->size);
+
+    node->is_free = 1;
+    node->list_prev = SHARED_NIL;
+    node->list_next = header->free_heads[cls];
+    if (node->list_next != SHARED_NIL) {
+        impl->nodes[node->list_next].list_prev = idx;
+    }
+    header->free_heads[cls] = idx;
+    header->free_class_map |= 1ULL << cls;
+}
+
+static void
+free_list_remove(va_allocator_shared_t *impl, uint32_t idx)
+{
+    shared_header_t *header = impl->header;
+    shared_node_t *node = &impl->nodes[idx];
+    uint32_t cls = size_class(node->size);
+
+    if (node->list_prev != SHARED_NIL) {
+        impl->nodes[node->list_prev].list_next = node->list_next;
+    } else {
+        header->free_heads[cls] = node->list_next;
+        if (node->list_next == SHARED_NIL) {
+            header->free_class_map &= ~(1ULL << cls);
+        }
+    }
+    if (node->list_next != SHARED_NIL) {
+        impl->nodes[node->list_next].list_prev = node->list_prev;
+    }
+    node->is_free = 0;
+}
+
+static uint32_t
+node_get(va_allocator_shared_t *impl)
+{
+    shared_header_t *header = impl->header;
+    uint32_t idx = header->spare_head;
+    if (idx != SHARED_NIL) {
+        header->spare_head = impl->nodes[idx].list_next;
+    } else {
+        assert(header->node_count < header->node_capacity);
+        idx = header->node_count++;
+    }
+    memset(&impl->nodes[idx], 0, sizeof(impl->nodes[idx]));
+    return idx;
+}
+
+static void
+node_put(va_allocator_shared_t *impl, uint32_t idx)
+{
+    impl->table[impl->nodes[idx].offset >> impl->header->page_shift] = SHARED_NIL;
+    impl->nodes[idx].list_next = impl->header->spare_head;
+    impl->header->spare_head = idx;
+}
+
+// First block of at least 'size': a fit within its own class, else the head of
+// the next non-empty class, all of whose blocks are larger
+static uint32_t
+find_free_block(va_allocator_shared_t *impl, uint64_t size)
+{
+    shared_header_t *header = impl->header;
+    uint32_t cls = size_class(size);
+    for (uint32_t idx = header->free_heads[cls]; idx != SHARED_NIL; idx = impl->nodes[idx].list_next) {
+        if (impl->nodes[idx].size >= size) {
+            return idx;
+        }
+    }
+    uint64_t larger = (cls == 63) ? 0 : header->free_class_map & ~((2ULL << cls) - 1);
+    return larger ? header->free_heads[__builtin_ctzll(larger)] : SHARED_NIL;
+}
+
+static uint64_t
+shared_alloc(void *impl_ptr, uint64_t size)
+{
+    va_allocator_shared_t *impl = (va_allocator_shared_t *)impl_ptr;
+    shared_header_t *header = impl->header;
+    uint64_t page_mask = (1ULL << header->page_shift) - 1;
+    if (size == 0 || size > header->size) {
+        return 0;
+    }
+    size = (size + page_mask) & ~page_mask;
+
+    shared_lock(header);
+    uint32_t idx = find_free_block(impl, size);
+    if (idx == SHARED_NIL) {
+        shared_unlock(header);
+        return 0;
+    }
+
+    free_list_remove(impl, idx);
+    shared_node_t *block = &impl->nodes[idx];
+    if (block->size > size) {
+        uint32_t rest_idx = node_get(impl);
+        shared_node_t *rest = &impl->nodes[rest_idx];
+        rest->offset = block->offset + size;
+        rest->size = block->size - size;
+        rest->addr_prev = idx;
+        rest->addr_next = block->addr_next;
+        if (block->addr_next != SHARED_NIL) {
+            impl->nodes[block->addr_next].addr_prev = rest_idx;
+        }
+        block->addr_next = rest_idx;
+        block->size = size;
+        impl->table[rest->offset >> header->page_shift] = rest_idx;
+        free_list_insert(impl, rest_idx);
+    }
+    header->used_va_size += size;
+    uint64_t addr = header->base + block->offset;
+    shared_unlock(header);
+    return addr;
+}
+
+static void
+shared_free(void *impl_ptr, uint64_t addr)
+{
+    va_allocator_shared_t *impl = (va_allocator_shared_t *)impl_ptr;
+    shared_header_t *header = impl->header;
+    uint64_t offset = addr - header->base;
+    if (offset >= header->size || (offset & ((1ULL << header->page_shift) - 1))) {
+        return;
+    }
+
+    shared_lock(header);
+    uint32_t idx = impl->table[offset >> header->page_shift];
+    if (idx == SHARED_NIL || impl->nodes[idx].is_free) {
+        shared_unlock(header);
+        return;
+    }
+
+    shared_node_t *block = &impl->nodes[idx];
+    header->used_va_size -= block->size;
+
+    uint32_t prev_idx = block->addr_prev;
+    if (prev_idx != SHARED_NIL && impl->nodes[prev_idx].is_free) {
+        shared_node_t *prev = &impl->nodes[prev_idx];
+        free_list_remove(impl, prev_idx);
+        prev->size += block->size;
+        prev->addr_next = block->addr_next;
+        if (block->addr_next != SHARED_NIL) {
+            impl->nodes[block->addr_next].addr_prev = prev_idx;
+        }
+        node_put(impl, idx);
+        idx = prev_idx;
+        block = prev;
+    }
+
+    uint32_t next_idx = block->addr_next;
+    if (next_idx != SHARED_NIL && impl->nodes[next_idx].is_free) {
+        shared_node_t *next = &impl->nodes[next_idx];
+        free_list_remove(impl, next_idx);
+        block->size += next->size;
+        block->addr_next = next->addr_next;
+        if (next->addr_next != SHARED_NIL) {
+            impl->nodes[next->addr_next].addr_prev = idx;
+        }
+        node_put(impl, next_idx);
+    }
+
+    free_list_insert(impl, idx);
+    shared_unlock(header);
+}
+
+static uint64_t
+shared_get_total_size(void *impl_ptr)
+{
+    return ((va_allocator_shared_t *)impl_ptr)->header->size;
+}
+
+static uint64_t
+shared_get_used_size(void *impl_ptr)
+{
+    shared_header_t *header = ((va_allocator_shared_t *)impl_ptr)->header;
+    return __atomic_load_n(&header->used_va_size, __ATOMIC_RELAXED);
+}
+
+static va_commit_map_t *
+shared_commit_lookup(void *impl_ptr, uint64_t addr, uint64_t size)
+{
+    va_commit_map_t *map = &((va_allocator_shared_t *)impl_ptr)->commit_map;
+    if (size > map->size || addr - map->base > map->size - size) {
+        return NULL;
+    }
+    return map;
+}
+
+static int
+shared_commit(void *impl_ptr, const va_range_t *ranges, size_t count, int commit)
+{
+    return va_commit_apply_ranges(impl_ptr, shared_commit_lookup, ranges, count, commit);
+}
+
+static uint64_t
+shared_get_committed_size(void *impl_ptr)
+{
+    return va_commit_map_committed_size(&((va_allocator_shared_t *)impl_ptr)->commit_map);
+}
+
+static void
+shared_get_frag_stats(void *impl_ptr, va_allocator_frag_stats_t *stats)
+{
+    va_allocator_shared_t *impl = (va_allocator_shared_t *)impl_ptr;
+    shared_header_t *header = impl->header;
+
+    shared_lock(header);
+    stats->reserved_size = header->size;
+    stats->used_size = header->used_va_size;
+    stats->metadata_size = sizeof(*impl) + header->segment_size;
+    for (uint32_t idx = impl->table[0]; idx != SHARED_NIL; idx = impl->nodes[idx].addr_next) {
+        shared_node_t *block = &impl->nodes[idx];
+        if (!block->is_free) {
+            continue;
+        }
+        stats->free_size += block->size;
+        stats->free_extents++;
+        if (block->size > stats->largest_free) {
+            stats->largest_free = block->size;
+        }
+    }
+    shared_unlock(header);
+    stats->committed_size = shared_get_committed_size(impl_ptr);
+}
+
+static void
+shared_allocator_print(void *impl_ptr)
+{
+    va_allocator_shared_t *impl = (va_allocator_shared_t *)impl_ptr;
+    shared_header_t *header = impl->header;
+
+    shared_lock(header);
+    for (uint32_t idx = impl->table[0]; idx != SHARED_NIL; idx = impl->nodes[idx].addr_next) {
+        shared_node_t *block = &impl->nodes[idx];
+        printf("Block: start_addr: %lu, size: %lu, is_free: %u\n",
+               (unsigned long)(header->base + block->offset), (unsigned long)block->size, block->is_free);
+    }
+    shared_unlock(header);
+}
+
+// Unmaps this process's view; the segment lives on while others map it
+static void
+shared_destroy(void *impl_ptr)
+{
+    va_allocator_shared_t *impl = (va_allocator_shared_t *)impl_ptr;
+    if (!impl) {
+        return;
+    }
+
+    FREE_VA(UINT2PTR(impl->header->base), impl->header->size);
+    munmap(impl->header, impl->header->segment_size);
+    close(impl->fd);
+    va_commit_map_deinit(&impl->commit_map);
+    free(impl);
+}
+
+const va_allocator_ops_t *
+get_shared_allocator_ops(void)
+{
+    static const va_allocator_ops_t ops = {
+        .alloc = shared_alloc,
+        .free = shared_free,
+        .get_total_size = shared_get_total_size,
+        .get_used_size = shared_get_used_size,
+        .print = shared_allocator_print,
+        .destroy = shared_destroy,
+        .get_frag_stats = shared_get_frag_stats,
+        .commit = shared_commit,
+        .get_committed_size = shared_get_committed_size
+    };
+    return &ops;
+}
+
+// Direct entry points for the C++ front end, see va_allocator.hpp
+uint64_t
+va_shared_alloc(void *impl_ptr, uint64_t size)
+{
+    return shared_alloc(impl_ptr, size);
+}
+
+void
+va_shared_free(void *impl_ptr, uint64_t addr)
+{
+    shared_free(impl_ptr, addr);
+}
+
+// Maps the whole segment behind 'fd'; takes ownership of 'fd' on success
+static va_allocator_shared_t *
+map_segment(int fd, uint64_t segment_size)
+{
+    va_allocator_shared_t *impl = (va_allocator_shared_t *)calloc(1, sizeof(*impl));
+    if (!impl) {
+        return NULL;
+    }
+    void *segment = mmap(NULL, segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (segment == MAP_FAILED) {
+        free(impl);
+        return NULL;
+    }
+    impl->header = (shared_header_t *)segment;
+    impl->fd = fd;
+    return impl;
+}
+
+static void
+bind_segment(va_allocator_shared_t *impl)
+{
+    shared_header_t *header = impl->header;
+    impl->nodes = (shared_node_t *)((char *)header + header->nodes_offset);
+    impl->table = (uint32_t *)((char *)header + header->table_offset);
+    va_commit_map_init(&impl->commit_map, header->base, header->size);
+}
+
+void *
+init_shared_allocator(const va_allocator_config_t *config)
+{
+    uint64_t page = (uint64_t)sysconf(_SC_PAGESIZE);
+    uint64_t size = config->shared_size;
+    if (size == 0 || (size & (page - 1)) || size / page >= UINT32_MAX) {
+        return NULL;
+    }
+
+    // Header, then a node per page plus the nil node, then the page table.
+    // memfd pages are only backed once touched, so the worst-case sizing is cheap.
+    uint64_t pages = size / page;
+    uint64_t nodes_offset = SHARED_ALIGN(sizeof(shared_header_t));
+    uint64_t table_offset = SHARED_ALIGN(nodes_offset + (pages + 1) * sizeof(shared_node_t));
+    uint64_t segment_size = (table_offset + pages * sizeof(uint32_t) + page - 1) & ~(page - 1);
+
+    int fd = memfd_create("va_allocator_shared", MFD_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    void *va = MAP_FAILED;
+    va_allocator_shared_t *impl = NULL;
+    if (ftruncate(fd, (off_t)segment_size) == 0) {
+        va = RESERVE_VA(size);
+    }
+    if (va != MAP_FAILED) {
+        impl = map_segment(fd, segment_size);
+    }
+    if (!impl) {
+        if (va != MAP_FAILED) {
+            FREE_VA(va, size);
+        }
+        close(fd);
+        return NULL;
+    }
+
+    shared_header_t *header = impl->header;
+    header->segment_size = segment_size;
+    header->base = PTR2UINT(va);
+    header->size = size;
+    header->page_shift = __builtin_ctzll(page);
+    header->node_count = 1;
+    header->node_capacity = (uint32_t)(pages + 1);
+    header->nodes_offset = nodes_offset;
+    header->table_offset = table_offset;
+
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&header->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    bind_segment(impl);
+    uint32_t idx = node_get(impl);
+    impl->nodes[idx].offset = 0;
+    impl->nodes[idx].size = size;
+    impl->table[0] = idx;
+    free_list_insert(impl, idx);
+
+    // Written last: attachers treat a segment without the magic as not ready
+    __atomic_store_n(&header->magic, SHARED_MAGIC, __ATOMIC_RELEASE);
+    return impl;
+}
+
+void *
+attach_shared_allocator(int fd)
+{
+    // Reserve the range before mapping the segment, which could otherwise land in it
+    shared_header_t header;
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 ||
+        pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+        header.magic != SHARED_MAGIC || header.segment_size > (uint64_t)st.st_size ||
+        va_snapshot_reserve_at(header.base, header.size) != 0) {
+        return NULL;
+    }
+
+    va_allocator_shared_t *impl = NULL;
+    int own_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (own_fd >= 0) {
+        impl = map_segment(own_fd, header.segment_size);
+    }
+    if (!impl) {
+        if (own_fd >= 0) {
+            close(own_fd);
+        }
+        FREE_VA(UINT2PTR(header.base), header.size);
+        return NULL;
+    }
+
+    bind_segment(impl);
+    return impl;
+}
+
+int
+shared_allocator_fd(void *impl_ptr)
+{
+    return ((va_allocator_shared_t *)impl_ptr)->fd;
+}
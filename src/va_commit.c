@@ -0,0 +1,166 @@
+#include "va_commit.h"
+#include "common.h"
+
+// Racing first calls store the same value
+uint64_t
+va_page_size(void)
+{
+    static uint64_t size = 0;
+    uint64_t cached = __atomic_load_n(&size, __ATOMIC_RELAXED);
+    if (!cached) {
+        cached = (uint64_t)sysconf(_SC_PAGESIZE);
+        __atomic_store_n(&size, cached, __ATOMIC_RELAXED);
+    }
+    return cached;
+}
+
+void
+va_commit_map_init(va_commit_map_t *map, uint64_t base, uint64_t size)
+{
+    assert(map);
+    assert((base % va_page_size()) == 0);
+
+    memset(map, 0, sizeof(*map));
+    map->base = base;
+    map->size = size;
+}
+
+void
+va_commit_map_deinit(va_commit_map_t *map)
+{
+    assert(map);
+    if (map->pages) {
+        cubitvectorDestroy(map->pages);
+    }
+    memset(map, 0, sizeof(*map));
+}
+
+uint64_t
+va_commit_map_committed_size(const va_commit_map_t *map)
+{
+    return map->committed_pages * va_page_size();
+}
+
+// Number of pages in [first, last] that are not yet in the requested state
+static uint64_t
+count_pages_to_change(CUbitvector *pages, uint64_t first, uint64_t last, int commit)
+{
+    uint64_t changed = 0;
+    NvU64 pos = first;
+    NvU64 start = 0;
+    NvU64 end = 0;
+
+    while (pos <= last) {
+        NvBool found = commit ? cubitvectorFindLowestClearBitInRange(pages, pos, last, &start)
+                              : cubitvectorFindLowestSetBitInRange(pages, pos, last, &start);
+        if (!found) {
+            break;
+        }
+        found = commit ? cubitvectorFindLowestSetBitInRange(pages, start, last, &end)
+                       : cubitvectorFindLowestClearBitInRange(pages, start, last, &end);
+        if (!found) {
+            end = last + 1;
+        }
+        changed += end - start;
+        pos = end;
+    }
+    return changed;
+}
+
+// Applies a page-aligned range that lies within 'map'
+static int
+commit_map_apply(va_commit_map_t *map, uint64_t addr, uint64_t size, int commit)
+{
+    uint64_t first = (addr - map->base) / va_page_size();
+    uint64_t last = first + size / va_page_size() - 1;
+
+    if (!map->pages) {
+        if (!commit) {
+            return 0;  // Nothing was ever committed
+        }
+        if (!cubitvectorCreate(&map->pages, map->size / va_page_size())) {
+            return -1;
+        }
+    }
+
+    uint64_t changed = count_pages_to_change(map->pages, first, last, commit);
+    if (changed == 0) {
+        return 0;
+    }
+
+    if (commit) {
+        if (mprotect(UINT2PTR(addr), size, PROT_READ | PROT_WRITE) != 0) {
+            return -1;
+        }
+        cubitvectorSetBitsInRange(map->pages, first, last);
+        map->committed_pages += changed;
+    } else {
+        if (madvise(UINT2PTR(addr), size, MADV_DONTNEED) != 0 ||
+            mprotect(UINT2PTR(addr), size, PROT_NONE) != 0) {
+            return -1;
+        }
+        cubitvectorClearBitsInRange(map->pages, first, last);
+        map->committed_pages -= changed;
+    }
+    return 0;
+}
+
+static int
+compare_ranges(const void *a, const void *b)
+{
+    const va_range_t *ra = (const va_range_t *)a;
+    const va_range_t *rb = (const va_range_t *)b;
+    return (ra->addr < rb->addr) ? -1 : (ra->addr > rb->addr) ? 1 : 0;
+}
+
+int
+va_commit_apply_ranges(void *impl, va_commit_lookup_fn lookup,
+                       const va_range_t *ranges, size_t count, int commit)
+{
+    if (!impl || !lookup || (!ranges && count)) {
+        return -1;
+    }
+    if (count == 0) {
+        return 0;
+    }
+
+    va_range_t *sorted = (va_range_t *)malloc(count * sizeof(*sorted));
+    if (!sorted) {
+        return -1;
+    }
+
+    // Round out to pages and validate everything before touching any mapping
+    uint64_t mask = va_page_size() - 1;
+    for (size_t i = 0; i < count; i++) {
+        if (ranges[i].size == 0 || ranges[i].addr + ranges[i].size < ranges[i].addr) {
+            free(sorted);
+            return -1;
+        }
+        sorted[i].addr = ranges[i].addr & ~mask;
+        sorted[i].size = ((ranges[i].addr + ranges[i].size + mask) & ~mask) - sorted[i].addr;
+        if (!lookup(impl, sorted[i].addr, sorted[i].size)) {
+            free(sorted);
+            return -1;
+        }
+    }
+    qsort(sorted, count, sizeof(*sorted), compare_ranges);
+
+    int status = 0;
+    size_t i = 0;
+    while (i < count && status == 0) {
+        va_commit_map_t *map = lookup(impl, sorted[i].addr, sorted[i].size);
+        uint64_t addr = sorted[i].addr;
+        uint64_t end = addr + sorted[i].size;
+
+        // Merge ranges that overlap or touch inside the same reservation
+        for (i++; i < count && sorted[i].addr <= end && sorted[i].addr < map->base + map->size; i++) {
+            if (sorted[i].addr + sorted[i].size > end) {
+                end = sorted[i].addr + sorted[i].size;
+            }
+        }
+        status = commit_map_apply(map, addr, end - addr, commit);
+    }
+
+    free(sorted);
+    return status;
+}
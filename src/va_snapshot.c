@@ -0,0 +1,43 @@
+#define _GNU_SOURCE
+#include "va_snapshot.h"
+#include "common.h"
+
+// Older kernels ignore the flag; the address check below still catches that
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+void
+va_snapshot_write(va_snapshot_writer_t *writer, const void *data, size_t size)
+{
+    if (!writer->error && fwrite(data, 1, size, writer->file) != size) {
+        writer->error = 1;
+    }
+}
+
+const void *
+va_snapshot_read(va_snapshot_reader_t *reader, size_t size, uint64_t count)
+{
+    size_t left = reader->size - reader->pos;
+    if (size && count > left / size) {
+        return NULL;
+    }
+    const void *record = reader->data + reader->pos;
+    reader->pos += size * count;
+    return record;
+}
+
+int
+va_snapshot_reserve_at(uint64_t addr, uint64_t size)
+{
+    void *va = mmap(UINT2PTR(addr), size, PROT_NONE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED_NOREPLACE, -1, 0);
+    if (va == MAP_FAILED) {
+        return -1;
+    }
+    if (PTR2UINT(va) != addr) {
+        FREE_VA(va, size);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,160 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+//
+// HDR-style latency histogram.
+//
+// Values (nanoseconds) are recorded into log-bucketed counters: values below
+// 2^SUB_BUCKET_BITS are exact, larger values keep SUB_BUCKET_BITS significant
+// bits. Percentiles report a bucket's highest value, which overstates the
+// recorded one by less than 1/64 (about 1.6%). Recording is O(1) and the memory
+// footprint is fixed, so the harness no longer keeps or sorts every sample.
+//
+class LatencyHistogram {
+public:
+    enum {
+        SUB_BUCKET_BITS = 7,
+        SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS,
+        HALF_SUB_BUCKET_COUNT = SUB_BUCKET_COUNT / 2,
+        NUM_BUCKETS = (64 - SUB_BUCKET_BITS + 1) * HALF_SUB_BUCKET_COUNT + HALF_SUB_BUCKET_COUNT
+    };
+
+    LatencyHistogram() : counts_((size_t)NUM_BUCKETS, 0) { reset(); }
+
+    void reset() {
+        std::fill(counts_.begin(), counts_.end(), 0);
+        count_ = 0;
+        sum_ = 0;
+        min_ = UINT64_MAX;
+        max_ = 0;
+    }
+
+    void record(uint64_t value) {
+        counts_[bucket_index(value)]++;
+        count_++;
+        sum_ += value;
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+    }
+
+    void merge(const LatencyHistogram &other) {
+        for (uint64_t i = 0; i < (uint64_t)NUM_BUCKETS; i++) {
+            counts_[i] += other.counts_[i];
+        }
+        count_ += other.count_;
+        sum_ += other.sum_;
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+    }
+
+    uint64_t count() const { return count_; }
+    uint64_t min() const { return count_ ? min_ : 0; }
+    uint64_t max() const { return max_; }
+    double mean() const { return count_ ? (double)sum_ / count_ : 0.0; }
+
+    // Highest value equivalent to the bucket holding the given percentile,
+    // clamped to the exact recorded maximum.
+    uint64_t percentile(double pct) const {
+        if (count_ == 0) {
+            return 0;
+        }
+        uint64_t target = (uint64_t)((pct / 100.0) * count_ + 0.5);
+        target = std::max<uint64_t>(1, std::min(target, count_));
+        uint64_t seen = 0;
+        for (uint64_t i = 0; i < (uint64_t)NUM_BUCKETS; i++) {
+            seen += counts_[i];
+            if (seen >= target) {
+                return std::min(bucket_highest_value(i), max_);
+            }
+        }
+        return max_;
+    }
+
+    // Prints count, mean and the tail percentiles in microseconds.
+    void print(const char *label) const {
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << label << " (us, " << count_ << " samples):\n";
+        std::cout << "  Min:    " << min() / 1000.0 << "\n";
+        std::cout << "  Mean:   " << mean() / 1000.0 << "\n";
+        std::cout << "  p50:    " << percentile(50.0) / 1000.0 << "\n";
+        std::cout << "  p99:    " << percentile(99.0) / 1000.0 << "\n";
+        std::cout << "  p99.9:  " << percentile(99.9) / 1000.0 << "\n";
+        std::cout << "  p99.99: " << percentile(99.99) / 1000.0 << "\n";
+        std::cout << "  Max:    " << max() / 1000.0 << "\n";
+    }
+
+private:
+    static unsigned msb(uint64_t value) { return 63 - __builtin_clzll(value); }
+
+    static uint64_t bucket_index(uint64_t value) {
+        if (value < (uint64_t)SUB_BUCKET_COUNT) {
+            return value;
+        }
+        unsigned shift = msb(value) - (SUB_BUCKET_BITS - 1);
+        return shift * HALF_SUB_BUCKET_COUNT + (value >> shift);
+    }
+
+    static uint64_t bucket_highest_value(uint64_t idx) {
+        if (idx < (uint64_t)SUB_BUCKET_COUNT) {
+            return idx;
+        }
+        uint64_t shift = idx / HALF_SUB_BUCKET_COUNT - 1;
+        uint64_t mantissa = idx % HALF_SUB_BUCKET_COUNT + HALF_SUB_BUCKET_COUNT;
+        return ((mantissa + 1) << shift) - 1;
+    }
+
+    std::vector<uint64_t> counts_;
+    uint64_t count_;
+    uint64_t sum_;
+    uint64_t min_;
+    uint64_t max_;
+};
+
+//
+// Monotonic nanosecond timer whose own cost is measured once and subtracted
+// from every interval, so sub-microsecond operations are not dominated by
+// the clock reads around them.
+//
+class CalibratedTimer {
+public:
+    CalibratedTimer() : overhead_ns_(0) { calibrate(); }
+
+    static uint64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()
+        ).count();
+    }
+
+    // Elapsed time between two now() readings with the timer overhead removed.
+    uint64_t elapsed(uint64_t start, uint64_t end) const {
+        uint64_t raw = end - start;
+        return (raw > overhead_ns_) ? raw - overhead_ns_ : 0;
+    }
+
+    uint64_t overhead_ns() const { return overhead_ns_; }
+
+private:
+    // The cheapest back-to-back read pair is used so the correction never
+    // exceeds the real cost of bracketing an operation with two reads.
+    void calibrate() {
+        const int iterations = 100000;
+        LatencyHistogram empty;
+        for (int i = 0; i < iterations; i++) {
+            uint64_t start = now();
+            uint64_t end = now();
+            empty.record(end - start);
+        }
+        overhead_ns_ = empty.min();
+    }
+
+    uint64_t overhead_ns_;
+};
+
+#endif // LATENCY_HISTOGRAM_H
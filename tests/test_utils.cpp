@@ -0,0 +1,471 @@
+#include <iostream>
+#include <vector>
+#include <set>
+#include <map>
+#include <algorithm>
+#include <cassert>
+#include "sizeindex.h"
+#include "bitvector.h"
+#include "addrtracker.h"
+#include "workload.h"
+
+//
+// Contract tests for the utils data structures, checked against a std::multiset
+// reference under a seeded random insert/remove/find mix.
+//
+
+static const char *
+kind_name(CUsizeIndexKind kind)
+{
+    switch (kind) {
+        case CU_SIZE_INDEX_RADIX: return "radix";
+        case CU_SIZE_INDEX_SEGREGATED: return "segregated";
+        case CU_SIZE_INDEX_RADIX_COMPRESSED: return "compressed radix";
+        case CU_SIZE_INDEX_ADDRESS_FIRST_FIT: return "address first-fit";
+        default: return "unknown";
+    }
+}
+
+static bool
+is_best_fit(CUsizeIndexKind kind)
+{
+    return kind == CU_SIZE_INDEX_RADIX || kind == CU_SIZE_INDEX_RADIX_COMPRESSED;
+}
+
+static NvU64
+node_key(CUsizeIndex *index, CUsizeIndexNode *node)
+{
+    switch (index->kind) {
+        case CU_SIZE_INDEX_SEGREGATED: return node->u.seg.key;
+        case CU_SIZE_INDEX_ADDRESS_FIRST_FIT: return node->u.avl.size;
+        default: return node->u.radix.key;
+    }
+}
+
+// Live extents of the reference model, keyed by address
+typedef std::map<NvU64, NvU64> ExtentMap;
+
+// FindGEQ must return a node with key >= the request whenever one exists. The
+// radix kinds are exact best fit and first-fit returns the lowest address
+// that fits (checked when check_order is set, as the scan is linear); the
+// segregated kind may return any fitting node.
+static void
+check_find(CUsizeIndex *index, const std::multiset<NvU64> &ref, const ExtentMap &extents,
+           NvU64 key, bool check_order)
+{
+    CUsizeIndexNode *node = cuSizeIndexFindGEQ(index, key);
+    std::multiset<NvU64>::const_iterator it = ref.lower_bound(key);
+    if (it == ref.end()) {
+        assert(node == NULL);
+        return;
+    }
+    assert(node != NULL);
+    NvU64 found = node_key(index, node);
+    assert(found >= key);
+    assert(ref.count(found) > 0);
+    if (is_best_fit(index->kind)) {
+        assert(found == *it);
+    }
+    if (index->kind == CU_SIZE_INDEX_ADDRESS_FIRST_FIT && check_order) {
+        NvU64 addr = (NvU64)(uintptr_t)node->u.avl.avl.key;
+        for (ExtentMap::const_iterator e = extents.begin(); e->first != addr; ++e) {
+            assert(e->second < key);
+        }
+    }
+}
+
+static void
+test_size_index_contract(CUsizeIndexKind kind, NvU64 max_key)
+{
+    std::cout << "Testing " << kind_name(kind) << " size index, keys up to " << max_key << "..." << std::endl;
+
+    const size_t num_nodes = 4096;
+    const size_t num_ops = 100000;
+    std::vector<CUsizeIndexNode> nodes(num_nodes);
+    std::vector<NvU64> keys(num_nodes);
+    std::vector<bool> inserted(num_nodes, false);
+    std::multiset<NvU64> ref;
+    ExtentMap extents;
+
+    CUsizeIndex index;
+    cuSizeIndexInit(&index, kind);
+    assert(cuSizeIndexEmpty(&index));
+
+    workload::Rng gen(workload::default_seed());
+    std::uniform_int_distribution<NvU64> key_dist(1, max_key);
+    std::uniform_int_distribution<size_t> node_dist(0, num_nodes - 1);
+
+    for (size_t op = 0; op < num_ops; op++) {
+        size_t i = node_dist(gen);
+        if (!inserted[i]) {
+            keys[i] = key_dist(gen);
+            cuSizeIndexInsert(&index, &nodes[i], keys[i], i * 4096);
+            ref.insert(keys[i]);
+            extents[i * 4096] = keys[i];
+            inserted[i] = true;
+        } else {
+            cuSizeIndexRemove(&index, &nodes[i]);
+            ref.erase(ref.find(keys[i]));
+            extents.erase(i * 4096);
+            inserted[i] = false;
+        }
+        check_find(&index, ref, extents, key_dist(gen), op % 16 == 0);
+        assert(cuSizeIndexEmpty(&index) == ref.empty());
+        if (kind == CU_SIZE_INDEX_ADDRESS_FIRST_FIT && op % 1024 == 0) {
+            cuAvlTreeAssertValid(&index.u.avl);  // Also re-derives every augment value
+        }
+    }
+
+    // Exact keys must always be found
+    for (size_t i = 0; i < num_nodes; i++) {
+        if (inserted[i]) {
+            check_find(&index, ref, extents, keys[i], true);
+        }
+    }
+
+    for (size_t i = 0; i < num_nodes; i++) {
+        if (inserted[i]) {
+            cuSizeIndexRemove(&index, &nodes[i]);
+        }
+    }
+    assert(cuSizeIndexEmpty(&index));
+}
+
+// Keys that share a sub-bucket with the request but sit below it must never be returned
+static void
+test_segregated_bucket_boundaries(void)
+{
+    std::cout << "Testing segregated size index bucket boundaries..." << std::endl;
+
+    CUsizeIndex index;
+    cuSizeIndexInit(&index, CU_SIZE_INDEX_SEGREGATED);
+
+    CUsizeIndexNode low, high;
+    cuSizeIndexInsert(&index, &low, 4096, 0);
+    cuSizeIndexInsert(&index, &high, 4096 + 200, 0);  // Same sub-bucket as 4096 + 100
+
+    assert(cuSizeIndexFindGEQ(&index, 4096) != NULL);
+    assert(cuSizeIndexFindGEQ(&index, 4096 + 100) == &high);
+    assert(cuSizeIndexFindGEQ(&index, 4096 + 201) == NULL);
+
+    cuSizeIndexRemove(&index, &high);
+    assert(cuSizeIndexFindGEQ(&index, 4096 + 100) == NULL);
+    assert(cuSizeIndexFindGEQ(&index, 1) == &low);
+
+    CUsizeIndexNode huge;
+    cuSizeIndexInsert(&index, &huge, ~0ULL >> 1, 0);
+    assert(cuSizeIndexFindGEQ(&index, 1ULL << 40) == &huge);
+
+    cuSizeIndexRemove(&index, &low);
+    cuSizeIndexRemove(&index, &huge);
+    assert(cuSizeIndexEmpty(&index));
+}
+
+static unsigned
+radix_depth(CUradixNode *node)
+{
+    unsigned depth = 0;
+    for (; node->parent; node = node->parent) {
+        depth++;
+    }
+    return depth;
+}
+
+// The heap order must hold and, with path compression, keys that share a long
+// prefix and differ only in their low bits branch on those bits alone. 64 keys
+// differing in bits 0-5 are at most 6 levels deep, while the bit-by-bit tree
+// built from the same keys descends one level per shared bit.
+static void
+test_compressed_radix_depth(void)
+{
+    std::cout << "Testing compressed radix depth and heap order..." << std::endl;
+
+    const NvU64 keys[] = {1ULL << 40, (1ULL << 40) + 1, 3, 4096, (1ULL << 62) + 7, 4097, 2, 1ULL << 40};
+    const size_t num_keys = sizeof(keys) / sizeof(keys[0]);
+    CUradixNode nodes[num_keys];
+
+    CUradixTree tree;
+    radixTreeInitCompressed(&tree, 63);
+    for (size_t i = 0; i < num_keys; i++) {
+        radixTreeInsert(&tree, &nodes[i], keys[i]);
+    }
+
+    for (size_t i = 0; i < num_keys; i++) {
+        if (!nodes[i].parent_to_self_ptr) {
+            continue;  // Duplicate parked on another node's list
+        }
+        for (int c = 0; c < 2; c++) {
+            assert(!nodes[i].child[c] || nodes[i].child[c]->key > nodes[i].key);
+        }
+    }
+    assert(radixTreeFindGEQ(&tree, 5)->key == 4096);
+    assert(radixTreeFindGEQ(&tree, (1ULL << 40) + 1)->key == (1ULL << 40) + 1);
+    assert(radixTreeFindGEQ(&tree, (1ULL << 40) + 2)->key == (1ULL << 62) + 7);
+    assert(radixTreeFindGEQ(&tree, (1ULL << 62) + 8) == NULL);
+
+    for (size_t i = 0; i < num_keys; i++) {
+        radixTreeRemove(&nodes[i]);
+    }
+    assert(radixTreeEmpty(&tree));
+
+    const size_t num_prefixed = 64;
+    std::vector<CUradixNode> compressed_nodes(num_prefixed);
+    std::vector<CUradixNode> plain_nodes(num_prefixed);
+    CUradixTree plain;
+    radixTreeInitCompressed(&tree, 63);
+    radixTreeInit(&plain, 63);
+    for (size_t i = 0; i < num_prefixed; i++) {
+        radixTreeInsert(&tree, &compressed_nodes[i], (1ULL << 40) + i);
+        radixTreeInsert(&plain, &plain_nodes[i], (1ULL << 40) + i);
+    }
+    unsigned compressed_depth = 0;
+    unsigned plain_depth = 0;
+    for (size_t i = 0; i < num_prefixed; i++) {
+        compressed_depth = std::max(compressed_depth, radix_depth(&compressed_nodes[i]));
+        plain_depth = std::max(plain_depth, radix_depth(&plain_nodes[i]));
+    }
+    assert(compressed_depth <= 6);
+    assert(plain_depth > 32);
+    for (size_t i = 0; i < num_prefixed; i++) {
+        assert(radixTreeFindGEQ(&tree, (1ULL << 40) + i) == &compressed_nodes[i]);
+        radixTreeRemove(&compressed_nodes[i]);
+        radixTreeRemove(&plain_nodes[i]);
+    }
+    assert(radixTreeEmpty(&tree) && radixTreeEmpty(&plain));
+}
+
+// Lookups on the specialized address tracker tree, checked against a std::map
+// of live ranges. Addresses straddle 2^63, where a signed compare would fail.
+static void
+test_addr_tracker_contract(void)
+{
+    std::cout << "Testing address tracker lookups..." << std::endl;
+
+    const NvU64 base = (1ULL << 63) - (1ULL << 32);
+    const NvU64 slot = 1ULL << 20;
+    const size_t num_nodes = 2048;
+    std::vector<CUIaddrTrackerNode> nodes(num_nodes);
+    std::vector<bool> inserted(num_nodes, false);
+    std::map<NvU64, NvU64> ref;  // addr -> size
+
+    CUIaddrTracker tracker;
+    cuiAddrTrackerInit(&tracker, base, base + num_nodes * slot);
+
+    workload::Rng gen(workload::default_seed());
+    std::uniform_int_distribution<size_t> node_dist(0, num_nodes - 1);
+    std::uniform_int_distribution<NvU64> size_dist(1, slot);
+    std::uniform_int_distribution<NvU64> addr_dist(base, base + num_nodes * slot - 1);
+
+    for (size_t op = 0; op < 50000; op++) {
+        size_t i = node_dist(gen);
+        NvU64 addr = base + i * slot;
+        if (!inserted[i]) {
+            NvU64 size = size_dist(gen);
+            cuiAddrTrackerRegisterNode(&tracker, &nodes[i], addr, size, &nodes[i]);
+            ref[addr] = size;
+            inserted[i] = true;
+        } else {
+            cuiAddrTrackerUnregisterNode(&nodes[i]);
+            ref.erase(addr);
+            inserted[i] = false;
+        }
+
+        // Containing lookup
+        NvU64 probe = addr_dist(gen);
+        std::map<NvU64, NvU64>::iterator it = ref.upper_bound(probe);
+        CUIaddrTrackerNode *expected = NULL;
+        if (it != ref.begin()) {
+            --it;
+            if (probe - it->first < it->second) {
+                expected = &nodes[(it->first - base) / slot];
+            }
+        }
+        assert(cuiAddrTrackerFindNode(&tracker, probe) == expected);
+
+        // Range lookups over a window of a few slots
+        NvU64 lo = probe;
+        NvU64 after_hi = std::min<NvU64>(lo + 3 * slot, base + num_nodes * slot);
+        std::map<NvU64, NvU64>::iterator first = ref.lower_bound(lo);
+        CUIaddrTrackerNode *first_node = NULL;
+        if (first != ref.end() && first->first + first->second <= after_hi) {
+            first_node = &nodes[(first->first - base) / slot];
+        }
+        assert(cuiAddrTrackerFindFirstNodeInRange(&tracker, lo, after_hi) == first_node);
+
+        bool empty = true;
+        std::map<NvU64, NvU64>::iterator last = ref.lower_bound(after_hi);
+        if (last != ref.begin()) {
+            --last;
+            empty = last->first + last->second <= lo;
+        }
+        assert((cuiAddrTrackerIsEmptyForRange(&tracker, lo, after_hi) != NV_FALSE) == empty);
+    }
+
+    // Re-registering an existing address returns the node already there
+    for (size_t i = 0; i < num_nodes; i++) {
+        if (inserted[i]) {
+            CUIaddrTrackerNode dup;
+            CUIaddrTrackerNode *existing = cuiAddrTrackerRegisterNodeOrReturnExisting(&tracker, &dup, base + i * slot, 1, NULL);
+            assert(existing == &nodes[i]);
+            (void)existing;
+            cuiAddrTrackerUnregisterNode(&nodes[i]);
+        }
+    }
+    assert(tracker.tree.root == NULL);
+    cuiAddrTrackerDeinit(&tracker);
+}
+
+// Reference run search with the same hint and wrap-around order as cubitvectorFindClearRun
+static void
+check_clear_run(CUbitvector *bv, const std::vector<bool> &ref, NvU64 n, NvU64 hint)
+{
+    NvU64 num_bits = ref.size();
+    NvU64 expected = num_bits;
+    for (NvU64 i = 0; i < num_bits && expected == num_bits; i++) {
+        NvU64 s = (hint + i) % num_bits;
+        if (s + n > num_bits) {
+            continue;
+        }
+        if (std::find(ref.begin() + s, ref.begin() + s + n, true) == ref.begin() + s + n) {
+            expected = s;
+        }
+    }
+
+    NvU64 start = 0;
+    NvBool found = cubitvectorFindClearRun(bv, n, hint, &start);
+    assert(found == (expected != num_bits));
+    assert(!found || start == expected);
+    (void)found;
+}
+
+// Every bitvector range operation, checked against a std::vector<bool> for each
+// scan kernel the CPU supports. Sizes straddle the inline limit and the
+// kernels' unroll widths; ranges are random so partial and whole chunks mix.
+static void
+test_bitvector_kernel(CUbitvectorKernel kernel, const char *name)
+{
+    if (!cuibitvectorSelectKernel(kernel)) {
+        std::cout << "Skipping " << name << " bitvector kernel (not supported)" << std::endl;
+        return;
+    }
+    std::cout << "Testing " << name << " bitvector kernel..." << std::endl;
+
+    const NvU64 sizes[] = {1, 63, 64, 65, 128, 1000, 1024, 1025, 4096 + 37};
+    workload::Rng gen(workload::default_seed());
+
+    for (NvU64 num_bits : sizes) {
+        CUbitvector *bv = NULL;
+        NvBool created = cubitvectorCreate(&bv, num_bits);
+        assert(created);
+        (void)created;
+        std::vector<bool> ref(num_bits, false);
+        std::uniform_int_distribution<NvU64> bit_dist(0, num_bits - 1);
+
+        for (int op = 0; op < 2000; op++) {
+            NvU64 lo = bit_dist(gen), hi = bit_dist(gen);
+            if (lo > hi) {
+                std::swap(lo, hi);
+            }
+
+            switch (op % 4) {
+                case 0:
+                    cubitvectorSetBitsInRange(bv, lo, hi);
+                    std::fill(ref.begin() + lo, ref.begin() + hi + 1, true);
+                    break;
+                case 1:
+                    cubitvectorClearBitsInRange(bv, lo, hi);
+                    std::fill(ref.begin() + lo, ref.begin() + hi + 1, false);
+                    break;
+                default:
+                    // Sparse flips keep the scans from terminating in the first chunk
+                    cubitvectorSetBit(bv, lo);
+                    ref[lo] = true;
+                    cubitvectorClearBit(bv, hi);
+                    ref[hi] = false;
+                    break;
+            }
+
+            lo = bit_dist(gen);
+            hi = bit_dist(gen);
+            if (lo > hi) {
+                std::swap(lo, hi);
+            }
+            NvU64 first_clear = num_bits, first_set = num_bits;
+            for (NvU64 b = lo; b <= hi; b++) {
+                if (!ref[b] && first_clear == num_bits) {
+                    first_clear = b;
+                }
+                if (ref[b] && first_set == num_bits) {
+                    first_set = b;
+                }
+            }
+
+            NvU64 bit = 0;
+            NvBool found = cubitvectorFindLowestClearBitInRange(bv, lo, hi, &bit);
+            assert(found == (first_clear != num_bits));
+            assert(!found || bit == first_clear);
+            found = cubitvectorFindLowestSetBitInRange(bv, lo, hi, &bit);
+            assert(found == (first_set != num_bits));
+            assert(!found || bit == first_set);
+            (void)found;
+            assert(cubitvectorAreAllBitsSetInRange(bv, lo, hi) == (first_clear == num_bits));
+            assert(cubitvectorAreAllBitsClearInRange(bv, lo, hi) == (first_set == num_bits));
+            assert(cubitvectorIsAnyBitSet(bv) == (std::find(ref.begin(), ref.end(), true) != ref.end()));
+            for (NvU64 b = lo; b <= hi; b++) {
+                assert(cubitvectorIsBitSet(bv, b) == ref[b]);
+            }
+
+            check_clear_run(bv, ref, 1 + bit_dist(gen) % 130, bit_dist(gen));
+        }
+
+        // Carve runs out of an empty map until it is full
+        cubitvectorClearBitsInRange(bv, 0, num_bits - 1);
+        std::fill(ref.begin(), ref.end(), false);
+        NvU64 run_len = 1 + num_bits / 7;
+        NvU64 hint = 0;
+        NvU64 start = 0;
+        while (cubitvectorFindAndSetClearRun(bv, run_len, hint, &start)) {
+            assert(start == hint);
+            std::fill(ref.begin() + start, ref.begin() + start + run_len, true);
+            hint = start + run_len;
+        }
+        assert(num_bits - hint < run_len);
+        check_clear_run(bv, ref, 1, 0);
+
+        // Filling through SetLowestClearBit must hand out bits in order
+        cubitvectorClearBitsInRange(bv, 0, num_bits - 1);
+        NvU64 bit = 0;
+        for (NvU64 b = 0; b < num_bits; b++) {
+            NvBool set = cubitvectorSetLowestClearBit(bv, &bit);
+            assert(set && bit == b);
+            (void)set;
+        }
+        NvBool set = cubitvectorSetLowestClearBit(bv, &bit);
+        assert(!set);
+        (void)set;
+        assert(cubitvectorAreAllBitsSetInRange(bv, 0, num_bits - 1));
+
+        cubitvectorDestroy(bv);
+    }
+}
+
+int main(void) {
+    std::cout << "Starting utils tests (seed " << workload::default_seed() << ")..." << std::endl;
+
+    const CUsizeIndexKind kinds[] = {CU_SIZE_INDEX_RADIX, CU_SIZE_INDEX_SEGREGATED,
+                                     CU_SIZE_INDEX_RADIX_COMPRESSED, CU_SIZE_INDEX_ADDRESS_FIRST_FIT};
+    for (CUsizeIndexKind kind : kinds) {
+        test_size_index_contract(kind, 64);         // Dense keys, many duplicates
+        test_size_index_contract(kind, 1ULL << 32); // Sparse keys
+    }
+    test_segregated_bucket_boundaries();
+    test_compressed_radix_depth();
+    test_addr_tracker_contract();
+    test_bitvector_kernel(CU_BITVECTOR_KERNEL_SCALAR, "scalar");
+    test_bitvector_kernel(CU_BITVECTOR_KERNEL_SSE4, "sse4");
+    test_bitvector_kernel(CU_BITVECTOR_KERNEL_AVX2, "avx2");
+    cuibitvectorSelectKernel(CU_BITVECTOR_KERNEL_AUTO);
+
+    std::cout << "All utils tests completed successfully!" << std::endl;
+    return 0;
+}
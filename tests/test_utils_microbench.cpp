@@ -0,0 +1,390 @@
+#include <iostream>
+#include <vector>
+#include <iomanip>
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include "radix.h"
+#include "seglist.h"
+#include "avl.h"
+#include "addrtracker.h"
+#include "bitvector.h"
+#include "latency_histogram.h"
+#include "workload.h"
+
+//
+// Per-structure microbenchmarks for the allocator's inner loops.
+//
+// Every structure is measured at sizes from 10 up to max_elements (10^7 by
+// default, or argv[1]). Small sizes are repeated until enough operations have
+// been timed so the per-op figure is not dominated by clock granularity.
+//
+
+static const uint64_t MIN_OPS_PER_SAMPLE = 1000000;
+
+// Bitvector scans are timed one call at a time, so they need the clock
+// overhead taken out; the batched loops amortize it away.
+static CalibratedTimer timer;
+
+static void
+print_header(void)
+{
+    std::cout << std::left << std::setw(20) << "structure"
+              << std::setw(28) << "operation"
+              << std::right << std::setw(12) << "elements"
+              << std::setw(14) << "ns/op" << std::endl;
+}
+
+static void
+print_row(const char *structure, const char *op, uint64_t elements, uint64_t total_ns, uint64_t ops)
+{
+    std::cout << std::left << std::setw(20) << structure
+              << std::setw(28) << op
+              << std::right << std::setw(12) << elements
+              << std::setw(14) << std::fixed << std::setprecision(2) << (double)total_ns / ops << std::endl;
+}
+
+static uint64_t
+reps_for(uint64_t n)
+{
+    return std::max<uint64_t>(1, MIN_OPS_PER_SAMPLE / n);
+}
+
+//
+// CUradixTree keyed on 63-bit sizes, as used by the allocators
+//
+static void
+bench_radix_tree(uint64_t n, workload::Rng &rng, bool compressed)
+{
+    const char *name = compressed ? "CUradixTree/pc" : "CUradixTree";
+    std::vector<CUradixNode> nodes(n);
+    std::vector<NvU64> keys(n);
+    std::vector<NvU64> queries(n);
+    std::vector<size_t> order(n);
+    std::uniform_int_distribution<NvU64> key_dist(1, 1ULL << 40);
+    for (uint64_t i = 0; i < n; i++) {
+        keys[i] = key_dist(rng);
+        queries[i] = key_dist(rng);
+        order[i] = i;
+    }
+    std::shuffle(order.begin(), order.end(), rng);
+
+    uint64_t reps = reps_for(n);
+    uint64_t insert_ns = 0, find_ns = 0, remove_ns = 0;
+    for (uint64_t r = 0; r < reps; r++) {
+        CUradixTree tree;
+        if (compressed) {
+            radixTreeInitCompressed(&tree, 63);
+        } else {
+            radixTreeInit(&tree, 63);
+        }
+
+        uint64_t start = CalibratedTimer::now();
+        for (uint64_t i = 0; i < n; i++) {
+            radixTreeInsert(&tree, &nodes[i], keys[i]);
+        }
+        insert_ns += CalibratedTimer::now() - start;
+
+        uint64_t found = 0;
+        start = CalibratedTimer::now();
+        for (uint64_t i = 0; i < n; i++) {
+            found += (radixTreeFindGEQ(&tree, queries[i]) != NULL);
+        }
+        find_ns += CalibratedTimer::now() - start;
+        assert(found <= n);
+
+        start = CalibratedTimer::now();
+        for (uint64_t i = 0; i < n; i++) {
+            radixTreeRemove(&nodes[order[i]]);
+        }
+        remove_ns += CalibratedTimer::now() - start;
+        assert(radixTreeEmpty(&tree));
+    }
+
+    print_row(name, "radixTreeInsert", n, insert_ns, n * reps);
+    print_row(name, "radixTreeFindGEQ", n, find_ns, n * reps);
+    print_row(name, "radixTreeRemove", n, remove_ns, n * reps);
+}
+
+static void
+bench_radix(uint64_t n, workload::Rng &rng)
+{
+    bench_radix_tree(n, rng, false);
+}
+
+// Path-compressed variant
+static void
+bench_radix_compressed(uint64_t n, workload::Rng &rng)
+{
+    bench_radix_tree(n, rng, true);
+}
+
+//
+// CUsegList over the same keys, the O(1) alternative to the radix tree
+//
+static void
+bench_seglist(uint64_t n, workload::Rng &rng)
+{
+    std::vector<CUsegListNode> nodes(n);
+    std::vector<NvU64> keys(n);
+    std::vector<NvU64> queries(n);
+    std::vector<size_t> order(n);
+    std::uniform_int_distribution<NvU64> key_dist(1, 1ULL << 40);
+    for (uint64_t i = 0; i < n; i++) {
+        keys[i] = key_dist(rng);
+        queries[i] = key_dist(rng);
+        order[i] = i;
+    }
+    std::shuffle(order.begin(), order.end(), rng);
+
+    // The list heads are too large for the stack
+    std::vector<CUsegList> list(1);
+    uint64_t reps = reps_for(n);
+    uint64_t insert_ns = 0, find_ns = 0, remove_ns = 0;
+    for (uint64_t r = 0; r < reps; r++) {
+        cuSegListInit(&list[0]);
+
+        uint64_t start = CalibratedTimer::now();
+        for (uint64_t i = 0; i < n; i++) {
+            cuSegListInsert(&list[0], &nodes[i], keys[i]);
+        }
+        insert_ns += CalibratedTimer::now() - start;
+
+        uint64_t found = 0;
+        start = CalibratedTimer::now();
+        for (uint64_t i = 0; i < n; i++) {
+            found += (cuSegListFindGEQ(&list[0], queries[i]) != NULL);
+        }
+        find_ns += CalibratedTimer::now() - start;
+        assert(found <= n);
+
+        start = CalibratedTimer::now();
+        for (uint64_t i = 0; i < n; i++) {
+            cuSegListRemove(&list[0], &nodes[order[i]]);
+        }
+        remove_ns += CalibratedTimer::now() - start;
+        assert(cuSegListEmpty(&list[0]));
+    }
+
+    print_row("CUsegList", "cuSegListInsert", n, insert_ns, n * reps);
+    print_row("CUsegList", "cuSegListFindGEQ", n, find_ns, n * reps);
+    print_row("CUsegList", "cuSegListRemove", n, remove_ns, n * reps);
+}
+
+//
+// CUavlTree keyed on NvU64 through the generic comparator
+//
+static int
+avl_compare(CUavlTreeKey a, CUavlTreeKey b)
+{
+    NvU64 ka = *(NvU64 *)a;
+    NvU64 kb = *(NvU64 *)b;
+    return (ka < kb) ? -1 : (ka > kb) ? 1 : 0;
+}
+
+static void
+bench_avl(uint64_t n, workload::Rng &rng)
+{
+    std::vector<CUavlTreeNode> nodes(n);
+    std::vector<NvU64> keys(n);
+    std::vector<size_t> order(n);
+    for (uint64_t i = 0; i < n; i++) {
+        keys[i] = i * 2;  // Unique keys
+        order[i] = i;
+    }
+    std::shuffle(keys.begin(), keys.end(), rng);
+    std::shuffle(order.begin(), order.end(), rng);
+
+    uint64_t reps = reps_for(n);
+    uint64_t insert_ns = 0, find_ns = 0, remove_ns = 0;
+    for (uint64_t r = 0; r < reps; r++) {
+        CUavlTree tree;
+        cuAvlTreeInitialize(&tree, avl_compare, NULL);
+
+        uint64_t start = CalibratedTimer::now();
+        for (uint64_t i = 0; i < n; i++) {
+            cuAvlTreeNodeInsert(&tree, &nodes[i], &keys[i], NULL);
+        }
+        insert_ns += CalibratedTimer::now() - start;
+
+        uint64_t found = 0;
+        start = CalibratedTimer::now();
+        for (uint64_t i = 0; i < n; i++) {
+            found += (cuAvlTreeNodeFind(&tree, &keys[order[i]]) != NULL);
+        }
+        find_ns += CalibratedTimer::now() - start;
+        assert(found == n);
+
+        start = CalibratedTimer::now();
+        for (uint64_t i = 0; i < n; i++) {
+            cuAvlTreeNodeRemove(&tree, &nodes[order[i]]);
+        }
+        remove_ns += CalibratedTimer::now() - start;
+        assert(tree.root == NULL);
+        cuAvlTreeDeinitialize(&tree);
+    }
+
+    print_row("CUavlTree", "cuAvlTreeNodeInsert", n, insert_ns, n * reps);
+    print_row("CUavlTree", "cuAvlTreeNodeFind", n, find_ns, n * reps);
+    print_row("CUavlTree", "cuAvlTreeNodeRemove", n, remove_ns, n * reps);
+}
+
+//
+// CUIaddrTracker over contiguous 2MB ranges, like the arena res_tracker
+//
+static void
+bench_addrtracker(uint64_t n, workload::Rng &rng)
+{
+    const NvU64 range_size = 2ULL << 20;
+    const NvU64 base = 1ULL << 40;
+    std::vector<CUIaddrTrackerNode> nodes(n);
+    std::vector<NvU64> queries(n);
+    std::uniform_int_distribution<NvU64> addr_dist(base, base + n * range_size - 1);
+    for (uint64_t i = 0; i < n; i++) {
+        queries[i] = addr_dist(rng);
+    }
+
+    CUIaddrTracker tracker;
+    cuiAddrTrackerInit(&tracker, 0, 1ULL << 57);
+    for (uint64_t i = 0; i < n; i++) {
+        cuiAddrTrackerRegisterNode(&tracker, &nodes[i], base + i * range_size, range_size, NULL);
+    }
+
+    uint64_t reps = reps_for(n);
+    uint64_t find_ns = 0;
+    uint64_t found = 0;
+    for (uint64_t r = 0; r < reps; r++) {
+        uint64_t start = CalibratedTimer::now();
+        for (uint64_t i = 0; i < n; i++) {
+            found += (cuiAddrTrackerFindNode(&tracker, queries[i]) != NULL);
+        }
+        find_ns += CalibratedTimer::now() - start;
+    }
+    assert(found == n * reps);
+
+    for (uint64_t i = 0; i < n; i++) {
+        cuiAddrTrackerUnregisterNode(&nodes[i]);
+    }
+    cuiAddrTrackerDeinit(&tracker);
+
+    print_row("CUIaddrTracker", "cuiAddrTrackerFindNode", n, find_ns, n * reps);
+}
+
+//
+// CUbitvector scans over an n-bit map. Each scan has to walk the whole map:
+// a single clear (or set) bit sits at a random position in the upper half.
+// Rows are repeated for every chunk scan kernel the CPU supports.
+//
+static void
+bench_bitvector_kernel(uint64_t n, workload::Rng &rng, const char *name)
+{
+    CUbitvector *full = NULL;
+    CUbitvector *empty = NULL;
+    NvBool created = cubitvectorCreate(&full, n) && cubitvectorCreate(&empty, n);
+    assert(created);
+    (void)created;
+    cubitvectorSetAllBits(full);
+
+    const uint64_t num_targets = 64;
+    std::vector<NvU64> targets(num_targets);
+    std::uniform_int_distribution<NvU64> bit_dist(n / 2, n - 1);
+    for (uint64_t i = 0; i < num_targets; i++) {
+        targets[i] = bit_dist(rng);
+    }
+
+    // Enough scans to time reliably, bounded by the number of words walked
+    uint64_t scans = std::max<uint64_t>(num_targets, MIN_OPS_PER_SAMPLE / std::max<uint64_t>(1, n / 64));
+    const NvU64 run_len = 4;
+    uint64_t clear_ns = 0, set_ns = 0, any_ns = 0, all_set_ns = 0, all_clear_ns = 0, run_ns = 0;
+    uint64_t hits = 0;
+    for (uint64_t s = 0; s < scans; s++) {
+        NvU64 target = targets[s % num_targets];
+        NvU64 bit = 0;
+
+        cubitvectorClearBit(full, target);
+        uint64_t start = CalibratedTimer::now();
+        hits += cubitvectorFindLowestClearBitInRange(full, 0, n - 1, &bit);
+        clear_ns += timer.elapsed(start, CalibratedTimer::now());
+        assert(bit == target);
+
+        start = CalibratedTimer::now();
+        hits += !cubitvectorAreAllBitsSetInRange(full, 0, n - 1);
+        all_set_ns += timer.elapsed(start, CalibratedTimer::now());
+        cubitvectorSetBit(full, target);
+
+        NvU64 run_start = std::min<NvU64>(target, n - run_len);
+        cubitvectorClearBitsInRange(full, run_start, run_start + run_len - 1);
+        start = CalibratedTimer::now();
+        hits += cubitvectorFindClearRun(full, run_len, 0, &bit);
+        run_ns += timer.elapsed(start, CalibratedTimer::now());
+        assert(bit == run_start);
+        cubitvectorSetBitsInRange(full, run_start, run_start + run_len - 1);
+
+        cubitvectorSetBit(empty, target);
+        start = CalibratedTimer::now();
+        hits += cubitvectorFindLowestSetBitInRange(empty, 0, n - 1, &bit);
+        set_ns += timer.elapsed(start, CalibratedTimer::now());
+        assert(bit == target);
+
+        start = CalibratedTimer::now();
+        hits += !cubitvectorAreAllBitsClearInRange(empty, 0, n - 1);
+        all_clear_ns += timer.elapsed(start, CalibratedTimer::now());
+        cubitvectorClearBit(empty, target);
+
+        start = CalibratedTimer::now();
+        hits += !cubitvectorIsAnyBitSet(empty);
+        any_ns += timer.elapsed(start, CalibratedTimer::now());
+    }
+    assert(hits == scans * 6);
+
+    cubitvectorDestroy(full);
+    cubitvectorDestroy(empty);
+
+    print_row(name, "FindLowestClearBitInRange", n, clear_ns, scans);
+    print_row(name, "FindLowestSetBitInRange", n, set_ns, scans);
+    print_row(name, "FindClearRun(4)", n, run_ns, scans);
+    print_row(name, "AreAllBitsSetInRange", n, all_set_ns, scans);
+    print_row(name, "AreAllBitsClearInRange", n, all_clear_ns, scans);
+    print_row(name, "IsAnyBitSet", n, any_ns, scans);
+}
+
+static void
+bench_bitvector(uint64_t n, workload::Rng &rng)
+{
+    const struct {
+        CUbitvectorKernel kernel;
+        const char *name;
+    } kernels[] = {
+        {CU_BITVECTOR_KERNEL_SCALAR, "CUbitvector/scalar"},
+        {CU_BITVECTOR_KERNEL_SSE4, "CUbitvector/sse4"},
+        {CU_BITVECTOR_KERNEL_AVX2, "CUbitvector/avx2"},
+    };
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        if (cuibitvectorSelectKernel(kernels[k].kernel)) {
+            workload::Rng kernel_rng = rng;
+            bench_bitvector_kernel(n, kernel_rng, kernels[k].name);
+        }
+    }
+    cuibitvectorSelectKernel(CU_BITVECTOR_KERNEL_AUTO);
+}
+
+int main(int argc, char **argv) {
+    uint64_t max_elements = 10000000;
+    if (argc > 1) {
+        max_elements = std::strtoull(argv[1], NULL, 0);
+    }
+
+    std::cout << "Utils microbenchmarks up to " << max_elements << " elements (seed "
+              << workload::default_seed() << ")" << std::endl;
+    print_header();
+
+    typedef void (*bench_fn)(uint64_t n, workload::Rng &rng);
+    const bench_fn benches[] = {bench_radix, bench_radix_compressed, bench_seglist, bench_avl, bench_addrtracker, bench_bitvector};
+    for (bench_fn bench : benches) {
+        for (uint64_t n = 10; n <= max_elements; n *= 10) {
+            workload::Rng rng(workload::default_seed());
+            bench(n, rng);
+        }
+    }
+    return 0;
+}
@@ -1,7 +1,16 @@
 #include <iostream>
 #include <vector>
+#include <map>
+#include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <random>
+#include <unistd.h>
+#include <fcntl.h>
 #include "va_allocator.h"
+#include "workload.h"
 
 void test_basic_allocation(void) {
     va_allocator_t *allocator = va_allocator_init(VA_ALLOCATOR_TYPE_DEFAULT);
@@ -66,7 +75,9 @@ void test_severe_fragmentation(void) {
     std::vector<uint64_t> small_blocks;
     std::vector<uint64_t> medium_blocks;
 
-    while (true) {
+    // Large objects are not bounded by a reservation size, so stop at 8GB
+    const uint64_t max_medium_size = 8ULL * 1024 * 1024 * 1024;
+    while (medium_size <= max_medium_size) {
         iteration++;
 
         // Allocate new blocks first
@@ -133,6 +144,397 @@ void test_severe_fragmentation(void) {
     va_allocator_destroy(allocator);
 }
 
+// Every size index must hand out non-overlapping blocks and keep the
+// accounting exact under the same seeded request stream.
+void test_size_index_config(va_allocator_type_t type, va_size_index_type_t size_index) {
+    va_allocator_config_t config;
+    va_allocator_config_default(&config);
+    config.size_index = size_index;
+    va_allocator_t *allocator = va_allocator_init_with_config(type, &config);
+    assert(allocator != NULL);
+
+    const uint64_t KB = 1024;
+    workload::Generator gen(workload::steady(workload::lognormal_sizes(16 * KB, 2.0, 1, 32 * 1024 * KB),
+                                             0.55, workload::LIFETIME_RANDOM),
+                            workload::default_seed());
+    std::map<uint64_t, uint64_t> live;  // addr -> size
+    uint64_t live_bytes = 0;
+    for (int i = 0; i < 20000; i++) {
+        workload::Op op = gen.next();
+        if (op.kind == workload::Op::ALLOC) {
+            uint64_t addr = va_alloc(allocator, op.size);
+            assert(addr != 0);
+            auto next = live.lower_bound(addr);
+            assert(next == live.end() || addr + op.size <= next->first);
+            assert(next == live.begin() || std::prev(next)->first + std::prev(next)->second <= addr);
+            live[addr] = op.size;
+            live_bytes += op.size;
+            gen.allocated(addr, op.size);
+        } else {
+            va_free(allocator, op.addr);
+            live_bytes -= live[op.addr];
+            live.erase(op.addr);
+        }
+    }
+
+    // Slabs account whole blocks, so only the default allocator tracks request sizes exactly
+    if (type == VA_ALLOCATOR_TYPE_DEFAULT) {
+        assert(va_allocator_get_used_size(allocator) == live_bytes);
+    }
+
+    workload::LiveBlock block;
+    while (gen.pop_live(&block)) {
+        va_free(allocator, block.addr);
+    }
+    assert(va_allocator_get_used_size(allocator) == 0);
+
+    va_allocator_frag_stats_t stats;
+    va_allocator_get_frag_stats(allocator, &stats);
+    assert(stats.free_size == stats.reserved_size);
+    va_allocator_destroy(allocator);
+}
+
+void test_invalid_config(void) {
+    va_allocator_config_t config;
+    va_allocator_config_default(&config);
+    config.size_index = VA_SIZE_INDEX_MAX;
+    assert(va_allocator_init_with_config(VA_ALLOCATOR_TYPE_DEFAULT, &config) == NULL);
+    assert(va_allocator_init_with_config(VA_ALLOCATOR_TYPE_DEFAULT, NULL) == NULL);
+}
+
+// The default allocator starts with one chunk, grows on demand past the old
+// fixed 4GB ceiling and respects an explicit cap.
+void test_default_growth(void) {
+    const uint64_t MB = 1024 * 1024;
+    va_allocator_config_t config;
+    va_allocator_config_default(&config);
+    config.default_chunk_size = MB;
+    va_allocator_t *allocator = va_allocator_init_with_config(VA_ALLOCATOR_TYPE_DEFAULT, &config);
+    assert(allocator != NULL);
+    assert(va_allocator_get_total_size(allocator) == MB);
+
+    std::map<uint64_t, uint64_t> live;
+    for (int i = 0; i < 1000; i++) {
+        uint64_t size = (i % 7 + 1) * 16 * 1024;
+        uint64_t addr = va_alloc(allocator, size);
+        assert(addr != 0);
+        auto next = live.lower_bound(addr);
+        assert(next == live.end() || addr + size <= next->first);
+        assert(next == live.begin() || std::prev(next)->first + std::prev(next)->second <= addr);
+        live[addr] = size;
+    }
+    // Geometric growth keeps the reservation within a small factor of demand
+    assert(va_allocator_get_total_size(allocator) < 4 * va_allocator_get_used_size(allocator));
+
+    uint64_t huge = va_alloc(allocator, 5ULL << 30);
+    assert(huge != 0);
+    assert(va_commit(allocator, huge + (5ULL << 30) - 4096, 4096) == 0);
+    va_free(allocator, huge);
+    for (auto &block : live) {
+        va_free(allocator, block.first);
+    }
+    assert(va_allocator_get_used_size(allocator) == 0);
+
+    va_allocator_frag_stats_t stats;
+    va_allocator_get_frag_stats(allocator, &stats);
+    assert(stats.free_size == stats.reserved_size);
+    va_allocator_destroy(allocator);
+
+    config.default_max_size = 4 * MB;
+    allocator = va_allocator_init_with_config(VA_ALLOCATOR_TYPE_DEFAULT, &config);
+    assert(allocator != NULL);
+    assert(va_alloc(allocator, 5 * MB) == 0);
+    uint64_t a = va_alloc(allocator, 3 * MB);
+    assert(a != 0);
+    assert(va_alloc(allocator, 2 * MB) == 0);
+    assert(va_alloc(allocator, MB) != 0);
+    assert(va_allocator_get_total_size(allocator) == 4 * MB);
+    va_allocator_destroy(allocator);
+
+    config.default_chunk_size = 1000;  // Not a page multiple
+    assert(va_allocator_init_with_config(VA_ALLOCATOR_TYPE_DEFAULT, &config) == NULL);
+}
+
+// Committed pages must be usable, accounted once, and read back as zero after
+// a decommit/recommit cycle.
+void test_commit(va_allocator_type_t type) {
+    va_allocator_t *allocator = va_allocator_init(type);
+    assert(allocator != NULL);
+
+    const uint64_t page = 4096;
+    const uint64_t size = 1024 * 1024;
+    uint64_t addr = va_alloc(allocator, size);
+    assert(addr != 0);
+    assert(va_allocator_get_committed_size(allocator) == 0);
+
+    // Unaligned ranges round out to whole pages
+    assert(va_commit(allocator, addr + 1, page) == 0);
+    assert(va_allocator_get_committed_size(allocator) == 2 * page);
+    assert(va_commit(allocator, addr, 2 * page) == 0);
+    assert(va_allocator_get_committed_size(allocator) == 2 * page);
+
+    // Overlapping and touching ranges in any order merge into one
+    va_range_t ranges[] = {
+        { addr + size / 2, size / 2 },
+        { addr, size / 4 },
+        { addr + size / 4, size / 4 },
+        { addr + page, page },
+    };
+    assert(va_commit_ranges(allocator, ranges, 4) == 0);
+    assert(va_allocator_get_committed_size(allocator) == size);
+
+    memset((void *)(uintptr_t)addr, 0xab, size);
+
+    assert(va_decommit(allocator, addr + size / 2, size / 2) == 0);
+    assert(va_allocator_get_committed_size(allocator) == size / 2);
+    assert(va_commit(allocator, addr + size / 2, size / 2) == 0);
+    const unsigned char *bytes = (const unsigned char *)(uintptr_t)addr;
+    assert(bytes[0] == 0xab && bytes[size / 2 - 1] == 0xab);
+    assert(bytes[size / 2] == 0 && bytes[size - 1] == 0);
+
+    va_allocator_frag_stats_t stats;
+    va_allocator_get_frag_stats(allocator, &stats);
+    assert(stats.committed_size == size);
+
+    // Nothing is applied if any range of a batch lies outside the reservations
+    va_range_t bad[] = { { addr, size }, { page, page } };
+    assert(va_decommit_ranges(allocator, bad, 2) == -1);
+    assert(va_allocator_get_committed_size(allocator) == size);
+    assert(va_commit(allocator, addr, 0) == -1);
+
+    assert(va_decommit(allocator, addr, size) == 0);
+    assert(va_allocator_get_committed_size(allocator) == 0);
+
+    va_free(allocator, addr);
+    va_allocator_destroy(allocator);
+}
+
+// Instances of one type must not share state: each thread churns its own
+// allocator, and afterwards every instance accounts exactly its own blocks
+// and no block of one instance overlaps a block of another.
+void test_concurrent_instances(va_allocator_type_t type) {
+    const int num_instances = 8;
+    const uint64_t page = 4096;
+
+    va_allocator_config_t config;
+    va_allocator_config_default(&config);
+    config.shared_size = 1024ULL * 1024 * 1024;
+
+    std::vector<va_allocator_t *> allocators(num_instances);
+    std::vector<std::map<uint64_t, uint64_t> > live(num_instances);
+    std::vector<uint64_t> expected(num_instances, 0);
+    for (int i = 0; i < num_instances; i++) {
+        allocators[i] = va_allocator_init_with_config(type, &config);
+        assert(allocators[i] != NULL);
+    }
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_instances; i++) {
+        threads.emplace_back([&, i]() {
+            workload::Rng gen(workload::default_seed() + i);
+            std::uniform_int_distribution<uint64_t> pages_dist(1, 256);
+            std::uniform_real_distribution<> op_dist(0, 1);
+            std::vector<uint64_t> order;
+            for (int op = 0; op < 5000; op++) {
+                if (order.empty() || op_dist(gen) < 0.6) {
+                    uint64_t size = pages_dist(gen) * page;
+                    uint64_t addr = va_alloc(allocators[i], size);
+                    assert(addr != 0);
+                    live[i][addr] = size;
+                    order.push_back(addr);
+                    expected[i] += size;
+                } else {
+                    size_t idx = std::uniform_int_distribution<size_t>(0, order.size() - 1)(gen);
+                    va_free(allocators[i], order[idx]);
+                    expected[i] -= live[i][order[idx]];
+                    live[i].erase(order[idx]);
+                    order[idx] = order.back();
+                    order.pop_back();
+                }
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    std::map<uint64_t, uint64_t> all;
+    for (int i = 0; i < num_instances; i++) {
+        assert(va_allocator_get_used_size(allocators[i]) == expected[i]);
+        all.insert(live[i].begin(), live[i].end());
+    }
+    uint64_t end = 0;
+    for (const auto &block : all) {
+        assert(block.first >= end);
+        end = block.first + block.second;
+    }
+
+    for (int i = 0; i < num_instances; i++) {
+        for (const auto &block : live[i]) {
+            va_free(allocators[i], block.first);
+        }
+        assert(va_allocator_get_used_size(allocators[i]) == 0);
+        va_allocator_destroy(allocators[i]);
+    }
+}
+
+// Stage counters are only available in VA_STAGE_TIMERS builds, and then every
+// stage on the paths exercised here must have run
+void test_stage_stats(va_allocator_type_t type) {
+    va_allocator_t *allocator = va_allocator_init(type);
+    assert(allocator != NULL);
+
+    std::vector<uint64_t> addrs;
+    for (uint64_t size : {256ULL, 100000ULL, 64ULL << 20, 4096ULL, 3000000ULL}) {
+        addrs.push_back(va_alloc(allocator, size));
+        assert(addrs.back() != 0);
+    }
+    for (uint64_t addr : addrs) {
+        va_free(allocator, addr);
+    }
+
+    va_stage_stats_t stats;
+#ifdef VA_STAGE_TIMERS
+    bool timed = type != VA_ALLOCATOR_TYPE_SHARED;
+#else
+    bool timed = false;
+#endif
+    if (!timed) {
+        assert(va_allocator_get_stage_stats(allocator, &stats) == -1);
+        va_allocator_destroy(allocator);
+        return;
+    }
+
+    assert(va_allocator_get_stage_stats(allocator, &stats) == 0);
+    std::vector<va_stage_t> expected = {VA_STAGE_SIZE_INDEX, VA_STAGE_ADDR_LIST, VA_STAGE_RESERVE,
+                                        VA_STAGE_RESERVATION_LOOKUP};
+    if (type == VA_ALLOCATOR_TYPE_ARENA) {
+        expected.push_back(VA_STAGE_SIZE_CLASS);
+        expected.push_back(VA_STAGE_RESERVATION_SCAN);
+        expected.push_back(VA_STAGE_BITMAP_SEARCH);
+    }
+    for (va_stage_t stage : expected) {
+        assert(stats.calls[stage] > 0);
+        assert(std::string(va_stage_name(stage)) != "unknown");
+    }
+    assert(stats.calls[VA_STAGE_RESERVATION_LOOKUP] == addrs.size());
+
+    va_allocator_reset_stage_stats(allocator);
+    assert(va_allocator_get_stage_stats(allocator, &stats) == 0);
+    for (int stage = 0; stage < VA_STAGE_MAX; stage++) {
+        assert(stats.calls[stage] == 0 && stats.cycles[stage] == 0);
+    }
+    va_allocator_destroy(allocator);
+}
+
+// A restored allocator must have the same layout: identical stats, the old
+// blocks still freeable, and nothing that was free handed out twice.
+void test_snapshot(va_allocator_type_t type, uint64_t region_size) {
+    va_allocator_config_t config;
+    va_allocator_config_default(&config);
+    config.arena_region_size = region_size;
+    va_allocator_t *allocator = va_allocator_init_with_config(type, &config);
+    assert(allocator != NULL);
+
+    workload::Rng gen(workload::default_seed());
+    std::uniform_int_distribution<uint64_t> size_dist(256, 4 * 1024 * 1024);
+    std::vector<uint64_t> live;
+    for (int i = 0; i < 2000; i++) {
+        uint64_t addr = va_alloc(allocator, size_dist(gen));
+        assert(addr != 0);
+        live.push_back(addr);
+    }
+    uint64_t large = va_alloc(allocator, 96 * 1024 * 1024);
+    uint64_t cached = va_alloc(allocator, 64 * 1024 * 1024);
+    assert(large != 0 && cached != 0);
+    live.push_back(large);
+    va_free(allocator, cached);
+    for (size_t i = 0; i < live.size(); i += 3) {
+        va_free(allocator, live[i]);
+        live[i] = 0;
+    }
+    assert(va_commit(allocator, live[1], 1) == 0);
+
+    va_allocator_frag_stats_t before;
+    va_allocator_get_frag_stats(allocator, &before);
+
+    const std::string path = "/tmp/va_snapshot_test_" + std::to_string(getpid());
+    assert(va_allocator_snapshot(allocator, path.c_str()) == 0);
+
+    // The VA is still mapped by the original
+    assert(va_allocator_restore(path.c_str()) == NULL);
+    for (uint64_t addr : live) {
+        if (addr) {
+            va_free(allocator, addr);
+        }
+    }
+    va_allocator_destroy(allocator);
+
+    allocator = va_allocator_restore(path.c_str());
+    assert(allocator != NULL);
+    va_allocator_frag_stats_t after;
+    va_allocator_get_frag_stats(allocator, &after);
+    assert(after.reserved_size == before.reserved_size);
+    assert(after.used_size == before.used_size);
+    assert(after.free_size == before.free_size);
+    assert(after.largest_free == before.largest_free);
+    assert(after.free_extents == before.free_extents);
+    assert(after.committed_size == 0);
+
+    // New blocks must not overlap the restored ones
+    std::vector<uint64_t> fresh;
+    for (int i = 0; i < 500; i++) {
+        uint64_t addr = va_alloc(allocator, size_dist(gen));
+        assert(addr != 0);
+        assert(std::find(live.begin(), live.end(), addr) == live.end());
+        fresh.push_back(addr);
+    }
+    for (uint64_t addr : live) {
+        if (addr) {
+            va_free(allocator, addr);
+        }
+    }
+    for (uint64_t addr : fresh) {
+        va_free(allocator, addr);
+    }
+    assert(va_allocator_get_used_size(allocator) == 0);
+    va_allocator_destroy(allocator);
+
+    // Header fields are uint64_t words: magic, version, type, header size,
+    // then the configuration. A wrong version or an out-of-range config field
+    // is rejected, and the unmodified file still restores.
+    const struct { off_t word; uint64_t value; } corrupt[] = {
+        { 1, 1 },                                  // Version 1 embedded the raw config struct
+        { 3, 8 * 13 },                             // Header from a build with fewer config fields
+        { 4, VA_SIZE_INDEX_MAX },                  // size_index
+        { 6, 2 },                                  // reservation_pool_thread
+        { 13, 1ULL << 32 },                        // arena_quick_list_depth
+    };
+    for (const auto &c : corrupt) {
+        int fd = open(path.c_str(), O_RDWR);
+        assert(fd >= 0);
+        uint64_t saved;
+        assert(pread(fd, &saved, sizeof(saved), c.word * 8) == sizeof(saved));
+        assert(pwrite(fd, &c.value, sizeof(c.value), c.word * 8) == sizeof(c.value));
+        assert(va_allocator_restore(path.c_str()) == NULL);
+        assert(pwrite(fd, &saved, sizeof(saved), c.word * 8) == sizeof(saved));
+        close(fd);
+    }
+    allocator = va_allocator_restore(path.c_str());
+    assert(allocator != NULL);
+    for (uint64_t addr : live) {
+        if (addr) {
+            va_free(allocator, addr);
+        }
+    }
+    va_allocator_destroy(allocator);
+
+    // A truncated file is rejected
+    assert(truncate(path.c_str(), 100) == 0);
+    assert(va_allocator_restore(path.c_str()) == NULL);
+    unlink(path.c_str());
+}
+
 int main(void) {
     std::cout << "Testing basic allocation..." << std::endl;
     test_basic_allocation();
@@ -140,6 +542,31 @@ int main(void) {
     test_fragmentation();
     std::cout << "\nTesting severe fragmentation..." << std::endl;
     test_severe_fragmentation();
+    std::cout << "\nTesting size index selection..." << std::endl;
+    for (int type = 0; type < VA_ALLOCATOR_TYPE_MAX; type++) {
+        for (int index = 0; index < VA_SIZE_INDEX_MAX; index++) {
+            test_size_index_config((va_allocator_type_t)type, (va_size_index_type_t)index);
+        }
+    }
+    test_invalid_config();
+    std::cout << "\nTesting default allocator growth..." << std::endl;
+    test_default_growth();
+    std::cout << "\nTesting commit/decommit..." << std::endl;
+    for (int type = 0; type < VA_ALLOCATOR_TYPE_MAX; type++) {
+        test_commit((va_allocator_type_t)type);
+    }
+    std::cout << "\nTesting snapshot/restore..." << std::endl;
+    test_snapshot(VA_ALLOCATOR_TYPE_DEFAULT, 0);
+    test_snapshot(VA_ALLOCATOR_TYPE_ARENA, 0);
+    test_snapshot(VA_ALLOCATOR_TYPE_ARENA, 1024ULL * 1024 * 1024);
+    std::cout << "\nTesting stage timers..." << std::endl;
+    for (int type = 0; type < VA_ALLOCATOR_TYPE_MAX; type++) {
+        test_stage_stats((va_allocator_type_t)type);
+    }
+    std::cout << "\nTesting concurrent instances..." << std::endl;
+    for (int type = 0; type < VA_ALLOCATOR_TYPE_MAX; type++) {
+        test_concurrent_instances((va_allocator_type_t)type);
+    }
 
     return 0;
 } 
\ No newline at end of file
@@ -3,7 +3,9 @@
 #include <cassert>
 #include <random>
 #include <algorithm>
+#include <cstring>
 #include "va_allocator.h"
+#include "workload.h"
 
 // Test small allocations that should use slab allocator
 void test_slab_allocation(void)
@@ -108,8 +110,7 @@ void test_mixed_allocation(void)
     std::cout << "Testing mixed allocation patterns..." << std::endl;
 
     std::vector<uint64_t> addresses;
-    std::random_device rd;
-    std::mt19937 gen(rd());
+    workload::Rng gen(workload::default_seed());
     std::uniform_int_distribution<> size_dist(256, 32 * 1024 * 1024); // 256B to 32MB
 
     // Allocate random sizes
@@ -155,8 +156,7 @@ void test_fragmentation(void)
     const size_t num_blocks = 1000;
     std::vector<uint64_t> addresses;
     std::vector<uint64_t> sizes;
-    std::random_device rd;
-    std::mt19937 gen(rd());
+    workload::Rng gen(workload::default_seed());
     std::uniform_int_distribution<> size_dist(256, 4096); // 256B to 4KB
 
     // Create fragmentation pattern
@@ -202,8 +202,7 @@ void test_rapid_alloc_free(void)
     std::cout << "Testing rapid allocation/deallocation..." << std::endl;
 
     const size_t num_iterations = 10000;
-    std::random_device rd;
-    std::mt19937 gen(rd());
+    workload::Rng gen(workload::default_seed());
     std::uniform_int_distribution<> size_dist(256, 32 * 1024 * 1024); // 256B to 32MB
 
     for (size_t i = 0; i < num_iterations; i++) {
@@ -263,8 +262,7 @@ void test_random_patterns(void)
     const size_t num_operations = 10000;
     std::vector<uint64_t> addresses;
     std::vector<uint64_t> sizes;
-    std::random_device rd;
-    std::mt19937 gen(rd());
+    workload::Rng gen(workload::default_seed());
     std::uniform_int_distribution<> size_dist(256, 32 * 1024 * 1024); // 256B to 32MB
     std::uniform_real_distribution<> op_dist(0, 1);
 
@@ -299,8 +297,464 @@ void test_random_patterns(void)
     va_allocator_destroy(allocator);
 }
 
+// Reservations taken from the pool must behave like freshly created ones:
+// distinct blocks, exact accounting and clean teardown with the pool still full.
+void test_reservation_pool(int threaded)
+{
+    std::cout << "Testing reservation pool (" << (threaded ? "background thread" : "inline refill") << ")..." << std::endl;
+
+    va_allocator_config_t config;
+    va_allocator_config_default(&config);
+    config.reservation_pool_depth = 4;
+    config.reservation_pool_thread = threaded;
+    va_allocator_t *allocator = va_allocator_init_with_config(VA_ALLOCATOR_TYPE_ARENA, &config);
+    assert(allocator != NULL);
+
+    // 1MB blocks fill a 64MB reservation every 64 allocations; 512B blocks a 2MB slab every 4096
+    const uint64_t MB = 1024 * 1024;
+    std::vector<uint64_t> addresses;
+    for (int i = 0; i < 64 * 10; i++) {
+        uint64_t addr = va_alloc(allocator, MB);
+        assert(addr != 0);
+        addresses.push_back(addr);
+    }
+    for (int i = 0; i < 4096 * 3; i++) {
+        uint64_t addr = va_alloc(allocator, 512);
+        assert(addr != 0);
+        addresses.push_back(addr);
+    }
+
+    std::vector<uint64_t> sorted = addresses;
+    std::sort(sorted.begin(), sorted.end());
+    assert(std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end());
+    assert(va_allocator_get_used_size(allocator) == 64 * 10 * MB + 4096 * 3 * 512);
+    // Pooled reservations are not counted until they are taken
+    assert(va_allocator_get_total_size(allocator) == 10 * 64 * MB + 3 * 2 * MB);
+
+    for (uint64_t addr : addresses) {
+        va_free(allocator, addr);
+    }
+    assert(va_allocator_get_used_size(allocator) == 0);
+
+    va_allocator_destroy(allocator);
+}
+
+// Reservations carved from the region, and those mapped separately once it
+// is full, must both resolve on free and commit and tear down cleanly.
+void test_region_mode(void)
+{
+    std::cout << "Testing single-region reservations..." << std::endl;
+
+    const uint64_t MB = 1024 * 1024;
+    const uint64_t GB = 1024 * MB;
+    va_allocator_config_t config;
+    va_allocator_config_default(&config);
+    config.arena_region_size = 1 * GB;
+    va_allocator_t *allocator = va_allocator_init_with_config(VA_ALLOCATOR_TYPE_ARENA, &config);
+    assert(allocator != NULL);
+
+    // Small blocks in every slab/object arena take 624MB of the region. The
+    // second 512MB reservation of the 32MB arena no longer fits in it, and
+    // large objects never come from the region.
+    std::vector<uint64_t> addresses;
+    const std::vector<uint64_t> sizes = {512, 1024, 2048, 4096, 64 * 1024, 2 * MB, 32 * MB};
+    for (uint64_t size : sizes) {
+        for (int i = 0; i < 8; i++) {
+            uint64_t addr = va_alloc(allocator, size);
+            assert(addr != 0);
+            addresses.push_back(addr);
+        }
+    }
+    for (int i = 0; i < 16; i++) {
+        uint64_t addr = va_alloc(allocator, 32 * MB);
+        assert(addr != 0);
+        addresses.push_back(addr);
+    }
+    for (int i = 0; i < 3; i++) {
+        uint64_t addr = va_alloc(allocator, 3 * GB / 2);
+        assert(addr != 0);
+        addresses.push_back(addr);
+    }
+
+    std::vector<uint64_t> sorted = addresses;
+    std::sort(sorted.begin(), sorted.end());
+    assert(std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end());
+
+    // Slab blocks share pages, so count each page once
+    std::vector<uint64_t> pages;
+    for (uint64_t addr : addresses) {
+        assert(va_commit(allocator, addr, 8) == 0);
+        *(volatile uint64_t *)(uintptr_t)addr = addr;
+        pages.push_back(addr / 4096);
+    }
+    std::sort(pages.begin(), pages.end());
+    pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+    assert(va_allocator_get_committed_size(allocator) == pages.size() * 4096);
+    for (uint64_t addr : addresses) {
+        assert(*(volatile uint64_t *)(uintptr_t)addr == addr);
+    }
+    for (uint64_t addr : addresses) {
+        assert(va_decommit(allocator, addr, 8) == 0);
+        va_free(allocator, addr);
+    }
+    assert(va_allocator_get_used_size(allocator) == 0);
+    assert(va_allocator_get_committed_size(allocator) == 0);
+
+    va_allocator_destroy(allocator);
+}
+
+// Large objects get exactly sized extents, with no 2GB limit. Freed extents
+// are reused and split before any new VA is reserved, and merge back together.
+// The cache uses the configured size index like the object arenas do.
+void test_large_objects(va_size_index_type_t size_index)
+{
+    std::cout << "Testing large-object extents (size index " << size_index << ")..." << std::endl;
+
+    const uint64_t MB = 1024 * 1024;
+    const uint64_t GB = 1024 * MB;
+    va_allocator_config_t config;
+    va_allocator_config_default(&config);
+    config.size_index = size_index;
+    va_allocator_t *allocator = va_allocator_init_with_config(VA_ALLOCATOR_TYPE_ARENA, &config);
+    assert(allocator != NULL);
+
+    uint64_t big = va_alloc(allocator, 3 * GB + 1);
+    assert(big != 0);
+    assert(va_allocator_get_total_size(allocator) == 3 * GB + 4096);
+    assert(va_commit(allocator, big + 3 * GB, 1) == 0);
+    *(volatile uint8_t *)(uintptr_t)(big + 3 * GB) = 1;
+    assert(va_allocator_get_committed_size(allocator) == 4096);
+    va_free(allocator, big);
+    assert(va_allocator_get_used_size(allocator) == 0);
+    assert(va_allocator_get_committed_size(allocator) == 0);
+
+    // Both come out of the cached extent: the first splits it, the second
+    // takes the tail whole as what would be left is too small to split off
+    uint64_t a = va_alloc(allocator, 1 * GB);
+    uint64_t b = va_alloc(allocator, 2 * GB - 16 * MB);
+    assert(a == big);
+    assert(b == big + 1 * GB);
+    assert(va_allocator_get_total_size(allocator) == 3 * GB + 4096);
+    assert(va_allocator_get_used_size(allocator) == 3 * GB - 16 * MB);
+    // Cached extents cannot be committed
+    assert(va_commit(allocator, big, 1) == 0);
+    va_free(allocator, a);
+    assert(va_commit(allocator, big, 1) != 0);
+    va_free(allocator, b);
+
+    va_allocator_frag_stats_t stats = {};
+    va_allocator_get_frag_stats(allocator, &stats);
+    assert(stats.free_extents == 1);
+    assert(stats.largest_free == 3 * GB + 4096);
+    assert(stats.committed_size == 0);
+
+    va_allocator_destroy(allocator);
+
+    // Beyond the cache cap, freed extents are unmapped
+    config.arena_large_cache_size = 1 * GB;
+    allocator = va_allocator_init_with_config(VA_ALLOCATOR_TYPE_ARENA, &config);
+    assert(allocator != NULL);
+    a = va_alloc(allocator, 3 * GB / 2);
+    assert(a != 0);
+    va_free(allocator, a);
+    assert(va_allocator_get_total_size(allocator) == 0);
+    a = va_alloc(allocator, 512 * MB);
+    assert(a != 0);
+    va_free(allocator, a);
+    assert(va_allocator_get_total_size(allocator) == 512 * MB);
+    b = va_alloc(allocator, 512 * MB);
+    assert(b == a);
+    va_free(allocator, b);
+    va_allocator_destroy(allocator);
+}
+
+static int relocate_block(void *ctx, const va_relocation_t *move)
+{
+    va_allocator_t *allocator = (va_allocator_t *)ctx;
+    if (va_commit(allocator, move->dst, move->size) != 0) {
+        return -1;
+    }
+    memcpy((void *)(uintptr_t)move->dst, (const void *)(uintptr_t)move->src, move->size);
+    return 0;
+}
+
+// Sparse reservations are emptied into the fullest one. A cancelled plan
+// changes nothing, an applied one moves the data and unmaps the emptied ones.
+// With deferred frees the moved sources must still be released before the
+// emptied reservations are checked.
+void test_compaction(uint32_t deferred_free_batch)
+{
+    std::cout << "Testing compaction plans (deferred free batch " << deferred_free_batch << ")..." << std::endl;
+
+    const uint64_t MB = 1024 * 1024;
+    va_allocator_config_t config;
+    va_allocator_config_default(&config);
+    config.arena_deferred_free_batch = deferred_free_batch;
+    va_allocator_t *allocator = va_allocator_init_with_config(VA_ALLOCATOR_TYPE_ARENA, &config);
+    assert(allocator != NULL);
+
+    // Three 64MB reservations of 1MB blocks and three 2MB slabs of 512B
+    // blocks, keeping every 8th and 16th block respectively
+    std::vector<uint64_t> live;
+    std::vector<uint64_t> sizes;
+    const std::vector<std::pair<uint64_t, int>> classes = {{MB, 64 * 3}, {512, 4096 * 3}};
+    for (const auto &size_class : classes) {
+        std::vector<uint64_t> blocks;
+        for (int i = 0; i < size_class.second; i++) {
+            uint64_t addr = va_alloc(allocator, size_class.first);
+            assert(addr != 0);
+            blocks.push_back(addr);
+        }
+        size_t keep = (size_class.first == MB) ? 8 : 16;
+        for (size_t i = 0; i < blocks.size(); i++) {
+            if (i % keep) {
+                va_free(allocator, blocks[i]);
+            } else {
+                live.push_back(blocks[i]);
+                sizes.push_back(size_class.first);
+            }
+        }
+    }
+    for (size_t i = 0; i < live.size(); i++) {
+        assert(va_commit(allocator, live[i], sizes[i]) == 0);
+        *(volatile uint64_t *)(uintptr_t)live[i] = live[i];
+    }
+
+    const uint64_t total = va_allocator_get_total_size(allocator);
+    const uint64_t used = va_allocator_get_used_size(allocator);
+    assert(total == 3 * 64 * MB + 3 * 2 * MB);
+
+    va_compaction_plan_t plan;
+    assert(va_compaction_plan(allocator, &plan) == 0);
+    assert(plan.move_count == 2 * 8 + 2 * 256);
+    assert(plan.reclaim_size == 2 * 64 * MB + 2 * 2 * MB);
+
+    // Nothing lands in a reservation being evacuated. Live 1MB blocks sit at
+    // the start of each 8MB stride, so each group of 8 starts a reservation.
+    std::vector<uint64_t> srcs;
+    for (size_t i = 0; i < plan.move_count; i++) {
+        if (plan.moves[i].size == MB) {
+            srcs.push_back(plan.moves[i].src);
+        }
+    }
+    std::sort(srcs.begin(), srcs.end());
+    uint64_t extra = va_alloc(allocator, MB);
+    assert(extra != 0);
+    for (size_t i = 0; i < srcs.size(); i += 8) {
+        assert(extra - srcs[i] >= 64 * MB);
+    }
+    va_free(allocator, extra);
+
+    assert(va_compaction_apply(allocator, &plan, NULL, NULL) == 0);
+    assert(plan.moves == NULL && plan.move_count == 0);
+    assert(va_allocator_get_total_size(allocator) == total);
+    assert(va_allocator_get_used_size(allocator) == used);
+
+    assert(va_compaction_plan(allocator, &plan) == 0);
+    assert(plan.move_count == 2 * 8 + 2 * 256);
+    std::vector<va_relocation_t> moves(plan.moves, plan.moves + plan.move_count);
+    uint64_t released = va_compaction_apply(allocator, &plan, relocate_block, allocator);
+    assert(released == 2 * 64 * MB + 2 * 2 * MB);
+    assert(va_allocator_get_total_size(allocator) == total - released);
+    assert(va_allocator_get_used_size(allocator) == used);
+
+    for (const va_relocation_t &move : moves) {
+        auto it = std::find(live.begin(), live.end(), move.src);
+        assert(it != live.end());
+        *it = move.dst;
+        assert(*(volatile uint64_t *)(uintptr_t)move.dst == move.src);
+    }
+
+    // Nothing is left to compact
+    assert(va_compaction_plan(allocator, &plan) == 0);
+    assert(plan.move_count == 0 && plan.reclaim_size == 0);
+    va_compaction_apply(allocator, &plan, NULL, NULL);
+
+    for (uint64_t addr : live) {
+        va_free(allocator, addr);
+    }
+    assert(va_allocator_get_used_size(allocator) == 0);
+    va_allocator_destroy(allocator);
+}
+
+// Queued frees are released in sorted batches: a full reservation freed in
+// random order coalesces back into a single extent, and an allocation that
+// would otherwise need a new reservation drains the queue and reuses its space
+void test_deferred_free(void)
+{
+    std::cout << "Testing deferred frees..." << std::endl;
+
+    const uint64_t KB = 1024;
+    const uint64_t MB = 1024 * KB;
+    va_allocator_config_t config;
+    va_allocator_config_default(&config);
+    config.arena_deferred_free_batch = 64;
+    va_allocator_t *allocator = va_allocator_init_with_config(VA_ALLOCATOR_TYPE_ARENA, &config);
+    assert(allocator != NULL);
+
+    // Exactly one 32MB reservation of 64KB blocks
+    std::vector<uint64_t> blocks;
+    for (int i = 0; i < 512; i++) {
+        uint64_t addr = va_alloc(allocator, 64 * KB);
+        assert(addr != 0);
+        blocks.push_back(addr);
+    }
+    assert(va_allocator_get_total_size(allocator) == 32 * MB);
+
+    // Still queued, the next allocation drains them instead of reserving
+    std::vector<uint64_t> freed(blocks.begin() + 100, blocks.begin() + 110);
+    for (uint64_t addr : freed) {
+        va_free(allocator, addr);
+    }
+    uint64_t reused = va_alloc(allocator, 64 * KB);
+    assert(std::find(freed.begin(), freed.end(), reused) != freed.end());
+    assert(va_allocator_get_total_size(allocator) == 32 * MB);
+    assert(va_allocator_get_used_size(allocator) == 503 * 64 * KB);
+    for (uint64_t addr : freed) {
+        if (addr != reused) {
+            assert(va_alloc(allocator, 64 * KB) != 0);
+        }
+    }
+    assert(va_allocator_get_total_size(allocator) == 32 * MB);
+
+    // A repeated free in the queue is dropped
+    va_free(allocator, blocks[0]);
+    va_free(allocator, blocks[0]);
+    assert(va_allocator_get_used_size(allocator) == 511 * 64 * KB);
+
+    workload::Rng gen(workload::default_seed());
+    std::shuffle(blocks.begin() + 1, blocks.end(), gen);
+    for (size_t i = 1; i < blocks.size(); i++) {
+        va_free(allocator, blocks[i]);
+    }
+    va_allocator_frag_stats_t stats = {};
+    va_allocator_get_frag_stats(allocator, &stats);
+    assert(stats.used_size == 0);
+    assert(stats.free_extents == 1);
+    assert(stats.largest_free == 32 * MB);
+
+    // Slab and large frees go through the queue too, and are drained on destroy
+    va_free(allocator, va_alloc(allocator, 100));
+    va_free(allocator, va_alloc(allocator, 64 * MB));
+    va_allocator_destroy(allocator);
+}
+
+// Freed blocks of a recently used size are handed back whole, other sizes go
+// through the size index, and a miss in the arena flushes the parked blocks so
+// their space coalesces before a new reservation is mapped
+void test_quick_lists(void)
+{
+    std::cout << "Testing quick lists..." << std::endl;
+
+    const uint64_t KB = 1024;
+    const uint64_t MB = 1024 * KB;
+    va_allocator_config_t config;
+    va_allocator_config_default(&config);
+    config.arena_quick_list_depth = 8;
+    va_allocator_t *allocator = va_allocator_init_with_config(VA_ALLOCATOR_TYPE_ARENA, &config);
+    assert(allocator != NULL);
+
+    std::vector<uint64_t> blocks;
+    for (int i = 0; i < 16; i++) {
+        uint64_t addr = va_alloc(allocator, 5000);
+        assert(addr != 0);
+        blocks.push_back(addr);
+    }
+    va_free(allocator, blocks[4]);
+    va_free(allocator, blocks[5]);
+    assert(va_allocator_get_used_size(allocator) == 14 * 5000);
+    va_free(allocator, blocks[5]);
+    assert(va_allocator_get_used_size(allocator) == 14 * 5000);
+
+    // Most recently freed first, and never for another size
+    uint64_t other = va_alloc(allocator, 5001);
+    assert(other != blocks[4] && other != blocks[5]);
+    assert(va_alloc(allocator, 5000) == blocks[5]);
+    assert(va_alloc(allocator, 5000) == blocks[4]);
+    va_free(allocator, other);
+
+    // Parked blocks are flushed back before the block lists are read
+    for (uint64_t addr : blocks) {
+        va_free(allocator, addr);
+    }
+    va_allocator_frag_stats_t stats = {};
+    va_allocator_get_frag_stats(allocator, &stats);
+    assert(stats.used_size == 0);
+    assert(stats.free_extents == 1);
+    assert(stats.largest_free == 32 * MB);
+    va_allocator_destroy(allocator);
+
+    // Exactly one 32MB reservation of 64KB blocks
+    allocator = va_allocator_init_with_config(VA_ALLOCATOR_TYPE_ARENA, &config);
+    assert(allocator != NULL);
+    blocks.clear();
+    for (int i = 0; i < 512; i++) {
+        uint64_t addr = va_alloc(allocator, 64 * KB);
+        assert(addr != 0);
+        blocks.push_back(addr);
+    }
+    for (int i = 200; i < 208; i++) {
+        va_free(allocator, blocks[i]);
+    }
+    uint64_t merged = va_alloc(allocator, 40 * KB);
+    assert(merged >= blocks[200] && merged < blocks[207] + 64 * KB);
+    assert(va_allocator_get_total_size(allocator) == 32 * MB);
+    va_free(allocator, merged);
+    for (size_t i = 0; i < blocks.size(); i++) {
+        if (i < 200 || i >= 208) {
+            va_free(allocator, blocks[i]);
+        }
+    }
+    assert(va_allocator_get_used_size(allocator) == 0);
+    va_allocator_destroy(allocator);
+}
+
+// Live object blocks cost a 24-byte record each, and freed records are reused
+void test_metadata_size(void)
+{
+    std::cout << "Testing metadata size..." << std::endl;
+
+    va_allocator_t *allocator = va_allocator_init(VA_ALLOCATOR_TYPE_ARENA);
+    assert(allocator != NULL);
+    uint64_t first = va_alloc(allocator, 3000);
+    assert(first != 0);
+    va_allocator_frag_stats_t before = {};
+    va_allocator_get_frag_stats(allocator, &before);
+    assert(before.metadata_size > 0);
+
+    std::vector<uint64_t> addresses;
+    for (int i = 0; i < 2000; i++) {
+        uint64_t addr = va_alloc(allocator, 3000);
+        assert(addr != 0);
+        addresses.push_back(addr);
+    }
+    va_allocator_frag_stats_t after = {};
+    va_allocator_get_frag_stats(allocator, &after);
+    assert(after.reserved_size == before.reserved_size);
+    assert(after.metadata_size - before.metadata_size <= 2000 * 48);
+
+    for (size_t i = 0; i < addresses.size(); i += 2) {
+        va_free(allocator, addresses[i]);
+    }
+    for (size_t i = 1; i < addresses.size(); i += 2) {
+        va_free(allocator, addresses[i]);
+    }
+    va_free(allocator, first);
+    va_allocator_frag_stats_t empty = {};
+    va_allocator_get_frag_stats(allocator, &empty);
+    assert(empty.used_size == 0 && empty.free_extents == 1);
+
+    // Records and nodes keep their high-water capacity and are reused
+    for (int i = 0; i < 2000; i++) {
+        assert(va_alloc(allocator, 3000) != 0);
+    }
+    va_allocator_get_frag_stats(allocator, &after);
+    assert(after.metadata_size == empty.metadata_size);
+    va_allocator_destroy(allocator);
+}
+
 int main(void) {
-    std::cout << "Starting arena allocator tests..." << std::endl;
+    std::cout << "Starting arena allocator tests (seed " << workload::default_seed() << ")..." << std::endl;
 
     test_allocator_create_destroy();
     test_slab_allocation();
@@ -311,6 +765,17 @@ int main(void) {
     test_rapid_alloc_free();
     test_boundary_sizes();
     test_random_patterns();
+    test_reservation_pool(0);
+    test_reservation_pool(1);
+    test_region_mode();
+    for (int index = 0; index < VA_SIZE_INDEX_MAX; index++) {
+        test_large_objects((va_size_index_type_t)index);
+    }
+    test_compaction(0);
+    test_compaction(64);
+    test_deferred_free();
+    test_quick_lists();
+    test_metadata_size();
 
     std::cout << "All arena allocator tests completed successfully!" << std::endl;
     return 0;
@@ -1,81 +1,64 @@
 #include <iostream>
 #include <vector>
-#include <chrono>
-#include <random>
 #include <iomanip>
-#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <thread>
 #include "va_allocator.h"
+#include "latency_histogram.h"
+#include "workload.h"
 
-// Helper function to get current time in microseconds
-uint64_t get_time_us() {
-    return std::chrono::duration_cast<std::chrono::microseconds>(
-        std::chrono::high_resolution_clock::now().time_since_epoch()
-    ).count();
-}
+static const uint64_t KB = 1024;
+static const uint64_t MB = 1024 * 1024;
 
 // Structure to hold benchmark results
 struct BenchmarkResult {
-    uint64_t alloc_time_us;
-    uint64_t free_time_us;
+    uint64_t alloc_time_ns;
+    uint64_t free_time_ns;
     uint64_t total_ops;
     uint64_t total_size;
+    uint64_t failed_allocs;
 };
 
-// Run benchmark for a specific allocator type
-BenchmarkResult run_benchmark(va_allocator_type_t type, 
-                            size_t num_ops,
-                            size_t min_size,
-                            size_t max_size,
-                            float alloc_ratio = 0.7) {
+// Run benchmark for a specific allocator type. The same spec and seed always
+// produce the same request stream, so both allocators see identical load.
+BenchmarkResult run_benchmark(const CalibratedTimer &timer,
+                              va_allocator_type_t type,
+                              const workload::Spec &spec,
+                              size_t num_ops) {
     va_allocator_t *allocator = va_allocator_init(type);
     assert(allocator != NULL);
 
-    BenchmarkResult result = {0, 0, 0, 0};  // Initialize all fields to 0
-    std::vector<uint64_t> addresses;
-    std::vector<uint64_t> sizes;
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> size_dist(min_size, max_size);
-    std::uniform_real_distribution<> op_dist(0, 1);
-
-    uint64_t total_alloc_time = 0;
-    uint64_t total_free_time = 0;
+    BenchmarkResult result = {0, 0, 0, 0, 0};  // Initialize all fields to 0
+    workload::Generator gen(spec, workload::default_seed());
 
     for (size_t i = 0; i < num_ops; i++) {
-        if (op_dist(gen) < alloc_ratio || addresses.empty()) {
-            // Allocation operation
-            uint64_t size = size_dist(gen);
-            uint64_t alloc_start = get_time_us();
-            uint64_t addr = va_alloc(allocator, size);
-            total_alloc_time += get_time_us() - alloc_start;
+        workload::Op op = gen.next();
+        if (op.kind == workload::Op::ALLOC) {
+            uint64_t alloc_start = CalibratedTimer::now();
+            uint64_t addr = va_alloc(allocator, op.size);
+            result.alloc_time_ns += timer.elapsed(alloc_start, CalibratedTimer::now());
 
             if (addr != 0) {
-                addresses.push_back(addr);
-                sizes.push_back(size);
-                result.total_size += size;
+                gen.allocated(addr, op.size);
+                result.total_size += op.size;
+            } else {
+                result.failed_allocs++;
             }
         } else {
-            // Free operation
-            size_t idx = std::uniform_int_distribution<>(0, addresses.size() - 1)(gen);
-            uint64_t free_start = get_time_us();
-            va_free(allocator, addresses[idx]);
-            total_free_time += get_time_us() - free_start;
-
-            addresses.erase(addresses.begin() + idx);
-            sizes.erase(sizes.begin() + idx);
+            uint64_t free_start = CalibratedTimer::now();
+            va_free(allocator, op.addr);
+            result.free_time_ns += timer.elapsed(free_start, CalibratedTimer::now());
         }
         result.total_ops++;
     }
 
     // Free remaining allocations
-    for (uint64_t addr : addresses) {
-        va_free(allocator, addr);
+    workload::LiveBlock block;
+    while (gen.pop_live(&block)) {
+        va_free(allocator, block.addr);
     }
 
-    result.alloc_time_us = total_alloc_time;
-    result.free_time_us = total_free_time;
-
     va_allocator_destroy(allocator);
     return result;
 }
@@ -86,46 +69,167 @@ void print_results(const char* allocator_name, const BenchmarkResult& result) {
     std::cout << "----------------------------------------" << std::endl;
     std::cout << "Total operations: " << result.total_ops << std::endl;
     std::cout << "Total allocated size: " << (result.total_size / (1024*1024)) << " MB" << std::endl;
-    std::cout << "Average allocation time: " << (result.alloc_time_us / (float)result.total_ops) << " us" << std::endl;
-    std::cout << "Average free time: " << (result.free_time_us / (float)result.total_ops) << " us" << std::endl;
+    std::cout << "Failed allocations: " << result.failed_allocs << std::endl;
+    std::cout << "Average allocation time: " << (result.alloc_time_ns / 1000.0 / result.total_ops) << " us" << std::endl;
+    std::cout << "Average free time: " << (result.free_time_ns / 1000.0 / result.total_ops) << " us" << std::endl;
+}
+
+void run_scenario(const CalibratedTimer &timer, const char *title, const workload::Spec &spec, size_t num_ops) {
+    std::cout << "\n" << title << std::endl;
+    std::cout << "Sizes: " << spec.phases[0].sizes->describe()
+              << ", lifetime: " << workload::lifetime_name(spec.lifetime) << std::endl;
+    auto default_result = run_benchmark(timer, VA_ALLOCATOR_TYPE_DEFAULT, spec, num_ops);
+    auto arena_result = run_benchmark(timer, VA_ALLOCATOR_TYPE_ARENA, spec, num_ops);
+    print_results("Default Allocator", default_result);
+    print_results("Arena Allocator", arena_result);
 }
 
 // Run different benchmark scenarios
-void run_benchmark_scenarios() {
+void run_benchmark_scenarios(const CalibratedTimer &timer) {
     const size_t NUM_OPERATIONS = 100000;
-    
-    // Scenario 1: Small allocations (256B - 4KB)
-    std::cout << "\nScenario 1: Small allocations (256B - 4KB)" << std::endl;
-    auto default_small = run_benchmark(VA_ALLOCATOR_TYPE_DEFAULT, NUM_OPERATIONS, 256, 4096);
-    auto arena_small = run_benchmark(VA_ALLOCATOR_TYPE_ARENA, NUM_OPERATIONS, 256, 4096);
-    print_results("Default Allocator", default_small);
-    print_results("Arena Allocator", arena_small);
-
-    // Scenario 2: Medium allocations (4KB - 1MB)
-    std::cout << "\nScenario 2: Medium allocations (4KB - 1MB)" << std::endl;
-    auto default_medium = run_benchmark(VA_ALLOCATOR_TYPE_DEFAULT, NUM_OPERATIONS, 4096, 1024*1024);
-    auto arena_medium = run_benchmark(VA_ALLOCATOR_TYPE_ARENA, NUM_OPERATIONS, 4096, 1024*1024);
-    print_results("Default Allocator", default_medium);
-    print_results("Arena Allocator", arena_medium);
-
-    // Scenario 3: Large allocations (1MB - 32MB)
-    std::cout << "\nScenario 3: Large allocations (1MB - 32MB)" << std::endl;
-    auto default_large = run_benchmark(VA_ALLOCATOR_TYPE_DEFAULT, NUM_OPERATIONS, 1024*1024, 32*1024*1024);
-    auto arena_large = run_benchmark(VA_ALLOCATOR_TYPE_ARENA, NUM_OPERATIONS, 1024*1024, 32*1024*1024);
-    print_results("Default Allocator", default_large);
-    print_results("Arena Allocator", arena_large);
-
-    // Scenario 4: Mixed allocations with high fragmentation
-    std::cout << "\nScenario 4: Mixed allocations with high fragmentation" << std::endl;
-    auto default_mixed = run_benchmark(VA_ALLOCATOR_TYPE_DEFAULT, NUM_OPERATIONS, 256, 32*1024*1024, 0.5);
-    auto arena_mixed = run_benchmark(VA_ALLOCATOR_TYPE_ARENA, NUM_OPERATIONS, 256, 32*1024*1024, 0.5);
-    print_results("Default Allocator", default_mixed);
-    print_results("Arena Allocator", arena_mixed);
+    using namespace workload;
+
+    run_scenario(timer, "Scenario 1: Small allocations (256B - 4KB)",
+                 steady(uniform_sizes(256, 4 * KB), 0.7, LIFETIME_RANDOM), NUM_OPERATIONS);
+
+    run_scenario(timer, "Scenario 2: Medium allocations (4KB - 1MB)",
+                 steady(uniform_sizes(4 * KB, 1 * MB), 0.7, LIFETIME_RANDOM), NUM_OPERATIONS);
+
+    run_scenario(timer, "Scenario 3: Large allocations (1MB - 32MB)",
+                 steady(uniform_sizes(1 * MB, 32 * MB), 0.7, LIFETIME_RANDOM), NUM_OPERATIONS);
+
+    run_scenario(timer, "Scenario 4: Mixed allocations with high fragmentation",
+                 steady(uniform_sizes(256, 32 * MB), 0.5, LIFETIME_RANDOM), NUM_OPERATIONS);
+
+    // Production-shaped load: heavy-tailed sizes and lifetimes
+    run_scenario(timer, "Scenario 5: Log-normal sizes with long-tail lifetimes",
+                 steady(lognormal_sizes(8 * KB, 2.0, 256, 32 * MB), 0.55, LIFETIME_LONG_TAIL), NUM_OPERATIONS);
+
+    std::vector<uint64_t> popular_sizes = {4 * KB, 512, 64 * KB, 1 * MB, 2 * KB, 256 * KB, 2 * MB, 16 * KB, 8 * MB};
+    run_scenario(timer, "Scenario 6: Zipf size classes in allocate/drain bursts",
+                 bursty(zipf_sizes(popular_sizes, 1.2), 2000, 0.9, 2000, 0.2, LIFETIME_FIFO), NUM_OPERATIONS);
+
+    run_scenario(timer, "Scenario 7: Log-normal sizes in stack-like bursts",
+                 bursty(lognormal_sizes(16 * KB, 1.5, 256, 32 * MB), 500, 0.8, 500, 0.3, LIFETIME_LIFO), NUM_OPERATIONS);
+}
+
+// One instance per thread, all running the same workload: aggregate throughput
+// shows whether instances share anything that serialises them
+double run_instances_benchmark(va_allocator_type_t type, const workload::Spec &spec,
+                               int num_instances, size_t ops_per_instance) {
+    std::vector<va_allocator_t *> allocators(num_instances);
+    for (int i = 0; i < num_instances; i++) {
+        allocators[i] = va_allocator_init(type);
+        assert(allocators[i] != NULL);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_instances; i++) {
+        threads.emplace_back([&, i]() {
+            workload::Generator gen(spec, workload::default_seed() + i);
+            for (size_t op_idx = 0; op_idx < ops_per_instance; op_idx++) {
+                workload::Op op = gen.next();
+                if (op.kind == workload::Op::ALLOC) {
+                    uint64_t addr = va_alloc(allocators[i], op.size);
+                    assert(addr != 0);
+                    gen.allocated(addr, op.size);
+                } else {
+                    va_free(allocators[i], op.addr);
+                }
+            }
+            workload::LiveBlock block;
+            while (gen.pop_live(&block)) {
+                va_free(allocators[i], block.addr);
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (int i = 0; i < num_instances; i++) {
+        va_allocator_destroy(allocators[i]);
+    }
+    return (double)num_instances * ops_per_instance / seconds;
+}
+
+void run_instances_scenario(void) {
+    const size_t OPS_PER_INSTANCE = 20000;
+    const workload::Spec spec = workload::steady(workload::lognormal_sizes(8 * KB, 2.0, 256, 32 * MB),
+                                                 0.55, workload::LIFETIME_LONG_TAIL);
+
+    std::cout << "\nScenario 8: Independent instances, one thread each ("
+              << std::thread::hardware_concurrency() << " hardware threads)" << std::endl;
+    std::cout << "Sizes: " << spec.phases[0].sizes->describe()
+              << ", lifetime: " << workload::lifetime_name(spec.lifetime) << std::endl;
+    std::cout << std::setw(12) << "Instances" << std::setw(20) << "Default (Mops/s)"
+              << std::setw(20) << "Arena (Mops/s)" << std::endl;
+    for (int instances = 1; instances <= 16; instances *= 2) {
+        double default_rate = run_instances_benchmark(VA_ALLOCATOR_TYPE_DEFAULT, spec, instances, OPS_PER_INSTANCE);
+        double arena_rate = run_instances_benchmark(VA_ALLOCATOR_TYPE_ARENA, spec, instances, OPS_PER_INSTANCE);
+        std::cout << std::setw(12) << instances << std::fixed << std::setprecision(2)
+                  << std::setw(20) << default_rate / 1e6 << std::setw(20) << arena_rate / 1e6 << std::endl;
+    }
+}
+
+// Metadata held per live allocation once the workload reaches steady state,
+// from va_allocator_frag_stats_t::metadata_size
+double run_metadata_benchmark(va_allocator_type_t type, const workload::Spec &spec, size_t num_ops) {
+    va_allocator_t *allocator = va_allocator_init(type);
+    assert(allocator != NULL);
+
+    workload::Generator gen(spec, workload::default_seed());
+    uint64_t live = 0;
+    for (size_t i = 0; i < num_ops; i++) {
+        workload::Op op = gen.next();
+        if (op.kind == workload::Op::ALLOC) {
+            uint64_t addr = va_alloc(allocator, op.size);
+            assert(addr != 0);
+            gen.allocated(addr, op.size);
+            live++;
+        } else {
+            va_free(allocator, op.addr);
+            live--;
+        }
+    }
+
+    va_allocator_frag_stats_t stats = {};
+    va_allocator_get_frag_stats(allocator, &stats);
+    workload::LiveBlock block;
+    while (gen.pop_live(&block)) {
+        va_free(allocator, block.addr);
+    }
+    va_allocator_destroy(allocator);
+    return live ? (double)stats.metadata_size / live : 0.0;
+}
+
+void run_metadata_scenario(void) {
+    const size_t NUM_OPERATIONS = 30000;
+    using namespace workload;
+    const std::vector<std::pair<const char *, Spec> > specs = {
+        {"Medium (4KB - 1MB)", steady(uniform_sizes(4 * KB, 1 * MB), 0.7, LIFETIME_RANDOM)},
+        {"Log-normal, long tail", steady(lognormal_sizes(8 * KB, 2.0, 256, 32 * MB), 0.55, LIFETIME_LONG_TAIL)},
+        {"Object-arena fill (2KB - 4KB)", steady(uniform_sizes(2 * KB + 1, 4 * KB), 0.9, LIFETIME_RANDOM)},
+    };
+
+    std::cout << "\nScenario 9: Metadata bytes per live allocation" << std::endl;
+    std::cout << std::setw(32) << "Workload" << std::setw(16) << "Default" << std::setw(16) << "Arena" << std::endl;
+    for (const auto &spec : specs) {
+        double default_bytes = run_metadata_benchmark(VA_ALLOCATOR_TYPE_DEFAULT, spec.second, NUM_OPERATIONS);
+        double arena_bytes = run_metadata_benchmark(VA_ALLOCATOR_TYPE_ARENA, spec.second, NUM_OPERATIONS);
+        std::cout << std::setw(32) << spec.first << std::fixed << std::setprecision(1)
+                  << std::setw(16) << default_bytes << std::setw(16) << arena_bytes << std::endl;
+    }
 }
 
 int main(void) {
-    std::cout << "Starting allocator benchmark comparison..." << std::endl;
-    run_benchmark_scenarios();
+    std::cout << "Starting allocator benchmark comparison (seed " << workload::default_seed() << ")..." << std::endl;
+    CalibratedTimer timer;
+    run_benchmark_scenarios(timer);
+    run_instances_scenario();
+    run_metadata_scenario();
     std::cout << "\nBenchmark completed!" << std::endl;
     return 0;
-} 
\ No newline at end of file
+}
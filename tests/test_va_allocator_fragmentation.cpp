@@ -0,0 +1,272 @@
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <random>
+#include <iomanip>
+#include <algorithm>
+#include <cassert>
+#include "va_allocator.h"
+#include "workload.h"
+
+//
+// Deterministic aging workloads that report how the reserved VA degrades
+// over time. Every workload is driven by workload::default_seed() so DEFAULT
+// and ARENA see exactly the same request stream and runs are comparable
+// across builds.
+//
+
+static const uint64_t KB = 1024;
+static const uint64_t MB = 1024 * 1024;
+
+struct live_block {
+    uint64_t addr;
+    uint64_t size;
+};
+
+struct workload_state {
+    va_allocator_t *allocator;
+    std::vector<live_block> live;
+    uint64_t live_bytes;
+    uint64_t failed_allocs;
+};
+
+static void
+print_header(void)
+{
+    std::cout << std::setw(8) << "step"
+              << std::setw(12) << "live(MB)"
+              << std::setw(14) << "reserved(MB)"
+              << std::setw(12) << "free(MB)"
+              << std::setw(16) << "largest(MB)"
+              << std::setw(12) << "ext.frag"
+              << std::setw(14) << "VA/live"
+              << std::setw(10) << "failed" << std::endl;
+}
+
+// External fragmentation is the share of free VA that cannot be handed out
+// as a single extent: 1 - largest_free / free_size.
+static void
+print_sample(uint64_t step, const workload_state &state)
+{
+    va_allocator_frag_stats_t stats;
+    va_allocator_get_frag_stats(state.allocator, &stats);
+    assert(stats.used_size == state.live_bytes);
+
+    double ext_frag = stats.free_size ? 1.0 - (double)stats.largest_free / stats.free_size : 0.0;
+    double va_per_live = state.live_bytes ? (double)stats.reserved_size / state.live_bytes : 0.0;
+
+    std::cout << std::fixed << std::setprecision(2)
+              << std::setw(8) << step
+              << std::setw(12) << (double)state.live_bytes / MB
+              << std::setw(14) << (double)stats.reserved_size / MB
+              << std::setw(12) << (double)stats.free_size / MB
+              << std::setw(16) << (double)stats.largest_free / MB
+              << std::setw(12) << ext_frag
+              << std::setw(14) << va_per_live
+              << std::setw(10) << state.failed_allocs << std::endl;
+}
+
+static bool
+do_alloc(workload_state &state, uint64_t size)
+{
+    uint64_t addr = va_alloc(state.allocator, size);
+    if (addr == 0) {
+        state.failed_allocs++;
+        return false;
+    }
+    state.live.push_back({addr, size});
+    state.live_bytes += size;
+    return true;
+}
+
+static void
+do_free(workload_state &state, size_t idx)
+{
+    va_free(state.allocator, state.live[idx].addr);
+    state.live_bytes -= state.live[idx].size;
+    state.live[idx] = state.live.back();
+    state.live.pop_back();
+}
+
+// Slab and object arenas round differently, so the benchmark only uses sizes
+// that every strategy accounts for exactly: slab block sizes and 4KB multiples.
+static uint64_t
+round_size(uint64_t size)
+{
+    if (size <= 512) {
+        return 512;
+    }
+    if (size <= 1 * KB) {
+        return 1 * KB;
+    }
+    if (size <= 2 * KB) {
+        return 2 * KB;
+    }
+    return (size + 4 * KB - 1) & ~(4 * KB - 1);
+}
+
+static void
+release_all(workload_state &state)
+{
+    while (!state.live.empty()) {
+        do_free(state, state.live.size() - 1);
+    }
+}
+
+// Alternating phases: a phase of many small objects is mostly torn down and
+// followed by a phase of large buffers that must find room in what is left.
+static void
+run_phase_change(workload_state &state, workload::Rng &gen)
+{
+    const int num_phases = 8;
+    const int allocs_per_phase = 2000;
+    std::uniform_int_distribution<uint64_t> small_dist(256, 64 * KB);
+    std::uniform_int_distribution<uint64_t> large_dist(1 * MB, 16 * MB);
+    std::uniform_real_distribution<double> coin(0.0, 1.0);
+
+    uint64_t step = 0;
+    for (int phase = 0; phase < num_phases; phase++) {
+        bool large = (phase % 2) == 1;
+        int count = large ? allocs_per_phase / 20 : allocs_per_phase;
+        for (int i = 0; i < count; i++, step++) {
+            do_alloc(state, round_size(large ? large_dist(gen) : small_dist(gen)));
+        }
+
+        // Keep roughly 10% of everything alive into the next phase
+        for (size_t i = 0; i < state.live.size();) {
+            if (coin(gen) < 0.9) {
+                do_free(state, i);
+            } else {
+                i++;
+            }
+        }
+        print_sample(step, state);
+    }
+}
+
+// Sizes ramp up linearly and reset, with a FIFO window of live blocks, so
+// every freed hole is slightly too small for the next request.
+static void
+run_sawtooth(workload_state &state, workload::Rng &gen)
+{
+    const int num_steps = 20000;
+    const size_t window = 256;
+    const int teeth = 10;
+    std::uniform_int_distribution<uint64_t> jitter(0, 4 * KB);
+    std::deque<uint64_t> fifo;
+
+    for (int step = 0; step < num_steps; step++) {
+        uint64_t ramp = (uint64_t)(step % (num_steps / teeth)) * 512;
+        if (do_alloc(state, round_size(4 * KB + ramp + jitter(gen)))) {
+            fifo.push_back(state.live.back().addr);
+        }
+        if (fifo.size() > window) {
+            uint64_t oldest = fifo.front();
+            fifo.pop_front();
+            for (size_t i = 0; i < state.live.size(); i++) {
+                if (state.live[i].addr == oldest) {
+                    do_free(state, i);
+                    break;
+                }
+            }
+        }
+        if ((step + 1) % (num_steps / teeth) == 0) {
+            print_sample(step + 1, state);
+        }
+    }
+}
+
+// Long-lived blocks are interleaved with short-lived ones, so the survivors
+// pin holes in otherwise empty space.
+static void
+run_lifetime_mix(workload_state &state, workload::Rng &gen)
+{
+    const int num_steps = 20000;
+    const int num_samples = 10;
+    const double long_lived_ratio = 0.05;
+    workload::SizeDistributionPtr size_dist = workload::lognormal_sizes(64 * KB, 1.5, 1, 32 * MB);
+    std::uniform_real_distribution<double> coin(0.0, 1.0);
+    std::vector<live_block> short_lived;
+
+    for (int step = 0; step < num_steps; step++) {
+        uint64_t size = round_size(size_dist->next(gen));
+        bool long_lived = coin(gen) < long_lived_ratio;
+        if (do_alloc(state, size) && !long_lived) {
+            short_lived.push_back(state.live.back());
+        }
+
+        // Short-lived blocks die in random order once a small pool builds up
+        if (short_lived.size() > 64) {
+            size_t victim = std::uniform_int_distribution<size_t>(0, short_lived.size() - 1)(gen);
+            uint64_t addr = short_lived[victim].addr;
+            short_lived[victim] = short_lived.back();
+            short_lived.pop_back();
+            for (size_t i = 0; i < state.live.size(); i++) {
+                if (state.live[i].addr == addr) {
+                    do_free(state, i);
+                    break;
+                }
+            }
+        }
+        if ((step + 1) % (num_steps / num_samples) == 0) {
+            print_sample(step + 1, state);
+        }
+    }
+}
+
+typedef void (*workload_fn)(workload_state &state, workload::Rng &gen);
+
+static void
+run_workload(const char *name, workload_fn fn, va_allocator_type_t type,
+             va_size_index_type_t size_index, const char *type_name)
+{
+    std::cout << "\n" << name << " [" << type_name << "]" << std::endl;
+    print_header();
+
+    workload_state state;
+    va_allocator_config_t config;
+    va_allocator_config_default(&config);
+    config.size_index = size_index;
+    state.allocator = va_allocator_init_with_config(type, &config);
+    assert(state.allocator != NULL);
+    state.live_bytes = 0;
+    state.failed_allocs = 0;
+
+    workload::Rng gen(workload::default_seed());
+    fn(state, gen);
+
+    release_all(state);
+    assert(va_allocator_get_used_size(state.allocator) == 0);
+    va_allocator_destroy(state.allocator);
+}
+
+int main(void) {
+    const struct {
+        const char *name;
+        workload_fn fn;
+    } workloads[] = {
+        {"Phase change", run_phase_change},
+        {"Sawtooth sizes", run_sawtooth},
+        {"Long-lived/short-lived mix", run_lifetime_mix},
+    };
+    const struct {
+        va_allocator_type_t type;
+        va_size_index_type_t size_index;
+        const char *name;
+    } types[] = {
+        {VA_ALLOCATOR_TYPE_DEFAULT, VA_SIZE_INDEX_RADIX, "DEFAULT"},
+        {VA_ALLOCATOR_TYPE_DEFAULT, VA_SIZE_INDEX_SEGREGATED, "DEFAULT/segregated"},
+        {VA_ALLOCATOR_TYPE_DEFAULT, VA_SIZE_INDEX_ADDRESS_FIRST_FIT, "DEFAULT/first-fit"},
+        {VA_ALLOCATOR_TYPE_ARENA, VA_SIZE_INDEX_RADIX, "ARENA"},
+        {VA_ALLOCATOR_TYPE_ARENA, VA_SIZE_INDEX_SEGREGATED, "ARENA/segregated"},
+        {VA_ALLOCATOR_TYPE_ARENA, VA_SIZE_INDEX_ADDRESS_FIRST_FIT, "ARENA/first-fit"},
+    };
+
+    std::cout << "Fragmentation benchmark (seed " << workload::default_seed() << ")" << std::endl;
+    for (const auto &workload : workloads) {
+        for (const auto &type : types) {
+            run_workload(workload.name, workload.fn, type.type, type.size_index, type.name);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,203 @@
+#include <iostream>
+#include <vector>
+#include <cassert>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <random>
+#include "va_allocator.hpp"
+#include "workload.h"
+
+static const uint64_t KB = 1024;
+static const uint64_t MB = 1024 * KB;
+
+static_assert(va::arena_policy::class_of(1) == 0, "slab arena 0");
+static_assert(va::arena_policy::class_of(4 * KB) == 3, "last page-sized arena");
+static_assert(va::arena_policy::class_of(4 * KB + 1) == 4, "first object arena past a page");
+static_assert(va::arena_policy::class_of(64 * MB) == 7, "large-object arena");
+static_assert(va::size_classes<8 * KB, 64 * KB>::round(5000) == 8 * KB, "rounded to the first class");
+static_assert(va::size_classes<8 * KB, 64 * KB>::round(MB) == MB, "above the last class");
+
+// VA charged for a request: slabs charge whole blocks, everything else the request
+static uint64_t default_charge(uint64_t size) { return size; }
+static uint64_t arena_charge(uint64_t size) { return size <= 2 * KB ? va::size_classes<512, KB, 2 * KB>::round(size) : size; }
+
+// Random churn through the direct path, checking the accounting seen by the C API
+template <typename Allocator>
+static void churn(Allocator &allocator, uint64_t (*charge)(uint64_t))
+{
+    workload::Rng gen(workload::default_seed());
+    std::uniform_int_distribution<uint64_t> size_dist(1, 4 * MB);
+    std::uniform_int_distribution<uint64_t> small_dist(1, 4 * KB);
+    std::vector<uint64_t> live, sizes;
+    uint64_t expected = 0;
+    for (int i = 0; i < 2000; i++) {
+        uint64_t size = (i & 1) ? size_dist(gen) : small_dist(gen);
+        uint64_t addr = allocator.allocate(size);
+        assert(addr != 0);
+        live.push_back(addr);
+        sizes.push_back(size);
+        expected += charge(size);
+        if (i % 3 == 2) {
+            allocator.deallocate(live[i / 2]);
+            expected -= charge(sizes[i / 2]);
+            live[i / 2] = 0;
+        }
+        assert(va_allocator_get_used_size(allocator.get()) == expected);
+    }
+    for (uint64_t addr : live) {
+        if (addr) {
+            allocator.deallocate(addr);
+        }
+    }
+    assert(allocator.used_size() == 0);
+}
+
+void test_direct_paths(void)
+{
+    std::cout << "Testing direct strategy calls..." << std::endl;
+
+    va::default_allocator default_allocator;
+    churn(default_allocator, default_charge);
+
+    va::arena_allocator arena_allocator;
+    churn(arena_allocator, arena_charge);
+
+    va_allocator_config_t config;
+    va_allocator_config_default(&config);
+    config.shared_size = 1024 * MB;
+    va::shared_allocator shared_allocator(&config);
+    assert(shared_allocator.total_size() == 1024 * MB);
+    uint64_t addr = shared_allocator.allocate(3 * MB);
+    assert(addr != 0 && shared_allocator.used_size() == 3 * MB);
+    shared_allocator.deallocate(addr);
+    assert(shared_allocator.used_size() == 0);
+}
+
+void test_compile_time_classes(void)
+{
+    std::cout << "Testing compile-time size classes..." << std::endl;
+
+    // Slabs account whole blocks, object arenas the rounded request
+    {
+        va::arena_allocator arena_allocator;
+        uint64_t slab = arena_allocator.allocate<100>();
+        assert(slab != 0 && arena_allocator.used_size() == 512);
+        uint64_t object = arena_allocator.allocate<100 * KB>();
+        assert(object != 0 && arena_allocator.used_size() == 512 + 100 * KB);
+        uint64_t large = arena_allocator.allocate<48 * MB>();
+        assert(large != 0 && arena_allocator.used_size() == 512 + 100 * KB + 48 * MB);
+        arena_allocator.deallocate(slab);
+        arena_allocator.deallocate(object);
+        arena_allocator.deallocate(large);
+        assert(arena_allocator.used_size() == 0);
+    }
+
+    // Custom table: requests land on its classes, and rounding can move a
+    // request into the next arena
+    {
+        va::basic_allocator<va::arena_policy, va::size_classes<8 * KB, 64 * KB, 4 * MB> > classed;
+        uint64_t small = classed.allocate(5000);
+        assert(small != 0 && classed.used_size() == 8 * KB);
+        uint64_t medium = classed.allocate<65 * KB>();
+        assert(medium != 0 && classed.used_size() == 8 * KB + 4 * MB);
+        uint64_t unrounded = classed.allocate(5 * MB + 1);
+        assert(unrounded != 0 && classed.used_size() == 8 * KB + 9 * MB + 1);
+        classed.deallocate(small);
+        classed.deallocate(medium);
+        classed.deallocate(unrounded);
+        assert(classed.used_size() == 0);
+    }
+
+    // A size outside the named arena is refused rather than given a block
+    // that is too small
+    {
+        va::arena_allocator arena_allocator;
+        assert(va_arena_alloc_class(va_allocator_impl(arena_allocator.get()), 0, KB) == 0);
+        assert(va_arena_alloc_class(va_allocator_impl(arena_allocator.get()), 4, 100) == 0);
+        assert(va_arena_alloc_class(va_allocator_impl(arena_allocator.get()), 8, 64 * MB) == 0);
+        assert(arena_allocator.used_size() == 0);
+    }
+
+    // A policy whose table has drifted from the library cannot be constructed
+    struct drifted_policy : va::arena_policy {
+        static bool check() { return false; }
+    };
+    bool threw = false;
+    try {
+        va::basic_allocator<drifted_policy> drifted;
+    } catch (const std::logic_error &) {
+        threw = true;
+    }
+    assert(threw);
+
+    va::basic_allocator<va::default_policy, va::size_classes<64 * KB> > rounded_default;
+    uint64_t addr = rounded_default.allocate(1);
+    assert(addr != 0 && rounded_default.used_size() == 64 * KB);
+    rounded_default.deallocate(addr);
+}
+
+void test_memory_resource(void)
+{
+    std::cout << "Testing the memory_resource adapter..." << std::endl;
+
+    va::arena_allocator allocator;
+    va::memory_resource<va::arena_allocator> resource(allocator);
+    {
+        std::pmr::vector<uint64_t> values(&resource);
+        for (uint64_t i = 0; i < 100000; i++) {
+            values.push_back(i);
+        }
+        for (uint64_t i = 0; i < values.size(); i++) {
+            assert(values[i] == i);
+        }
+        assert(allocator.committed_size() >= values.size() * sizeof(uint64_t));
+        assert(allocator.committed_size() == allocator.used_size());
+
+        // Pools on top of the adapter, many small objects sharing its pages
+        std::pmr::unsynchronized_pool_resource pool(&resource);
+        std::pmr::vector<std::pmr::vector<char> > nested(&pool);
+        for (int i = 0; i < 1000; i++) {
+            nested.emplace_back(i % 200 + 1, (char)i);
+        }
+        for (int i = 0; i < 1000; i++) {
+            assert(nested[i].size() == (size_t)(i % 200 + 1) && nested[i].back() == (char)i);
+        }
+    }
+    assert(allocator.used_size() == 0);
+    assert(allocator.committed_size() == 0);
+
+    // Every block is whole pages, decommitted again on release
+    void *p = resource.allocate(1);
+    assert(allocator.used_size() == (uint64_t)sysconf(_SC_PAGESIZE));
+    memset(p, 0xab, (size_t)sysconf(_SC_PAGESIZE));
+    resource.deallocate(p, 1);
+    assert(allocator.committed_size() == 0);
+
+    bool threw = false;
+    try {
+        void *unaligned = resource.allocate(64, 2 * (size_t)sysconf(_SC_PAGESIZE));
+        resource.deallocate(unaligned, 64);
+    } catch (const std::bad_alloc &) {
+        threw = true;
+    }
+    assert(threw);
+    assert(allocator.used_size() == 0);
+
+    va::memory_resource<va::arena_allocator> same(allocator);
+    va::arena_allocator other_allocator;
+    va::memory_resource<va::arena_allocator> other(other_allocator);
+    assert(resource.is_equal(same));
+    assert(!resource.is_equal(other));
+}
+
+int main(void) {
+    std::cout << "Starting C++ front end tests (seed " << workload::default_seed() << ")..." << std::endl;
+
+    test_direct_paths();
+    test_compile_time_classes();
+    test_memory_resource();
+
+    std::cout << "All C++ front end tests completed successfully!" << std::endl;
+    return 0;
+}
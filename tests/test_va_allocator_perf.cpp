@@ -1,130 +1,242 @@
 #include <iostream>
+#include <iomanip>
 #include <vector>
 #include <cassert>
-#include <chrono>
-#include <iomanip>
-#include <numeric>
-#include <algorithm>
-#include <cmath>
 #include "va_allocator.h"
-
-// Helper function to get current timestamp in nanoseconds
-uint64_t get_timestamp() {
-    return std::chrono::duration_cast<std::chrono::nanoseconds>(
-        std::chrono::high_resolution_clock::now().time_since_epoch()
-    ).count();
+#include "va_allocator.hpp"
+#include "latency_histogram.h"
+#include "workload.h"
+
+// Cycles per internal stage, only available when built with -DVA_STAGE_TIMERS=ON
+void print_stage_stats(va_allocator_t *allocator) {
+    va_stage_stats_t stats;
+    if (va_allocator_get_stage_stats(allocator, &stats) != 0) {
+        return;
+    }
+    uint64_t total = 0;
+    for (int stage = 0; stage < VA_STAGE_MAX; stage++) {
+        total += stats.cycles[stage];
+    }
+    std::ios_base::fmtflags flags = std::cout.flags();
+    std::streamsize precision = std::cout.precision();
+    std::cout << "\nStage timers (stages nest, shares are of the summed cycles):\n";
+    std::cout << std::left << std::setw(22) << "  Stage" << std::right << std::setw(12) << "Calls"
+              << std::setw(16) << "Cycles/call" << std::setw(10) << "Share" << "\n";
+    for (int stage = 0; stage < VA_STAGE_MAX; stage++) {
+        if (!stats.calls[stage]) {
+            continue;
+        }
+        std::cout << "  " << std::left << std::setw(20) << va_stage_name((va_stage_t)stage) << std::right
+                  << std::setw(12) << stats.calls[stage] << std::setw(16) << std::fixed << std::setprecision(1)
+                  << (double)stats.cycles[stage] / stats.calls[stage] << std::setw(9)
+                  << 100.0 * stats.cycles[stage] / total << "%\n";
+    }
+    std::cout.flags(flags);
+    std::cout.precision(precision);
 }
 
-// Structure to hold timing statistics
-struct TimingStats {
-    double min;
-    double max;
-    double mean;
-    double median;
-    double stddev;
-};
-
-// Calculate timing statistics
-TimingStats calculate_stats(const std::vector<double>& times) {
-    TimingStats stats;
-    if (times.empty()) {
-        stats.min = stats.max = stats.mean = stats.median = stats.stddev = 0.0;
-        return stats;
-    }
+void test_same_size_allocation_performance(const CalibratedTimer &timer,
+                                           va_allocator_type_t allocator_type,
+                                           uint64_t block_size,
+                                           size_t num_blocks,
+                                           size_t num_rounds,
+                                           const va_allocator_config_t *config = NULL) {
+    std::cout << "\nTesting performance for " << num_rounds << " rounds of " << num_blocks
+              << " allocations of " << (block_size / 1024.0) << " KB blocks\n";
+    std::cout << "--------------------------------------------------------\n";
 
-    // Sort for median calculation
-    std::vector<double> sorted_times = times;
-    std::sort(sorted_times.begin(), sorted_times.end());
+    va_allocator_t* allocator = config ? va_allocator_init_with_config(allocator_type, config)
+                                       : va_allocator_init(allocator_type);
+    assert(allocator != NULL);
 
-    stats.min = sorted_times.front();
-    stats.max = sorted_times.back();
-    stats.mean = std::accumulate(times.begin(), times.end(), 0.0) / times.size();
-    stats.median = sorted_times[times.size() / 2];
+    std::vector<uint64_t> addresses(num_blocks);
+    LatencyHistogram alloc_hist;
+    LatencyHistogram free_hist;
+
+    // Each round allocates num_blocks and frees them again, so the tail
+    // percentiles are backed by enough samples to be meaningful.
+    for (size_t round = 0; round < num_rounds; round++) {
+        for (size_t i = 0; i < num_blocks; i++) {
+            uint64_t start_time = CalibratedTimer::now();
+            uint64_t addr = va_alloc(allocator, block_size);
+            uint64_t end_time = CalibratedTimer::now();
+
+            assert(addr != 0);
+            addresses[i] = addr;
+            alloc_hist.record(timer.elapsed(start_time, end_time));
+        }
+
+        for (size_t i = 0; i < num_blocks; i++) {
+            uint64_t start_time = CalibratedTimer::now();
+            va_free(allocator, addresses[i]);
+            uint64_t end_time = CalibratedTimer::now();
+
+            free_hist.record(timer.elapsed(start_time, end_time));
+        }
+    }
 
-    // Calculate standard deviation
-    double sq_sum = std::inner_product(times.begin(), times.end(), times.begin(), 0.0);
-    stats.stddev = std::sqrt(sq_sum / times.size() - stats.mean * stats.mean);
+    alloc_hist.print("Allocation Statistics");
+    std::cout << "\n";
+    free_hist.print("Deallocation Statistics");
+    print_stage_stats(allocator);
 
-    return stats;
+    va_allocator_destroy(allocator);
 }
 
-void test_same_size_allocation_performance(va_allocator_type_t allocator_type, uint64_t block_size, size_t num_blocks) {
-    std::cout << "\nTesting performance for " << num_blocks << " allocations of " 
-              << (block_size / 1024.0) << " KB blocks\n";
+// Latency under a production-shaped, seeded request stream
+void test_workload_performance(const CalibratedTimer &timer,
+                               va_allocator_type_t allocator_type,
+                               const char *title,
+                               const workload::Spec &spec,
+                               size_t num_ops,
+                               const va_allocator_config_t *config = NULL) {
+    std::cout << "\nTesting performance for " << num_ops << " operations: " << title << "\n";
     std::cout << "--------------------------------------------------------\n";
 
-    va_allocator_t* allocator = va_allocator_init(allocator_type);
+    va_allocator_t* allocator = config ? va_allocator_init_with_config(allocator_type, config)
+                                       : va_allocator_init(allocator_type);
     assert(allocator != NULL);
 
-    std::vector<uint64_t> addresses;
-    std::vector<double> alloc_times;
-    std::vector<double> free_times;
-    addresses.reserve(num_blocks);
-    alloc_times.reserve(num_blocks);
-    free_times.reserve(num_blocks);
-
-    // Measure allocation performance
-    for (size_t i = 0; i < num_blocks; i++) {
-        uint64_t start_time = get_timestamp();
-        uint64_t addr = va_alloc(allocator, block_size);
-        uint64_t end_time = get_timestamp();
-        
-        assert(addr != 0);
-        addresses.push_back(addr);
-        alloc_times.push_back((end_time - start_time) / 1000.0); // Convert to microseconds
+    workload::Generator gen(spec, workload::default_seed());
+    LatencyHistogram alloc_hist;
+    LatencyHistogram free_hist;
+
+    for (size_t i = 0; i < num_ops; i++) {
+        workload::Op op = gen.next();
+        if (op.kind == workload::Op::ALLOC) {
+            uint64_t start_time = CalibratedTimer::now();
+            uint64_t addr = va_alloc(allocator, op.size);
+            uint64_t end_time = CalibratedTimer::now();
+
+            assert(addr != 0);
+            gen.allocated(addr, op.size);
+            alloc_hist.record(timer.elapsed(start_time, end_time));
+        } else {
+            uint64_t start_time = CalibratedTimer::now();
+            va_free(allocator, op.addr);
+            uint64_t end_time = CalibratedTimer::now();
+
+            free_hist.record(timer.elapsed(start_time, end_time));
+        }
     }
 
-    // Measure deallocation performance
-    for (size_t i = 0; i < num_blocks; i++) {
-        uint64_t start_time = get_timestamp();
-        va_free(allocator, addresses[i]);
-        uint64_t end_time = get_timestamp();
-        
-        free_times.push_back((end_time - start_time) / 1000.0); // Convert to microseconds
+    alloc_hist.print("Allocation Statistics");
+    std::cout << "\n";
+    free_hist.print("Deallocation Statistics");
+    print_stage_stats(allocator);
+
+    workload::LiveBlock block;
+    while (gen.pop_live(&block)) {
+        va_free(allocator, block.addr);
     }
+    va_allocator_destroy(allocator);
+}
+
+// Same-size run through the C++ front end: the block size is a template
+// argument, so the arena is picked at compile time and the ops table is skipped
+template <uint64_t BlockSize>
+void test_front_end_performance(const CalibratedTimer &timer, size_t num_blocks, size_t num_rounds) {
+    std::cout << "\nTesting performance for " << num_rounds << " rounds of " << num_blocks
+              << " allocations of " << (BlockSize / 1024.0) << " KB blocks (va::arena_allocator)\n";
+    std::cout << "--------------------------------------------------------\n";
 
-    // Calculate and display statistics
-    TimingStats alloc_stats = calculate_stats(alloc_times);
-    TimingStats free_stats = calculate_stats(free_times);
-
-    std::cout << std::fixed << std::setprecision(2);
-    std::cout << "Allocation Statistics (μs):\n";
-    std::cout << "  Min: " << alloc_stats.min << "\n";
-    std::cout << "  Max: " << alloc_stats.max << "\n";
-    std::cout << "  Mean: " << alloc_stats.mean << "\n";
-    std::cout << "  Median: " << alloc_stats.median << "\n";
-    std::cout << "  StdDev: " << alloc_stats.stddev << "\n\n";
-
-    std::cout << "Deallocation Statistics (μs):\n";
-    std::cout << "  Min: " << free_stats.min << "\n";
-    std::cout << "  Max: " << free_stats.max << "\n";
-    std::cout << "  Mean: " << free_stats.mean << "\n";
-    std::cout << "  Median: " << free_stats.median << "\n";
-    std::cout << "  StdDev: " << free_stats.stddev << "\n";
+    va::arena_allocator allocator;
+    std::vector<uint64_t> addresses(num_blocks);
+    LatencyHistogram alloc_hist;
+    LatencyHistogram free_hist;
+
+    for (size_t round = 0; round < num_rounds; round++) {
+        for (size_t i = 0; i < num_blocks; i++) {
+            uint64_t start_time = CalibratedTimer::now();
+            uint64_t addr = allocator.allocate<BlockSize>();
+            uint64_t end_time = CalibratedTimer::now();
+
+            assert(addr != 0);
+            addresses[i] = addr;
+            alloc_hist.record(timer.elapsed(start_time, end_time));
+        }
+
+        for (size_t i = 0; i < num_blocks; i++) {
+            uint64_t start_time = CalibratedTimer::now();
+            allocator.deallocate(addresses[i]);
+            uint64_t end_time = CalibratedTimer::now();
+
+            free_hist.record(timer.elapsed(start_time, end_time));
+        }
+    }
 
-    va_allocator_destroy(allocator);
+    alloc_hist.print("Allocation Statistics");
+    std::cout << "\n";
+    free_hist.print("Deallocation Statistics");
+    print_stage_stats(allocator.get());
 }
 
 const char* allocator_type_to_string(va_allocator_type_t allocator_type) {
     switch (allocator_type) {
         case VA_ALLOCATOR_TYPE_DEFAULT: return "Default";
         case VA_ALLOCATOR_TYPE_ARENA: return "Arena";
+        case VA_ALLOCATOR_TYPE_SHARED: return "Shared";
         default: return "Unknown";
     }
 }
 
 int main() {
-    // Test different block sizes
-    const size_t num_blocks = 1000;  // Number of blocks to allocate
+    const size_t num_blocks = 1000;  // Live blocks per round
+    const size_t num_rounds = 100;   // Rounds per allocator/size pair
+    const size_t num_workload_ops = 100000;
+
+    const uint64_t KB = 1024;
+    const std::vector<uint64_t> popular_sizes = {4 * KB, 512, 64 * KB, 2 * KB, 256 * KB, 16 * KB, 1024 * KB};
+    const workload::Spec lognormal = workload::steady(workload::lognormal_sizes(8 * KB, 1.5, 256, 4096 * KB),
+                                                      0.55, workload::LIFETIME_LONG_TAIL);
+    const workload::Spec zipf = workload::bursty(workload::zipf_sizes(popular_sizes, 1.2),
+                                                 1000, 0.9, 1000, 0.2, workload::LIFETIME_FIFO);
+
+    CalibratedTimer timer;
+    std::cout << "Timer overhead: " << timer.overhead_ns() << " ns (subtracted from every sample)" << std::endl;
+    std::cout << "Workload seed: " << workload::default_seed() << std::endl;
 
     for (int i = 0; i < VA_ALLOCATOR_TYPE_MAX; i++) {
         std::cout << "\n****Testing allocator type: " << i << " (" << allocator_type_to_string((va_allocator_type_t)i) << ")****" << std::endl;
         // Test with 4KB blocks
-        test_same_size_allocation_performance((va_allocator_type_t)i, 4 * 1024, num_blocks);
+        test_same_size_allocation_performance(timer, (va_allocator_type_t)i, 4 * 1024, num_blocks, num_rounds);
 
         // Test with 1MB blocks
-        test_same_size_allocation_performance((va_allocator_type_t)i, 1024 * 1024, num_blocks);
+        test_same_size_allocation_performance(timer, (va_allocator_type_t)i, 1024 * 1024, num_blocks, num_rounds);
+
+        // Test with production-shaped mixes
+        test_workload_performance(timer, (va_allocator_type_t)i, "log-normal sizes, long-tail lifetimes",
+                                  lognormal, num_workload_ops);
+        test_workload_performance(timer, (va_allocator_type_t)i, "Zipf size classes, FIFO bursts",
+                                  zipf, num_workload_ops);
     }
 
+    // Same 1MB run with reservations prepared ahead of demand by the pool thread,
+    // so running out of space no longer puts an mmap on the allocation path
+    va_allocator_config_t pooled;
+    va_allocator_config_default(&pooled);
+    pooled.reservation_pool_depth = 4;
+    pooled.reservation_pool_thread = 1;
+    std::cout << "\n****Testing allocator type: " << VA_ALLOCATOR_TYPE_ARENA
+              << " (Arena, reservation pool thread)****" << std::endl;
+    test_same_size_allocation_performance(timer, VA_ALLOCATOR_TYPE_ARENA, 1024 * 1024, num_blocks, num_rounds, &pooled);
+
+    // Same-size and Zipf runs with freed object blocks parked by exact size,
+    // so repeated sizes skip the size index on both paths
+    va_allocator_config_t quick;
+    va_allocator_config_default(&quick);
+    quick.arena_quick_list_depth = num_blocks;
+    std::cout << "\n****Testing allocator type: " << VA_ALLOCATOR_TYPE_ARENA
+              << " (Arena, quick lists)****" << std::endl;
+    test_same_size_allocation_performance(timer, VA_ALLOCATOR_TYPE_ARENA, 4 * 1024, num_blocks, num_rounds, &quick);
+    test_workload_performance(timer, VA_ALLOCATOR_TYPE_ARENA, "Zipf size classes, FIFO bursts",
+                              zipf, num_workload_ops, &quick);
+
+    // Direct strategy calls from C++, against the 4KB and 1MB arena runs above
+    std::cout << "\n****Testing allocator type: " << VA_ALLOCATOR_TYPE_ARENA
+              << " (Arena, C++ front end)****" << std::endl;
+    test_front_end_performance<4 * 1024>(timer, num_blocks, num_rounds);
+    test_front_end_performance<1024 * 1024>(timer, num_blocks, num_rounds);
+
     return 0;
-} 
\ No newline at end of file
+}
@@ -0,0 +1,190 @@
+#include <iostream>
+#include <vector>
+#include <cassert>
+#include <random>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "va_allocator.h"
+#include "workload.h"
+
+static const uint64_t MB = 1024 * 1024;
+static const uint64_t PAGE = 4096;
+
+struct Extent {
+    uint64_t addr;
+    uint64_t size;
+};
+
+static void write_all(int fd, const void *data, size_t size)
+{
+    const char *bytes = (const char *)data;
+    while (size) {
+        ssize_t written = write(fd, bytes, size);
+        assert(written > 0);
+        bytes += written;
+        size -= (size_t)written;
+    }
+}
+
+static std::vector<Extent> read_extents(int fd)
+{
+    std::vector<char> bytes;
+    char buffer[4096];
+    ssize_t got;
+    while ((got = read(fd, buffer, sizeof(buffer))) > 0) {
+        bytes.insert(bytes.end(), buffer, buffer + got);
+    }
+    assert(bytes.size() % sizeof(Extent) == 0);
+    std::vector<Extent> extents(bytes.size() / sizeof(Extent));
+    std::copy(bytes.begin(), bytes.end(), (char *)extents.data());
+    return extents;
+}
+
+// Random alloc/free churn, then the surviving extents are reported on 'fd'
+static void run_worker(va_allocator_t *allocator, int worker, int fd)
+{
+    workload::Rng gen(workload::default_seed() + worker);
+    std::uniform_int_distribution<uint64_t> size_dist(1, 4 * MB);
+    std::uniform_real_distribution<> op_dist(0, 1);
+    std::vector<Extent> live;
+
+    for (int i = 0; i < 4000; i++) {
+        if (live.empty() || op_dist(gen) < 0.6) {
+            uint64_t size = size_dist(gen);
+            uint64_t addr = va_alloc(allocator, size);
+            assert(addr != 0);
+            live.push_back({addr, (size + PAGE - 1) & ~(PAGE - 1)});
+        } else {
+            size_t idx = std::uniform_int_distribution<size_t>(0, live.size() - 1)(gen);
+            va_free(allocator, live[idx].addr);
+            live.erase(live.begin() + idx);
+        }
+    }
+    write_all(fd, live.data(), live.size() * sizeof(Extent));
+}
+
+// Forked workers allocate concurrently from one range: their blocks must never
+// overlap, the shared used size must add up, and the parent can free them all.
+void test_fork_workers(void)
+{
+    std::cout << "Testing forked workers on one shared range..." << std::endl;
+
+    va_allocator_t *allocator = va_allocator_init(VA_ALLOCATOR_TYPE_SHARED);
+    assert(allocator != NULL);
+
+    const int num_workers = 4;
+    std::vector<pid_t> pids;
+    std::vector<int> pipes;
+    for (int worker = 0; worker < num_workers; worker++) {
+        int fds[2];
+        assert(pipe(fds) == 0);
+        pid_t pid = fork();
+        assert(pid >= 0);
+        if (pid == 0) {
+            close(fds[0]);
+            run_worker(allocator, worker, fds[1]);
+            _exit(0);
+        }
+        close(fds[1]);
+        pids.push_back(pid);
+        pipes.push_back(fds[0]);
+    }
+
+    std::vector<Extent> live;
+    for (int worker = 0; worker < num_workers; worker++) {
+        std::vector<Extent> extents = read_extents(pipes[worker]);
+        close(pipes[worker]);
+        live.insert(live.end(), extents.begin(), extents.end());
+
+        int status = 0;
+        assert(waitpid(pids[worker], &status, 0) == pids[worker]);
+        assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+
+    std::sort(live.begin(), live.end(), [](const Extent &a, const Extent &b) { return a.addr < b.addr; });
+    uint64_t live_bytes = 0;
+    for (size_t i = 0; i < live.size(); i++) {
+        assert(i == 0 || live[i - 1].addr + live[i - 1].size <= live[i].addr);
+        live_bytes += live[i].size;
+    }
+    assert(va_allocator_get_used_size(allocator) == live_bytes);
+
+    for (const Extent &extent : live) {
+        va_free(allocator, extent.addr);
+    }
+    va_allocator_frag_stats_t stats;
+    va_allocator_get_frag_stats(allocator, &stats);
+    assert(stats.used_size == 0);
+    assert(stats.free_extents == 1);
+    assert(stats.largest_free == va_allocator_get_total_size(allocator));
+
+    va_allocator_destroy(allocator);
+}
+
+// A process without the inherited mapping joins through the memfd and sees
+// the same range and blocks
+void test_attach(void)
+{
+    std::cout << "Testing attach through the segment descriptor..." << std::endl;
+
+    va_allocator_config_t config;
+    va_allocator_config_default(&config);
+    config.shared_size = 256 * MB;
+    va_allocator_t *allocator = va_allocator_init_with_config(VA_ALLOCATOR_TYPE_SHARED, &config);
+    assert(allocator != NULL);
+    assert(va_allocator_get_total_size(allocator) == 256 * MB);
+    int fd = va_allocator_shared_fd(allocator);
+    assert(fd >= 0);
+
+    // The range is already mapped in this process
+    assert(va_allocator_shared_attach(fd) == NULL);
+    assert(va_allocator_snapshot(allocator, "/dev/null") == -1);
+
+    uint64_t first = va_alloc(allocator, MB);
+    assert(first != 0);
+
+    int fds[2];
+    assert(pipe(fds) == 0);
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        close(fds[0]);
+        int own_fd = dup(fd);
+        va_allocator_destroy(allocator);
+        va_allocator_t *attached = va_allocator_shared_attach(own_fd);
+        close(own_fd);
+        assert(attached != NULL);
+        assert(va_allocator_get_used_size(attached) == MB);
+        Extent extent = {va_alloc(attached, 3 * MB), 3 * MB};
+        assert(extent.addr != 0 && extent.addr != first);
+        va_free(attached, first);
+        write_all(fds[1], &extent, sizeof(extent));
+        va_allocator_destroy(attached);
+        _exit(0);
+    }
+    close(fds[1]);
+    std::vector<Extent> extents = read_extents(fds[0]);
+    close(fds[0]);
+    int status = 0;
+    assert(waitpid(pid, &status, 0) == pid);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    assert(extents.size() == 1);
+    assert(va_allocator_get_used_size(allocator) == 3 * MB);
+    va_free(allocator, extents[0].addr);
+    assert(va_allocator_get_used_size(allocator) == 0);
+
+    va_allocator_destroy(allocator);
+    assert(va_allocator_shared_fd(NULL) == -1);
+}
+
+int main(void) {
+    std::cout << "Starting shared allocator tests (seed " << workload::default_seed() << ")..." << std::endl;
+
+    test_fork_workers();
+    test_attach();
+
+    std::cout << "All shared allocator tests completed successfully!" << std::endl;
+    return 0;
+}
@@ -0,0 +1,255 @@
+#include "workload.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+
+namespace workload {
+
+static const uint64_t DEFAULT_SEED = 0x5eed;
+
+uint64_t
+default_seed(void)
+{
+    const char *env = std::getenv("VA_WORKLOAD_SEED");
+    if (env && *env) {
+        return std::strtoull(env, NULL, 0);
+    }
+    return DEFAULT_SEED;
+}
+
+//
+// Size distributions
+//
+class UniformSizes : public SizeDistribution {
+public:
+    UniformSizes(uint64_t min_size, uint64_t max_size) : min_(min_size), max_(max_size) {}
+
+    uint64_t next(Rng &rng) const { return std::uniform_int_distribution<uint64_t>(min_, max_)(rng); }
+
+    std::string describe(void) const {
+        std::ostringstream out;
+        out << "uniform[" << min_ << ", " << max_ << "]";
+        return out.str();
+    }
+
+private:
+    uint64_t min_;
+    uint64_t max_;
+};
+
+class LogNormalSizes : public SizeDistribution {
+public:
+    LogNormalSizes(uint64_t median, double sigma, uint64_t min_size, uint64_t max_size)
+        : sigma_(sigma), median_(median), min_(min_size), max_(max_size) {}
+
+    uint64_t next(Rng &rng) const {
+        double size = std::lognormal_distribution<double>(std::log((double)median_), sigma_)(rng);
+        if (size < (double)min_) {
+            return min_;
+        }
+        if (size > (double)max_) {
+            return max_;
+        }
+        return (uint64_t)size;
+    }
+
+    std::string describe(void) const {
+        std::ostringstream out;
+        out << "lognormal(median " << median_ << ", sigma " << sigma_ << ")";
+        return out.str();
+    }
+
+private:
+    double sigma_;
+    uint64_t median_;
+    uint64_t min_;
+    uint64_t max_;
+};
+
+class ZipfSizes : public SizeDistribution {
+public:
+    ZipfSizes(const std::vector<uint64_t> &classes, double exponent)
+        : classes_(classes), exponent_(exponent) {
+        double total = 0.0;
+        for (size_t i = 0; i < classes_.size(); i++) {
+            total += 1.0 / std::pow((double)(i + 1), exponent_);
+            cdf_.push_back(total);
+        }
+        for (size_t i = 0; i < cdf_.size(); i++) {
+            cdf_[i] /= total;
+        }
+    }
+
+    uint64_t next(Rng &rng) const {
+        double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        size_t idx = std::lower_bound(cdf_.begin(), cdf_.end(), u) - cdf_.begin();
+        return classes_[std::min(idx, classes_.size() - 1)];
+    }
+
+    std::string describe(void) const {
+        std::ostringstream out;
+        out << "zipf(" << classes_.size() << " classes, s " << exponent_ << ")";
+        return out.str();
+    }
+
+private:
+    std::vector<uint64_t> classes_;
+    std::vector<double> cdf_;
+    double exponent_;
+};
+
+SizeDistributionPtr
+uniform_sizes(uint64_t min_size, uint64_t max_size)
+{
+    return SizeDistributionPtr(new UniformSizes(min_size, max_size));
+}
+
+SizeDistributionPtr
+lognormal_sizes(uint64_t median, double sigma, uint64_t min_size, uint64_t max_size)
+{
+    return SizeDistributionPtr(new LogNormalSizes(median, sigma, min_size, max_size));
+}
+
+SizeDistributionPtr
+zipf_sizes(const std::vector<uint64_t> &classes, double exponent)
+{
+    return SizeDistributionPtr(new ZipfSizes(classes, exponent));
+}
+
+const char *
+lifetime_name(Lifetime lifetime)
+{
+    switch (lifetime) {
+        case LIFETIME_LIFO: return "LIFO";
+        case LIFETIME_FIFO: return "FIFO";
+        case LIFETIME_RANDOM: return "random";
+        case LIFETIME_LONG_TAIL: return "long-tail";
+    }
+    return "unknown";
+}
+
+Spec
+steady(SizeDistributionPtr sizes, double alloc_ratio, Lifetime lifetime)
+{
+    Spec spec;
+    Phase phase = {1000, alloc_ratio, sizes};
+    spec.phases.push_back(phase);
+    spec.lifetime = lifetime;
+    return spec;
+}
+
+Spec
+bursty(SizeDistributionPtr sizes, uint64_t burst_ops, double burst_ratio,
+       uint64_t drain_ops, double drain_ratio, Lifetime lifetime)
+{
+    Spec spec;
+    Phase burst = {burst_ops, burst_ratio, sizes};
+    Phase drain = {drain_ops, drain_ratio, sizes};
+    spec.phases.push_back(burst);
+    spec.phases.push_back(drain);
+    spec.lifetime = lifetime;
+    return spec;
+}
+
+//
+// Generator
+//
+// Pareto lifetimes (in operations) for LIFETIME_LONG_TAIL
+static const double LONG_TAIL_MIN_LIFETIME = 8.0;
+static const double LONG_TAIL_ALPHA = 1.1;
+
+struct ExpiresLater {
+    bool operator()(const LiveBlock &a, const LiveBlock &b) const { return a.expires > b.expires; }
+};
+
+Generator::Generator(const Spec &spec, uint64_t seed)
+    : spec_(spec), rng_(seed), phase_idx_(0), phase_ops_(0), op_count_(0), live_bytes_(0)
+{
+}
+
+Op
+Generator::next(void)
+{
+    const Phase &phase = spec_.phases[phase_idx_];
+    Op op;
+
+    if (live_.empty() || std::uniform_real_distribution<double>(0.0, 1.0)(rng_) < phase.alloc_ratio) {
+        op.kind = Op::ALLOC;
+        op.size = phase.sizes->next(rng_);
+        op.addr = 0;
+    } else {
+        LiveBlock victim = take_victim();
+        op.kind = Op::FREE;
+        op.size = victim.size;
+        op.addr = victim.addr;
+    }
+
+    op_count_++;
+    if (++phase_ops_ >= phase.ops) {
+        phase_ops_ = 0;
+        phase_idx_ = (phase_idx_ + 1) % spec_.phases.size();
+    }
+    return op;
+}
+
+void
+Generator::allocated(uint64_t addr, uint64_t size)
+{
+    LiveBlock block = {addr, size, 0};
+    live_bytes_ += size;
+    if (spec_.lifetime == LIFETIME_LONG_TAIL) {
+        double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng_);
+        double lifetime = LONG_TAIL_MIN_LIFETIME / std::pow(1.0 - u, 1.0 / LONG_TAIL_ALPHA);
+        block.expires = op_count_ + (uint64_t)std::min(lifetime, 1e15);
+        live_.push_back(block);
+        std::push_heap(live_.begin(), live_.end(), ExpiresLater());
+    } else {
+        live_.push_back(block);
+    }
+}
+
+LiveBlock
+Generator::take_victim(void)
+{
+    LiveBlock victim;
+    switch (spec_.lifetime) {
+        case LIFETIME_LIFO:
+            victim = live_.back();
+            live_.pop_back();
+            break;
+        case LIFETIME_FIFO:
+            victim = live_.front();
+            live_.pop_front();
+            break;
+        case LIFETIME_RANDOM: {
+            size_t idx = std::uniform_int_distribution<size_t>(0, live_.size() - 1)(rng_);
+            victim = live_[idx];
+            live_[idx] = live_.back();
+            live_.pop_back();
+            break;
+        }
+        case LIFETIME_LONG_TAIL:
+        default:
+            std::pop_heap(live_.begin(), live_.end(), ExpiresLater());
+            victim = live_.back();
+            live_.pop_back();
+            break;
+    }
+    live_bytes_ -= victim.size;
+    return victim;
+}
+
+bool
+Generator::pop_live(LiveBlock *block)
+{
+    if (live_.empty()) {
+        return false;
+    }
+    *block = live_.back();
+    live_.pop_back();
+    live_bytes_ -= block->size;
+    return true;
+}
+
+} // namespace workload
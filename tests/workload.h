@@ -0,0 +1,129 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <stdint.h>
+#include <deque>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+//
+// Seedable workload generators shared by the test and benchmark executables.
+//
+// Everything is driven by std::mt19937_64 seeded from workload::default_seed(),
+// which honours the VA_WORKLOAD_SEED environment variable, so a run that shows
+// a regression can be replayed exactly.
+//
+namespace workload {
+
+typedef std::mt19937_64 Rng;
+
+// Seed used by every executable unless VA_WORKLOAD_SEED is set
+uint64_t default_seed(void);
+
+//
+// Size distributions
+//
+class SizeDistribution {
+public:
+    virtual ~SizeDistribution() {}
+    // Distributions are stateless, so one instance can feed several generators
+    virtual uint64_t next(Rng &rng) const = 0;
+    virtual std::string describe(void) const = 0;
+};
+
+typedef std::shared_ptr<SizeDistribution> SizeDistributionPtr;
+
+// Uniform sizes in [min_size, max_size]
+SizeDistributionPtr uniform_sizes(uint64_t min_size, uint64_t max_size);
+
+// Log-normal sizes with the given median and shape, clamped to [min_size, max_size].
+// Most requests are small with a long tail of large ones, as seen in real heaps.
+SizeDistributionPtr lognormal_sizes(uint64_t median, double sigma, uint64_t min_size, uint64_t max_size);
+
+// A fixed set of size classes whose popularity follows Zipf's law: the i-th
+// class (1-based) is picked with probability proportional to 1 / i^exponent.
+SizeDistributionPtr zipf_sizes(const std::vector<uint64_t> &classes, double exponent);
+
+//
+// Lifetime policies decide which live block a free operation releases
+//
+enum Lifetime {
+    LIFETIME_LIFO,       // Most recent allocation dies first (stack-like)
+    LIFETIME_FIFO,       // Oldest allocation dies first (queue-like)
+    LIFETIME_RANDOM,     // Any live allocation is equally likely to die
+    LIFETIME_LONG_TAIL,  // Pareto lifetimes: most die young, a few live very long
+};
+
+const char *lifetime_name(Lifetime lifetime);
+
+//
+// A phase issues 'ops' operations, each an allocation with probability
+// alloc_ratio (or whenever nothing is live) and a free otherwise.
+// Alternating high and low ratios produces bursty allocate/drain cycles.
+//
+struct Phase {
+    uint64_t ops;
+    double alloc_ratio;
+    SizeDistributionPtr sizes;
+};
+
+struct Spec {
+    std::vector<Phase> phases;  // Repeated in order until the caller stops
+    Lifetime lifetime;
+};
+
+// One steady phase with a fixed alloc/free mix
+Spec steady(SizeDistributionPtr sizes, double alloc_ratio, Lifetime lifetime);
+
+// Alternating bursts: burst_ops at burst_ratio, then drain_ops at drain_ratio
+Spec bursty(SizeDistributionPtr sizes, uint64_t burst_ops, double burst_ratio,
+            uint64_t drain_ops, double drain_ratio, Lifetime lifetime);
+
+struct Op {
+    enum Kind { ALLOC, FREE } kind;
+    uint64_t size;
+    uint64_t addr;  // Valid for FREE
+};
+
+struct LiveBlock {
+    uint64_t addr;
+    uint64_t size;
+    uint64_t expires;  // Operation count at which a LONG_TAIL block dies
+};
+
+//
+// Produces the operation stream for a Spec and owns the set of live blocks.
+// After an ALLOC op the caller reports the result with allocated(); a FREE op
+// has already been removed from the live set when it is returned.
+//
+class Generator {
+public:
+    Generator(const Spec &spec, uint64_t seed);
+
+    Op next(void);
+    void allocated(uint64_t addr, uint64_t size);
+
+    // Remove and return any live block, used to tear a run down
+    bool pop_live(LiveBlock *block);
+
+    size_t live_count(void) const { return live_.size(); }
+    uint64_t live_bytes(void) const { return live_bytes_; }
+    Rng &rng(void) { return rng_; }
+
+private:
+    LiveBlock take_victim(void);
+
+    Spec spec_;
+    Rng rng_;
+    size_t phase_idx_;
+    uint64_t phase_ops_;
+    uint64_t op_count_;
+    uint64_t live_bytes_;
+    std::deque<LiveBlock> live_;  // Insertion order, or a min-heap on 'expires' for LONG_TAIL
+};
+
+} // namespace workload
+
+#endif // WORKLOAD_H
@@ -1,30 +1,17 @@
 #include "addrtracker.h"
 
+// Only used by the generic AVL paths; lookups and inserts go through the
+// specialized functions below. Unsigned compares, as a signed difference
+// overflows for addresses more than 2^63 apart.
 static int cuiAddrTrackerCompare(CUavlTreeKey a, CUavlTreeKey b)
 {
-    NvS64 *addrA = (NvS64 *)a;
-    NvS64 *addrB = (NvS64 *)b;
+    NvU64 addrA = *(NvU64 *)a;
+    NvU64 addrB = *(NvU64 *)b;
 
-    NvS64 diff = *addrA - *addrB;
-    if (diff < 0) {
-        return -1;
-    }
-    else if (diff > 0) {
-        return 1;
-    }
-    return 0;
+    return (addrA < addrB) ? -1 : (addrA > addrB) ? 1 : 0;
 }
 
-static int cuiAddrTrackerNodeCompare(CUavlTreeKey a, CUavlTreeNode *nb)
-{
-    NvU64 addr = *(NvU64 *)a;
-    CUIaddrTrackerNode *node = container_of(nb, CUIaddrTrackerNode, node);
-
-    if (addr >= node->addr && addr < node->addr + node->size) {
-        return 0;
-    }
-    return addr < node->addr ? -1 : 1;
-}
+CU_AVL_TREE_DEFINE_NVU64_KEYED(cuiAddrTrackerTree, CUIaddrTrackerNode, node, addr)
 
 void cuiAddrTrackerInit(CUIaddrTracker *tracker, NvU64 lo, NvU64 afterHi)
 {
@@ -56,9 +43,21 @@ static CUIaddrTrackerNode *toTracker(CUavlTreeNode *avlNode)
 CUIaddrTrackerNode *cuiAddrTrackerFindNode(CUIaddrTracker *tracker, NvU64 addr)
 {
     //cuiRWLockReadLock(&tracker->lock);
-    CUIaddrTrackerNode *node = toTracker(cuAvlTreeNodeFindWithNodeComparator(&tracker->tree,
-                                                                             &addr,
-                                                                             cuiAddrTrackerNodeCompare));
+    CUavlTreeNode *avlNode = tracker->tree.root;
+    CUIaddrTrackerNode *node = NULL;
+    while (avlNode) {
+        CUIaddrTrackerNode *cur = container_of(avlNode, CUIaddrTrackerNode, node);
+        if (addr < cur->addr) {
+            avlNode = avlNode->left;
+        }
+        else if (addr - cur->addr >= cur->size) {
+            avlNode = avlNode->right;
+        }
+        else {
+            node = cur;
+            break;
+        }
+    }
     //cuiRWLockReadUnlock(&tracker->lock);
     return node;
 }
@@ -67,7 +66,7 @@ CUIaddrTrackerNode *cuiAddrTrackerFindFirstNodeInRange(CUIaddrTracker *tracker,
 {
     CU_ASSERT(lo < afterHi);
     //cuiRWLockReadLock(&tracker->lock);
-    CUIaddrTrackerNode *node = toTracker(cuAvlTreeNodeFindGEQ(&tracker->tree, &lo));
+    CUIaddrTrackerNode *node = cuiAddrTrackerTreeFindGEQ(&tracker->tree, lo);
 
     if (node == NULL || (node->addr + node->size > afterHi)) {
         node = NULL;
@@ -83,7 +82,7 @@ NvBool cuiAddrTrackerIsEmptyForRange(CUIaddrTracker *tracker, NvU64 lo, NvU64 af
     NvU64 hi = afterHi - 1;
     //cuiRWLockReadLock(&tracker->lock);
 
-    CUIaddrTrackerNode *node = toTracker(cuAvlTreeNodeFindLEQ(&tracker->tree, &hi));
+    CUIaddrTrackerNode *node = cuiAddrTrackerTreeFindLEQ(&tracker->tree, hi);
     NvBool isEmpty = node == NULL || (node->addr + node->size <= lo);
 
     //cuiRWLockReadUnlock(&tracker->lock);
@@ -137,10 +136,7 @@ CUIaddrTrackerNode *cuiAddrTrackerRegisterNodeOrReturnExisting(CUIaddrTracker *t
     node->tracker = tracker;
 
     //cuiRWLockWriteLock(&tracker->lock);
-    CUIaddrTrackerNode *existing = toTracker(cuAvlTreeNodeInsertOrReturnExisting(&tracker->tree,
-                                                                                 &node->node,
-                                                                                 &node->addr,
-                                                                                 NULL));
+    CUIaddrTrackerNode *existing = cuiAddrTrackerTreeInsertOrReturnExisting(&tracker->tree, node);
     //cuiRWLockWriteUnlock(&tracker->lock);
 
     if (existing != NULL) {
@@ -13,13 +13,15 @@ typedef struct CUIaddrTracker_st
     //CUIrwlock lock;
 } CUIaddrTracker;
 
+// The range and the child links a lookup reads at every level are the first
+// 32 bytes of the node. The node itself is 88 bytes and not line aligned, so
+// those fields can still straddle two cache lines.
 typedef struct CUIaddrTrackerNode_st
 {
-    CUavlTreeNode node;
-    CUIaddrTracker *tracker;
-
     NvU64 addr;
     NvU64 size;
+    CUavlTreeNode node;
+    CUIaddrTracker *tracker;
     void *value;
 } CUIaddrTrackerNode;
 
@@ -90,6 +90,11 @@ static int cuAvlTreeAssertValidRecursive(CUavlTree *tree, CUavlTreeNode *node, i
     }
     height = MAX(lefth, righth) + 1;
     CU_ASSERT(!node || height == node->height);
+    if (node && tree->augment) {
+        NvU64 augment = node->augment;
+        tree->augment(node);
+        CU_ASSERT(augment == node->augment);
+    }
     return height;
 }
 
@@ -118,9 +123,14 @@ static inline int cuAvlTreeNodeGetBalance(CUavlTree *tree, CUavlTreeNode *node)
     return balance;
 }
 
+// Every structural change recalculates the height bottom-up, so the
+// augmentation is refreshed here too and survives rotations for free.
 static inline void cuAvlTreeNodeRecalculateHeight(CUavlTree *tree, CUavlTreeNode *node)
 {
     node->height = 1 + MAX(cuAvlTreeNodeGetHeight(tree, node->left), cuAvlTreeNodeGetHeight(tree, node->right));
+    if (tree->augment) {
+        tree->augment(node);
+    }
 }
 
 static inline CUavlTreeNode **cuAvlTreeNodeGetLinkPointer(CUavlTree *tree, CUavlTreeNode *node)
@@ -238,6 +248,12 @@ void cuAvlTreeDeinitialize(CUavlTree *tree)
     memset(tree, 0, sizeof(*tree));
 }
 
+void cuAvlTreeSetAugment(CUavlTree *tree, CUavlTreeAugment augment)
+{
+    CU_ASSERT(tree->root == NULL);
+    tree->augment = augment;
+}
+
 CUavlTreeNode *cuAvlTreeNodeFind(CUavlTree *tree, CUavlTreeKey key)
 {
     return cuAvlTreeNodeFindWithComparator(tree, key, tree->compare);
@@ -300,15 +316,22 @@ CUavlTreeNode *cuAvlTreeNodeInsertOrReturnExisting(CUavlTree *tree, CUavlTreeNod
         parent = *childLink;
     }
 
-    // Link up the node
+    cuAvlTreeNodeLink(tree, node, parent, childLink);
+    return NULL;
+}
+
+void cuAvlTreeNodeLink(CUavlTree *tree, CUavlTreeNode *node, CUavlTreeNode *parent, CUavlTreeNode **childLink)
+{
+    CU_ASSERT(*childLink == NULL);
+
     *childLink = node;
     node->parent = parent;
+    cuAvlTreeNodeRecalculateHeight(tree, node);
     cuAvlTreeNodeRebalance(tree, parent, 0);
 
 #if CU_AVLTREE_DEBUG
         cuAvlTreeAssertValid(tree);
 #endif
-    return NULL;
 }
 
 CUavlTreeStatus cuAvlTreeNodeInsert(CUavlTree *tree, CUavlTreeNode *node, CUavlTreeKey key, CUavlTreeValue value)
@@ -3,6 +3,10 @@
 
 #include "utils_types.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 enum CUavlTreeStatus_enum
 {
     CU_AVL_TREE_STATUS_SUCCESS    = 0,
@@ -17,6 +21,8 @@ typedef enum   CUavlTreeStatus_enum CUavlTreeStatus;
 typedef void (*CUavlTreePrint)(CUavlTreeKey key);
 typedef int  (*CUavlTreeCompare)(CUavlTreeKey a, CUavlTreeKey b);
 typedef int  (*CUavlTreeNodeCompare)(CUavlTreeKey ka, CUavlTreeNode *nb);
+// Recomputes node->augment from the node and its children's augment values
+typedef void (*CUavlTreeAugment)(CUavlTreeNode *node);
 
 struct CUavlTreeNode_st
 {
@@ -26,6 +32,7 @@ struct CUavlTreeNode_st
     CUavlTreeValue value;
     CUavlTreeNode *parent;
     int            height;
+    NvU64          augment;  // Per-subtree value kept up to date by tree->augment
 };
 
 struct CUavlTree_st
@@ -33,12 +40,15 @@ struct CUavlTree_st
     CUavlTreePrint   print;
     CUavlTreeCompare compare;
     CUavlTreeNode   *root;
+    CUavlTreeAugment augment;
 };
 
 void            cuAvlTreeAssertValid(CUavlTree *tree);
 
 void            cuAvlTreeInitialize(CUavlTree *tree, CUavlTreeCompare compare, CUavlTreePrint print);
 void            cuAvlTreeDeinitialize(CUavlTree *tree);
+// Optional, must be set while the tree is empty
+void            cuAvlTreeSetAugment(CUavlTree *tree, CUavlTreeAugment augment);
 CUavlTreeNode  *cuAvlTreeNodeFind(CUavlTree *tree, CUavlTreeKey key);
 CUavlTreeNode  *cuAvlTreeNodeFindGEQ(CUavlTree *tree, CUavlTreeKey key);
 CUavlTreeNode  *cuAvlTreeNodeFindLEQ(CUavlTree *tree, CUavlTreeKey key);
@@ -51,4 +61,90 @@ CUavlTreeNode  *cuAvlTreeNodeInOrderSuccessor(CUavlTree *tree, CUavlTreeNode *no
 CUavlTreeNode *cuAvlTreeNodeFindWithNodeComparator(CUavlTree *tree, CUavlTreeKey key, CUavlTreeNodeCompare comparator);
 CUavlTreeNode *cuAvlTreeNodeFindWithComparator(CUavlTree *tree, CUavlTreeKey key, CUavlTreeCompare comparator);
 
+// Links 'node' (already keyed) below 'parent' at '*childLink' and rebalances.
+// For callers that search for the insertion point themselves.
+void           cuAvlTreeNodeLink(CUavlTree *tree, CUavlTreeNode *node, CUavlTreeNode *parent, CUavlTreeNode **childLink);
+
+//
+// Comparator-specialized accessors for trees of 'type' objects that embed a
+// CUavlTreeNode as 'nodeMember' and are ordered on the NvU64 'keyMember'.
+// The generated functions compare keys inline instead of calling
+// tree->compare at every level:
+//
+//   type *prefix##FindGEQ(CUavlTree *tree, NvU64 key);
+//   type *prefix##FindLEQ(CUavlTree *tree, NvU64 key);
+//   type *prefix##InsertOrReturnExisting(CUavlTree *tree, type *obj);
+//
+// The node's key must still point at 'keyMember' so that the generic
+// functions (and tree->compare) keep working on the same tree.
+//
+#define CU_AVL_TREE_ENTRY(node, type, nodeMember) \
+    ((type *)((char *)(node) - offsetof(type, nodeMember)))
+
+#define CU_AVL_TREE_DEFINE_NVU64_KEYED(prefix, type, nodeMember, keyMember)                 \
+static inline type *prefix##FindGEQ(CUavlTree *tree, NvU64 key)                             \
+{                                                                                           \
+    CUavlTreeNode *node = tree->root;                                                       \
+    type *best = NULL;                                                                      \
+    while (node) {                                                                          \
+        type *obj = CU_AVL_TREE_ENTRY(node, type, nodeMember);                              \
+        if (key < obj->keyMember) {                                                         \
+            best = obj;                                                                     \
+            node = node->left;                                                              \
+        }                                                                                   \
+        else if (key > obj->keyMember) {                                                    \
+            node = node->right;                                                             \
+        }                                                                                   \
+        else {                                                                              \
+            return obj;                                                                     \
+        }                                                                                   \
+    }                                                                                       \
+    return best;                                                                            \
+}                                                                                           \
+                                                                                            \
+static inline type *prefix##FindLEQ(CUavlTree *tree, NvU64 key)                             \
+{                                                                                           \
+    CUavlTreeNode *node = tree->root;                                                       \
+    type *best = NULL;                                                                      \
+    while (node) {                                                                          \
+        type *obj = CU_AVL_TREE_ENTRY(node, type, nodeMember);                              \
+        if (key > obj->keyMember) {                                                         \
+            best = obj;                                                                     \
+            node = node->right;                                                             \
+        }                                                                                   \
+        else if (key < obj->keyMember) {                                                    \
+            node = node->left;                                                              \
+        }                                                                                   \
+        else {                                                                              \
+            return obj;                                                                     \
+        }                                                                                   \
+    }                                                                                       \
+    return best;                                                                            \
+}                                                                                           \
+                                                                                            \
+static inline type *prefix##InsertOrReturnExisting(CUavlTree *tree, type *obj)              \
+{                                                                                           \
+    CUavlTreeNode *parent = NULL;                                                           \
+    CUavlTreeNode **childLink = &tree->root;                                                \
+    NvU64 key = obj->keyMember;                                                             \
+    while (*childLink) {                                                                    \
+        type *cur;                                                                          \
+        parent = *childLink;                                                                \
+        cur = CU_AVL_TREE_ENTRY(parent, type, nodeMember);                                  \
+        if (key == cur->keyMember) {                                                        \
+            return cur;                                                                     \
+        }                                                                                   \
+        childLink = (key < cur->keyMember) ? &parent->left : &parent->right;                \
+    }                                                                                       \
+    memset(&obj->nodeMember, 0, sizeof(obj->nodeMember));                                   \
+    obj->nodeMember.key = (CUavlTreeKey)&obj->keyMember;                                    \
+    obj->nodeMember.height = 1;                                                             \
+    cuAvlTreeNodeLink(tree, &obj->nodeMember, parent, childLink);                           \
+    return NULL;                                                                            \
+}
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif // AVL_TREE_H
\ No newline at end of file
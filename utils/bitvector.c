@@ -1,5 +1,12 @@
 #include "bitvector.h"
 
+#if defined(__x86_64__) || defined(__i386__)
+#define CU_BITVECTOR_X86 1
+#include <immintrin.h>
+#else
+#define CU_BITVECTOR_X86 0
+#endif
+
 // The bit vector is divided into "chunks" where each chunk is 64-bits wide
 // and is the smallest bit vector that can be allocated. Normally, memory
 // is allocated for the chunks. But if the size can be contained within a
@@ -28,6 +35,205 @@ struct CUbitvector_st {
     } bits;
 };
 
+//
+// Word scan kernels:
+//
+// Every range scan reduces to "find the first whole chunk that differs from
+// a pattern" (0 for set bits, ~0 for clear bits) with the partial chunks at
+// either end handled by masks. The kernels below compare several chunks per
+// iteration and fall back to the scalar loop to locate the exact chunk.
+// The widest kernel the CPU supports is picked on first use.
+//
+typedef size_t (*cuibitvectorScanFn)(const NvU64 *chunks, size_t count, NvU64 pattern);
+
+static size_t
+cuibitvectorScanScalar(const NvU64 *chunks, size_t count, NvU64 pattern)
+{
+    size_t i;
+    for (i = 0; i < count; i++) {
+        if (chunks[i] != pattern) {
+            return i;
+        }
+    }
+    return count;
+}
+
+#if CU_BITVECTOR_X86
+__attribute__((target("sse4.1")))
+static size_t
+cuibitvectorScanSse4(const NvU64 *chunks, size_t count, NvU64 pattern)
+{
+    const __m128i p = _mm_set1_epi64x((long long)pattern);
+    size_t i = 0;
+
+    // 8 chunks (512 bits) per iteration
+    for (; i + 8 <= count; i += 8) {
+        __m128i a = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(chunks + i)), p);
+        __m128i b = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(chunks + i + 2)), p);
+        __m128i c = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(chunks + i + 4)), p);
+        __m128i d = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(chunks + i + 6)), p);
+        __m128i any = _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+        if (!_mm_testz_si128(any, any)) {
+            break;
+        }
+    }
+    return i + cuibitvectorScanScalar(chunks + i, count - i, pattern);
+}
+
+__attribute__((target("avx2")))
+static size_t
+cuibitvectorScanAvx2(const NvU64 *chunks, size_t count, NvU64 pattern)
+{
+    const __m256i p = _mm256_set1_epi64x((long long)pattern);
+    size_t i = 0;
+
+    // 16 chunks (1024 bits) per iteration
+    for (; i + 16 <= count; i += 16) {
+        __m256i a = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(chunks + i)), p);
+        __m256i b = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(chunks + i + 4)), p);
+        __m256i c = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(chunks + i + 8)), p);
+        __m256i d = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(chunks + i + 12)), p);
+        __m256i any = _mm256_or_si256(_mm256_or_si256(a, b), _mm256_or_si256(c, d));
+        if (!_mm256_testz_si256(any, any)) {
+            break;
+        }
+    }
+    return i + cuibitvectorScanScalar(chunks + i, count - i, pattern);
+}
+#endif
+
+// Chosen on first use from whichever thread scans first, so it is only read
+// and written atomically. Racing AUTO selections store the same kernel.
+static cuibitvectorScanFn cuibitvectorScanKernel = NULL;
+
+static NvBool
+cuibitvectorKernelSupported(CUbitvectorKernel kernel)
+{
+    switch (kernel) {
+        case CU_BITVECTOR_KERNEL_SCALAR:
+            return NV_TRUE;
+#if CU_BITVECTOR_X86
+        case CU_BITVECTOR_KERNEL_SSE4:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse4.1") ? NV_TRUE : NV_FALSE;
+        case CU_BITVECTOR_KERNEL_AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") ? NV_TRUE : NV_FALSE;
+#endif
+        default:
+            return NV_FALSE;
+    }
+}
+
+NvBool
+cuibitvectorSelectKernel(CUbitvectorKernel kernel)
+{
+    if (kernel == CU_BITVECTOR_KERNEL_AUTO) {
+        kernel = cuibitvectorKernelSupported(CU_BITVECTOR_KERNEL_AVX2) ? CU_BITVECTOR_KERNEL_AVX2 :
+                 cuibitvectorKernelSupported(CU_BITVECTOR_KERNEL_SSE4) ? CU_BITVECTOR_KERNEL_SSE4 :
+                 CU_BITVECTOR_KERNEL_SCALAR;
+    }
+    if (!cuibitvectorKernelSupported(kernel)) {
+        return NV_FALSE;
+    }
+
+    cuibitvectorScanFn scan;
+    switch (kernel) {
+#if CU_BITVECTOR_X86
+        case CU_BITVECTOR_KERNEL_AVX2:
+            scan = cuibitvectorScanAvx2;
+            break;
+        case CU_BITVECTOR_KERNEL_SSE4:
+            scan = cuibitvectorScanSse4;
+            break;
+#endif
+        default:
+            scan = cuibitvectorScanScalar;
+            break;
+    }
+    __atomic_store_n(&cuibitvectorScanKernel, scan, __ATOMIC_RELAXED);
+    return NV_TRUE;
+}
+
+// Index of the first of 'count' chunks that differs from 'pattern', or 'count'
+static inline size_t
+cuibitvectorScan(const NvU64 *chunks, size_t count, NvU64 pattern)
+{
+    cuibitvectorScanFn scan = __atomic_load_n(&cuibitvectorScanKernel, __ATOMIC_RELAXED);
+    if (!scan) {
+        cuibitvectorSelectKernel(CU_BITVECTOR_KERNEL_AUTO);
+        scan = __atomic_load_n(&cuibitvectorScanKernel, __ATOMIC_RELAXED);
+    }
+    return scan(chunks, count, pattern);
+}
+
+static inline NvU64 *
+cuibitvectorChunks(CUbitvector *bitvector)
+{
+    return (bitvector->numBits <= INLINE_LIMIT) ? &bitvector->bits.inlineVec : bitvector->bits.vecPtr;
+}
+
+// Finds the first chunk in [lowBit, highBit] with a bit that differs from
+// 'pattern'. Returns true with the chunk index and the differing bits
+// (restricted to the range) if there is one.
+static NvBool
+cuibitvectorScanRange(const NvU64 *vector, NvU64 lowBit, NvU64 highBit, NvU64 pattern,
+                      NvU64 *chunkIdx_out, NvU64 *diff_out)
+{
+    size_t lowChunkIdx = (size_t)CHUNK_INDEX(lowBit);
+    size_t highChunkIdx = (size_t)CHUNK_INDEX(highBit);
+    NvU64 lowMask = ~0ULL << (lowBit % BITS_PER_CHUNK);
+    NvU64 highMask = ~0ULL >> (BITS_PER_CHUNK - 1 - highBit % BITS_PER_CHUNK);
+    NvU64 diff;
+
+    if (lowChunkIdx == highChunkIdx) {
+        diff = (vector[lowChunkIdx] ^ pattern) & lowMask & highMask;
+        *chunkIdx_out = lowChunkIdx;
+        *diff_out = diff;
+        return (diff != 0);
+    }
+
+    diff = (vector[lowChunkIdx] ^ pattern) & lowMask;
+    if (diff) {
+        *chunkIdx_out = lowChunkIdx;
+        *diff_out = diff;
+        return NV_TRUE;
+    }
+
+    size_t count = highChunkIdx - lowChunkIdx - 1;
+    size_t i = cuibitvectorScan(vector + lowChunkIdx + 1, count, pattern);
+    if (i < count) {
+        *chunkIdx_out = lowChunkIdx + 1 + i;
+        *diff_out = vector[lowChunkIdx + 1 + i] ^ pattern;
+        return NV_TRUE;
+    }
+
+    diff = (vector[highChunkIdx] ^ pattern) & highMask;
+    *chunkIdx_out = highChunkIdx;
+    *diff_out = diff;
+    return (diff != 0);
+}
+
+// Applies 'pattern' to every bit in [lowBit, highBit]; whole chunks are filled with memset
+static void
+cuibitvectorFillRange(NvU64 *vector, NvU64 lowBit, NvU64 highBit, NvU64 pattern)
+{
+    size_t lowChunkIdx = (size_t)CHUNK_INDEX(lowBit);
+    size_t highChunkIdx = (size_t)CHUNK_INDEX(highBit);
+    NvU64 lowMask = ~0ULL << (lowBit % BITS_PER_CHUNK);
+    NvU64 highMask = ~0ULL >> (BITS_PER_CHUNK - 1 - highBit % BITS_PER_CHUNK);
+
+    if (lowChunkIdx == highChunkIdx) {
+        NvU64 mask = lowMask & highMask;
+        vector[lowChunkIdx] = (vector[lowChunkIdx] & ~mask) | (pattern & mask);
+        return;
+    }
+
+    vector[lowChunkIdx] = (vector[lowChunkIdx] & ~lowMask) | (pattern & lowMask);
+    memset(vector + lowChunkIdx + 1, pattern ? 0xff : 0, CHUNK_SIZE * (highChunkIdx - lowChunkIdx - 1));
+    vector[highChunkIdx] = (vector[highChunkIdx] & ~highMask) | (pattern & highMask);
+}
+
 NvBool
 cubitvectorCreate(CUbitvector **bitvector, NvU64 numBits)
 {
@@ -197,26 +403,7 @@ cubitvectorSetBitsInRange(CUbitvector *bitvector, size_t lowBit, size_t highBit)
         return;
     }
 
-    NvU64 *vector = bitvector->bits.vecPtr;
-    if (bitvector->numBits <= INLINE_LIMIT) {
-        vector = &bitvector->bits.inlineVec;
-    }
-
-    size_t lowChunkIdx = CHUNK_INDEX(lowBit);
-    size_t highChunkIdx = CHUNK_INDEX(highBit);
-
-    size_t i;
-    for (i = lowChunkIdx; i <= highChunkIdx; i++) {
-        NvU64 mask = ~0ULL;
-        if (i == lowChunkIdx) {
-            mask <<= lowBit % BITS_PER_CHUNK;
-        }
-        if (i == highChunkIdx) {
-            mask &= ~0ULL >> (BITS_PER_CHUNK - 1 - highBit % BITS_PER_CHUNK);
-        }
-
-        vector[i] |= mask;
-    }
+    cuibitvectorFillRange(cuibitvectorChunks(bitvector), lowBit, highBit, ~0ULL);
 }
 
 void
@@ -226,26 +413,7 @@ cubitvectorClearBitsInRange(CUbitvector *bitvector, size_t lowBit, size_t highBi
         return;
     }
 
-    NvU64 *vector = bitvector->bits.vecPtr;
-    if (bitvector->numBits <= INLINE_LIMIT) {
-        vector = &bitvector->bits.inlineVec;
-    }
-
-    size_t lowChunkIdx = CHUNK_INDEX(lowBit);
-    size_t highChunkIdx = CHUNK_INDEX(highBit);
-
-    size_t i;
-    for (i = lowChunkIdx; i <= highChunkIdx; i++) {
-        NvU64 mask = ~0ULL;
-        if (i == lowChunkIdx) {
-            mask <<= lowBit % BITS_PER_CHUNK;
-        }
-        if (i == highChunkIdx) {
-            mask &= ~0ULL >> (BITS_PER_CHUNK - 1 - highBit % BITS_PER_CHUNK);
-        }
-
-        vector[i] &= ~mask;
-    }
+    cuibitvectorFillRange(cuibitvectorChunks(bitvector), lowBit, highBit, 0);
 }
 
 NvBool
@@ -290,59 +458,27 @@ cubitvectorIsAnyBitSet(CUbitvector *bitvector)
     if (bitvector->numBits <= INLINE_LIMIT) {
         return (bitvector->bits.inlineVec != 0);
     }
-    else {
-        NvU64 i, numChunks = NUM_CHUNKS(bitvector->numBits);
-        for (i = 0; i < numChunks; i++) {
-            if (bitvector->bits.vecPtr[i]) {
-                return NV_TRUE;
-            }
-        }
-    }
 
-    return NV_FALSE;
+    NvU64 numChunks = NUM_CHUNKS(bitvector->numBits);
+    return (cuibitvectorScan(bitvector->bits.vecPtr, (size_t)numChunks, 0) < numChunks);
 }
 
-static NvBool cubitvectorSetLowestClearBitInChunk(NvU64 *chunk, size_t bitCount, NvU64 *bit)
-{
-    size_t i;
-    for (i = 0; i < bitCount; i++) {
-        if ((*chunk & CHUNK_BITMASK(i)) == 0) {
-            *chunk |= CHUNK_BITMASK(i);
-            *bit = i;
-            return NV_TRUE;
-        }
-    }
- 
-    return NV_FALSE;
-}
- 
 NvBool cubitvectorSetLowestClearBit(CUbitvector *bitvector, NvU64 *bit)
 {
     if (!bitvector) {
         return NV_FALSE;
     }
- 
-    NvU64 *vector = bitvector->bits.vecPtr;
-    if (bitvector->numBits <= INLINE_LIMIT) {
-        vector = &bitvector->bits.inlineVec;
-    }
- 
-    size_t highBit = (size_t)bitvector->numBits - 1;
-    size_t highChunkIdx = CHUNK_INDEX(highBit);
- 
-    size_t i;
-    for (i = 0; i <= highChunkIdx; i++) {
-        if (vector[i] != ~0ULL) {
-            size_t totalBitsInChunk = (i == highChunkIdx) ? BITS_IN_LAST_CHUNK(bitvector->numBits) : BITS_PER_CHUNK;
- 
-            if (cubitvectorSetLowestClearBitInChunk(&vector[i], totalBitsInChunk, bit)) {
-                *bit = i * BITS_PER_CHUNK + *bit;
-                return NV_TRUE;
-            }
-        }
+
+    NvU64 *vector = cuibitvectorChunks(bitvector);
+    NvU64 chunkIdx, diff;
+    if (!cuibitvectorScanRange(vector, 0, bitvector->numBits - 1, ~0ULL, &chunkIdx, &diff)) {
+        return NV_FALSE;
     }
- 
-    return NV_FALSE;
+
+    NvU64 j = __builtin_ctzll(diff);
+    vector[chunkIdx] |= CHUNK_BITMASK(j);
+    *bit = chunkIdx * BITS_PER_CHUNK + j;
+    return NV_TRUE;
 }
 
 static NvBool cuibitvectorFindLowestBitInRange_common(CUbitvector *bitvector, NvU64 lowBit, NvU64 highBit, NvU64 *bit_out, NvBool findClearBit)
@@ -350,37 +486,15 @@ static NvBool cuibitvectorFindLowestBitInRange_common(CUbitvector *bitvector, Nv
     if (!bitvector || lowBit > highBit || highBit > bitvector->numBits - 1) {
         return NV_FALSE;
     }
- 
-    NvU64 *vector = bitvector->bits.vecPtr;
-    if (bitvector->numBits <= INLINE_LIMIT) {
-        vector = &bitvector->bits.inlineVec;
-    }
- 
-    size_t lowChunkIdx = (size_t)CHUNK_INDEX(lowBit);
-    size_t highChunkIdx = (size_t)CHUNK_INDEX(highBit);
 
-    NvU64 i;
-    for (i = lowChunkIdx; i <= highChunkIdx; i++) {
-        NvU64 chunk = findClearBit ? ~vector[i] : vector[i];
-        NvU64 mask = ~0ULL;
-        if (i == lowChunkIdx) {
-            mask <<= lowBit % BITS_PER_CHUNK;
-        }
-        if (i == highChunkIdx) {
-            mask &= ~0ULL >> (BITS_PER_CHUNK - 1 - highBit % BITS_PER_CHUNK);
-        }
-        if ((mask & chunk) != 0) {
-            NvU64 j;
-            for (j = 0; j < BITS_PER_CHUNK; j++) {
-                if ((mask & chunk & CHUNK_BITMASK(j)) != 0) {
-                    *bit_out = i * BITS_PER_CHUNK + j;
-                    return NV_TRUE;
-                }
-            }
-        }
+    NvU64 chunkIdx, diff;
+    if (!cuibitvectorScanRange(cuibitvectorChunks(bitvector), lowBit, highBit, findClearBit ? ~0ULL : 0,
+                               &chunkIdx, &diff)) {
+        return NV_FALSE;
     }
- 
-    return NV_FALSE;
+
+    *bit_out = chunkIdx * BITS_PER_CHUNK + __builtin_ctzll(diff);
+    return NV_TRUE;
 }
 
 NvBool cubitvectorFindLowestClearBitInRange(CUbitvector *bitvector, NvU64 lowBit, NvU64 highBit, NvU64 *bit_out)
@@ -393,71 +507,89 @@ NvBool cubitvectorFindLowestSetBitInRange(CUbitvector *bitvector, NvU64 lowBit,
     return cuibitvectorFindLowestBitInRange_common(bitvector, lowBit, highBit, bit_out, NV_FALSE);
 }
 
+// First run of 'n' clear bits that lies entirely within [lowBit, highBit].
+// Alternates between skipping to the next clear bit and checking the
+// candidate window for a set bit; both are chunk scans, so the cost is
+// bounded by the chunks covered rather than by the number of free runs.
+static NvBool
+cuibitvectorFindClearRunInRange(const NvU64 *vector, NvU64 lowBit, NvU64 highBit, NvU64 n, NvU64 *start)
+{
+    NvU64 pos = lowBit;
+    while (pos + n - 1 <= highBit) {
+        NvU64 chunkIdx, diff;
+        if (!cuibitvectorScanRange(vector, pos, highBit, ~0ULL, &chunkIdx, &diff)) {
+            return NV_FALSE;
+        }
+        NvU64 runStart = chunkIdx * BITS_PER_CHUNK + __builtin_ctzll(diff);
+        if (runStart + n - 1 > highBit) {
+            return NV_FALSE;
+        }
+        if (!cuibitvectorScanRange(vector, runStart, runStart + n - 1, 0, &chunkIdx, &diff)) {
+            *start = runStart;
+            return NV_TRUE;
+        }
+        // Restart just past the set bit that broke the run
+        pos = chunkIdx * BITS_PER_CHUNK + __builtin_ctzll(diff) + 1;
+    }
+    return NV_FALSE;
+}
 
 NvBool
-cubitvectorAreAllBitsSetInRange(CUbitvector *bitvector, size_t lowBit, size_t highBit)
+cubitvectorFindClearRun(CUbitvector *bitvector, NvU64 n, NvU64 hint, NvU64 *start)
 {
-    if (!bitvector || lowBit > highBit || highBit > bitvector->numBits - 1) {
+    if (!bitvector || n == 0 || n > bitvector->numBits) {
         return NV_FALSE;
     }
-
-    NvU64 *vector = bitvector->bits.vecPtr;
-    if (bitvector->numBits <= INLINE_LIMIT) {
-        vector = &bitvector->bits.inlineVec;
+    if (hint >= bitvector->numBits) {
+        hint = 0;
     }
 
-    size_t lowChunkIdx = CHUNK_INDEX(lowBit);
-    size_t highChunkIdx = CHUNK_INDEX(highBit);
+    const NvU64 *vector = cuibitvectorChunks(bitvector);
+    NvU64 lastBit = bitvector->numBits - 1;
+    if (cuibitvectorFindClearRunInRange(vector, hint, lastBit, n, start)) {
+        return NV_TRUE;
+    }
+    if (hint == 0) {
+        return NV_FALSE;
+    }
 
-    size_t i;
-    for (i = lowChunkIdx; i <= highChunkIdx; i++) {
-        NvU64 mask = ~0ULL;
-        if (i == lowChunkIdx) {
-            mask <<= lowBit % BITS_PER_CHUNK;
-        }
-        if (i == highChunkIdx) {
-            mask &= ~0ULL >> (BITS_PER_CHUNK - 1 - highBit % BITS_PER_CHUNK);
-        }
+    // Wrap around: runs starting before the hint, which may extend past it
+    NvU64 highBit = hint + n - 2;
+    return cuibitvectorFindClearRunInRange(vector, 0, (highBit < lastBit) ? highBit : lastBit, n, start);
+}
 
-        if ((mask & vector[i]) != mask) {
-            return NV_FALSE;
-        }
+NvBool
+cubitvectorFindAndSetClearRun(CUbitvector *bitvector, NvU64 n, NvU64 hint, NvU64 *start)
+{
+    if (!cubitvectorFindClearRun(bitvector, n, hint, start)) {
+        return NV_FALSE;
     }
 
+    cuibitvectorFillRange(cuibitvectorChunks(bitvector), *start, *start + n - 1, ~0ULL);
     return NV_TRUE;
 }
 
+
 NvBool
-cubitvectorAreAllBitsClearInRange(CUbitvector *bitvector, size_t lowBit, size_t highBit)
+cubitvectorAreAllBitsSetInRange(CUbitvector *bitvector, size_t lowBit, size_t highBit)
 {
     if (!bitvector || lowBit > highBit || highBit > bitvector->numBits - 1) {
         return NV_FALSE;
     }
 
-    NvU64 *vector = bitvector->bits.vecPtr;
-    if (bitvector->numBits <= INLINE_LIMIT) {
-        vector = &bitvector->bits.inlineVec;
-    }
-
-    size_t lowChunkIdx = CHUNK_INDEX(lowBit);
-    size_t highChunkIdx = CHUNK_INDEX(highBit);
-
-    size_t i;
-    for (i = lowChunkIdx; i <= highChunkIdx; i++) {
-        NvU64 mask = ~0ULL;
-        if (i == lowChunkIdx) {
-            mask <<= lowBit % BITS_PER_CHUNK;
-        }
-        if (i == highChunkIdx) {
-            mask &= ~0ULL >> (BITS_PER_CHUNK - 1 - highBit % BITS_PER_CHUNK);
-        }
+    NvU64 chunkIdx, diff;
+    return !cuibitvectorScanRange(cuibitvectorChunks(bitvector), lowBit, highBit, ~0ULL, &chunkIdx, &diff);
+}
 
-        if ((~mask | vector[i]) != ~mask) {
-            return NV_FALSE;
-        }
+NvBool
+cubitvectorAreAllBitsClearInRange(CUbitvector *bitvector, size_t lowBit, size_t highBit)
+{
+    if (!bitvector || lowBit > highBit || highBit > bitvector->numBits - 1) {
+        return NV_FALSE;
     }
 
-    return NV_TRUE;
+    NvU64 chunkIdx, diff;
+    return !cuibitvectorScanRange(cuibitvectorChunks(bitvector), lowBit, highBit, 0, &chunkIdx, &diff);
 }
 
 NvBool
@@ -534,14 +666,8 @@ cuibitvectorFindHighestBitInRange_common(CUbitvector *bitvector, NvU64 lowBit, N
             mask &= ~0ULL >> (BITS_PER_CHUNK - 1 - highBit % BITS_PER_CHUNK);
         }
         if ((mask & chunk) != 0) {
-            NvU64 j;
-            for (j = BITS_PER_CHUNK; j > 0; j--) {
-                NvU64 bit = j - 1;
-                if ((mask & chunk & CHUNK_BITMASK(bit)) != 0) {
-                    *bit_out = idx * BITS_PER_CHUNK + bit;
-                    return NV_TRUE;
-                }
-            }
+            *bit_out = idx * BITS_PER_CHUNK + (BITS_PER_CHUNK - 1 - __builtin_clzll(mask & chunk));
+            return NV_TRUE;
         }
     }
 
@@ -70,6 +70,14 @@ NvBool cubitvectorFindLowestClearBitInRange(CUbitvector *bitvector, NvU64 lowBit
 // If there is no set bit, returns false.
 NvBool cubitvectorFindLowestSetBitInRange(CUbitvector *bitvector, NvU64 lowBit, NvU64 highBit, NvU64 *bit_out);
 
+// Returns true after finding 'n' consecutive clear bits. The search starts at 'hint' and
+// wraps around to bit 0; the first bit of the run is returned in 'start'.
+// If there is no such run, returns false.
+NvBool cubitvectorFindClearRun(CUbitvector *bitvector, NvU64 n, NvU64 hint, NvU64 *start);
+
+// Same as cubitvectorFindClearRun, and sets every bit of the run that was found.
+NvBool cubitvectorFindAndSetClearRun(CUbitvector *bitvector, NvU64 n, NvU64 hint, NvU64 *start);
+
 // Returns true if the two bitvectors are equal
 NvBool cubitvectorCompare(CUbitvector *bitvector1, CUbitvector *bitvector2);
 
@@ -85,6 +93,19 @@ NvBool cuibitvectorFindHighestSetBitInRange(CUbitvector *bitvector, NvU64 lowBit
 // Range is inclusive, so [0, 0] has a size of 1.
 NvBool cuibitvectorFindHighestClearBitInRange(CUbitvector *bitvector, NvU64 lowBit, NvU64 highBit, NvU64 *bit_out);
 
+typedef enum CUbitvectorKernel_enum
+{
+    CU_BITVECTOR_KERNEL_AUTO,    // Widest kernel the CPU supports
+    CU_BITVECTOR_KERNEL_SCALAR,
+    CU_BITVECTOR_KERNEL_SSE4,
+    CU_BITVECTOR_KERNEL_AVX2,
+} CUbitvectorKernel;
+
+// Selects the chunk scan kernel used by the range scans. Returns false, and
+// leaves the current kernel in place, if the CPU does not support it.
+// Exposed for tests and benchmarks; the default is CU_BITVECTOR_KERNEL_AUTO.
+NvBool cuibitvectorSelectKernel(CUbitvectorKernel kernel);
+
 #ifdef __cplusplus
 }
 #endif
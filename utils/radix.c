@@ -22,6 +22,30 @@ radixTreeIsBitSet(NvU64 key, NvU32 key_bit)
     return ((key & (1ULL << key_bit)) != 0);
 }
 
+static inline NvBool
+radixTreeIsLeaf(CUradixNode *node)
+{
+    return (node->child[0] == NULL && node->child[1] == NULL);
+}
+
+// Highest bit where two different keys disagree
+static inline NvU32
+radixTreeCritBit(NvU64 a, NvU64 b)
+{
+    CU_ASSERT(a != b);
+    return 63 - __builtin_clzll(a ^ b);
+}
+
+// True if the keys agree on every bit above key_bit
+static inline NvBool
+radixTreeSamePrefix(NvU64 a, NvU64 b, NvU32 key_bit)
+{
+    if (key_bit >= 63) {
+        return NV_TRUE;
+    }
+    return ((a ^ b) >> (key_bit + 1)) == 0;
+}
+
 static void
 radixListInit(CUradixNode *node)
 {
@@ -73,6 +97,13 @@ radixTreeInit(CUradixTree *tree, NvU32 key_bits)
     tree->key_bits = key_bits;
 }
 
+void
+radixTreeInitCompressed(CUradixTree *tree, NvU32 key_bits)
+{
+    radixTreeInit(tree, key_bits);
+    tree->compressed = NV_TRUE;
+}
+
 NvBool
 radixTreeEmpty(CUradixTree *tree)
 {
@@ -95,6 +126,7 @@ radixTreeReplaceNode(CUradixNode *orig, CUradixNode *repl)
 
     repl->parent_to_self_ptr = orig->parent_to_self_ptr;
     repl->parent = orig->parent;
+    repl->bit = orig->bit;
 
     for (i = 0; i < 2; i++) {
         repl->child[i] = orig->child[i];
@@ -107,7 +139,8 @@ radixTreeReplaceNode(CUradixNode *orig, CUradixNode *repl)
     *(repl->parent_to_self_ptr) = repl;
 }
 
-// There are (15) pointers that need to be changed to swap a parent with its specified child
+// There are (15) pointers that need to be changed to swap a parent with its specified child.
+// The branch bit belongs to the position, so it is swapped back as well.
 static void
 radixTreeSwapParentWithChild(CUradixNode *oldParent, CUradixNode *oldChild)
 {
@@ -143,6 +176,11 @@ radixTreeSwapParentWithChild(CUradixNode *oldParent, CUradixNode *oldChild)
     oldParent->parent = oldChild;
     oldChild->parent = swap_parent;
 
+    // Swap branch bits
+    NvU32 swap_bit = oldParent->bit;
+    oldParent->bit = oldChild->bit;
+    oldChild->bit = swap_bit;
+
     // Set child pointers of oldParent (6)
     for (i = 0; i < 2; i++) {
         oldParent->child[i] = oldChild_child[i];
@@ -153,6 +191,98 @@ radixTreeSwapParentWithChild(CUradixNode *oldParent, CUradixNode *oldChild)
     }
 }
 
+static void
+radixTreeLink(CUradixNode *parent, CUradixNode **parent_to_self_ptr, CUradixNode *node)
+{
+    node->parent = parent;
+    node->parent_to_self_ptr = parent_to_self_ptr;
+    *parent_to_self_ptr = node;
+}
+
+// 'node' disagrees with the subtree rooted at 'cur' above cur->bit. A new
+// position branching on their crit bit is placed above the subtree and is
+// occupied by the smaller key, so the min-heap order still holds. If that is
+// cur, it is first pushed down to a leaf and detached (like a removal) and
+// takes its duplicate list with it.
+static void
+radixTreeSplitCompressed(CUradixNode **parent_to_self_ptr, CUradixNode *cur, CUradixNode *node)
+{
+    CUradixNode *parent = cur->parent;
+    NvU32 crit = radixTreeCritBit(cur->key, node->key);
+    NvU32 subtree_side = radixTreeIsBitSet(cur->key, crit);
+    CUradixNode *top = node;
+    CUradixNode *leaf = NULL;
+
+    if (cur->key < node->key) {
+        CUradixNode *leastChild;
+        while ((leastChild = radixTreeGetSmallerChild(cur)) != NULL) {
+            radixTreeSwapParentWithChild(cur, leastChild);
+        }
+        *(cur->parent_to_self_ptr) = NULL;
+        cur->parent = NULL;
+        cur->parent_to_self_ptr = NULL;
+        top = cur;
+        leaf = node;
+    }
+
+    CUradixNode *subtree = *parent_to_self_ptr;
+    CU_ASSERT(subtree);
+    top->bit = crit;
+    radixTreeLink(parent, parent_to_self_ptr, top);
+    radixTreeLink(top, &top->child[subtree_side], subtree);
+    if (leaf) {
+        radixTreeLink(top, &top->child[1 - subtree_side], leaf);
+    }
+}
+
+// Same heap-ordered descent as the uncompressed insert, except each position
+// branches on its own bit. A leaf can branch on any bit below its parent's, so
+// it is retargeted to the crit bit against the incoming key; an inner position
+// whose prefix the key does not share is split.
+static void
+radixTreeInsertCompressed(CUradixTree *tree, CUradixNode *node)
+{
+    CUradixNode *parent = NULL;
+    CUradixNode **parent_to_self_ptr = &tree->root;
+
+    while (*parent_to_self_ptr && (*parent_to_self_ptr)->key != node->key) {
+        CUradixNode *cur = *parent_to_self_ptr;
+
+        if (radixTreeIsLeaf(cur)) {
+            cur->bit = radixTreeCritBit(cur->key, node->key);
+        }
+        else if (!radixTreeSamePrefix(cur->key, node->key, cur->bit)) {
+            radixTreeSplitCompressed(parent_to_self_ptr, cur, node);
+            return;
+        }
+
+        if (node->key < cur->key) {
+            CUradixNode *swapNode;
+
+            radixTreeReplaceNode(cur, node);
+
+            swapNode = cur;
+            cur = node;
+            node = swapNode;
+
+            node->child[0] = NULL;
+            node->child[1] = NULL;
+            node->parent = NULL;
+            node->parent_to_self_ptr = NULL;
+        }
+
+        parent = cur;
+        parent_to_self_ptr = &cur->child[radixTreeIsBitSet(node->key, cur->bit)];
+    }
+
+    if (*parent_to_self_ptr) {
+        radixListInsert(node, *parent_to_self_ptr);
+    }
+    else {
+        radixTreeLink(parent, parent_to_self_ptr, node);
+    }
+}
+
 // The tree is maintained so that at each time, the key of a parent node is
 // smaller than the key of its children. This allows us to make sure if we find
 // a node with a greater key on our path traversing the tree, it is the best
@@ -178,6 +308,11 @@ radixTreeInsert(CUradixTree *tree, CUradixNode *node, NvU64 key)
     node->key = key;
     radixListInit(node);
 
+    if (tree->compressed) {
+        radixTreeInsertCompressed(tree, node);
+        return;
+    }
+
     while (*parent_to_self_ptr && (*parent_to_self_ptr)->key != key) {
         CUradixNode *cur = *parent_to_self_ptr;
 
@@ -215,9 +350,51 @@ radixTreeInsert(CUradixTree *tree, CUradixNode *node, NvU64 key)
     }
 }
 
+// Every key below a position shares its prefix above the branch bit. Once the
+// search key leaves that prefix the whole subtree is either above the key (and
+// its root, the subtree minimum, was already considered) or below it.
+static CUradixNode *
+radixTreeFindGEQCompressed(CUradixTree *tree, NvU64 key)
+{
+    CUradixNode *node = tree->root;
+    CUradixNode *found = NULL;
+    CUradixNode *gt_tree = NULL;
+    unsigned int child_to_take = 0;
+
+    while (node) {
+        if (node->key == key) {
+            return node;
+        }
+
+        if (node->key > key) {
+            found = radixTreeGetSmallerNode(node, found);
+        }
+
+        if (radixTreeIsLeaf(node) || !radixTreeSamePrefix(node->key, key, node->bit)) {
+            break;
+        }
+
+        child_to_take = radixTreeIsBitSet(key, node->bit);
+        if (child_to_take == 0 && node->child[1]) {
+            gt_tree = node->child[1];
+        }
+        node = node->child[child_to_take];
+    }
+
+    if (!found) {
+        found = gt_tree;
+    }
+
+    return found;
+}
+
 CUradixNode *
 radixTreeFindGEQ(CUradixTree *tree, NvU64 key)
 {
+    if (tree->compressed) {
+        return radixTreeFindGEQCompressed(tree, key);
+    }
+
     CUradixNode *node = tree->root;
     CUradixNode *found = NULL;
     CUradixNode *gt_tree = NULL;
@@ -21,6 +21,7 @@ struct CUradixNode_st
     struct CUradixNode_st *parent;
 
     NvU64 key; // Bits of this key will determine the location of a node
+    NvU32 bit; // Compressed trees only: bit the children of this position branch on
 };
 
 // Generic radix tree type
@@ -28,11 +29,18 @@ struct CUradixTree_st
 {
     struct CUradixNode_st *root;
     unsigned int key_bits;
+    NvBool compressed;
 };
 
 CUDA_TEST_EXPORT void
 radixTreeInit(CUradixTree *tree, NvU32 key_bits);
 
+// Path-compressed (PATRICIA-style) variant with the same API. Positions only
+// branch on bits where the stored keys differ, so a lookup descends at most
+// one level per distinct key instead of one per key bit.
+CUDA_TEST_EXPORT void
+radixTreeInitCompressed(CUradixTree *tree, NvU32 key_bits);
+
 CUDA_TEST_EXPORT void
 radixTreeInsert(CUradixTree *tree, CUradixNode *node, NvU64 key);
 
@@ -0,0 +1,136 @@
+#include "seglist.h"
+
+// Maps a key to its class (fl) and sub-bucket (sl). Keys below
+// CU_SEGLIST_SL_COUNT get a sub-bucket each in class 0.
+static inline void
+cuSegListMapping(NvU64 key, NvU32 *fl, NvU32 *sl)
+{
+    if (key < CU_SEGLIST_SL_COUNT) {
+        *fl = 0;
+        *sl = (NvU32)key;
+        return;
+    }
+
+    NvU32 msb = 63 - __builtin_clzll(key);
+    *fl = msb - CU_SEGLIST_SL_BITS + 1;
+    *sl = (NvU32)(key >> (msb - CU_SEGLIST_SL_BITS)) & (CU_SEGLIST_SL_COUNT - 1);
+}
+
+// Smallest key that maps to (fl, sl)
+static inline NvU64
+cuSegListBucketBase(NvU32 fl, NvU32 sl)
+{
+    if (fl == 0) {
+        return sl;
+    }
+    return (1ULL << (fl + CU_SEGLIST_SL_BITS - 1)) | ((NvU64)sl << (fl - 1));
+}
+
+// Head of the first non-empty sub-bucket at or after (fl, sl)
+static CUsegListNode *
+cuSegListSearchFrom(CUsegList *list, NvU32 fl, NvU32 sl)
+{
+    NvU32 sl_map = (sl < CU_SEGLIST_SL_COUNT) ? (list->sl_bitmap[fl] & (~0U << sl)) : 0;
+    if (!sl_map) {
+        NvU64 fl_map = (fl + 1 < CU_SEGLIST_FL_COUNT) ? (list->fl_bitmap & (~0ULL << (fl + 1))) : 0;
+        if (!fl_map) {
+            return NULL;
+        }
+        fl = __builtin_ctzll(fl_map);
+        sl_map = list->sl_bitmap[fl];
+        CU_ASSERT(sl_map);
+    }
+
+    return list->heads[fl][__builtin_ctz(sl_map)];
+}
+
+void
+cuSegListInit(CUsegList *list)
+{
+    CU_ASSERT(list);
+    memset(list, 0, sizeof(*list));
+}
+
+NvBool
+cuSegListEmpty(CUsegList *list)
+{
+    CU_ASSERT(list);
+    return (list->fl_bitmap == 0);
+}
+
+void
+cuSegListInsert(CUsegList *list, CUsegListNode *node, NvU64 key)
+{
+    CU_ASSERT(list);
+    CU_ASSERT(node);
+
+    NvU32 fl, sl;
+    cuSegListMapping(key, &fl, &sl);
+
+    CUsegListNode *head = list->heads[fl][sl];
+    node->key = key;
+    node->prev = NULL;
+    node->next = head;
+    if (head) {
+        head->prev = node;
+    }
+    list->heads[fl][sl] = node;
+    list->sl_bitmap[fl] |= 1U << sl;
+    list->fl_bitmap |= 1ULL << fl;
+}
+
+void
+cuSegListRemove(CUsegList *list, CUsegListNode *node)
+{
+    CU_ASSERT(list);
+    CU_ASSERT(node);
+
+    NvU32 fl, sl;
+    cuSegListMapping(node->key, &fl, &sl);
+
+    if (node->prev) {
+        node->prev->next = node->next;
+    } else {
+        CU_ASSERT(list->heads[fl][sl] == node);
+        list->heads[fl][sl] = node->next;
+    }
+    if (node->next) {
+        node->next->prev = node->prev;
+    }
+    node->next = NULL;
+    node->prev = NULL;
+
+    if (!list->heads[fl][sl]) {
+        list->sl_bitmap[fl] &= ~(1U << sl);
+        if (!list->sl_bitmap[fl]) {
+            list->fl_bitmap &= ~(1ULL << fl);
+        }
+    }
+}
+
+CUsegListNode *
+cuSegListFindGEQ(CUsegList *list, NvU64 key)
+{
+    CU_ASSERT(list);
+
+    NvU32 fl, sl;
+    cuSegListMapping(key, &fl, &sl);
+
+    // Every key in the sub-bucket satisfies the request if it starts at 'key'
+    if (cuSegListBucketBase(fl, sl) == key) {
+        return cuSegListSearchFrom(list, fl, sl);
+    }
+
+    CUsegListNode *node = cuSegListSearchFrom(list, fl, sl + 1);
+    if (node) {
+        return node;
+    }
+
+    // Only the sub-bucket containing 'key' is left; take its first fit
+    for (node = list->heads[fl][sl]; node; node = node->next) {
+        if (node->key >= key) {
+            return node;
+        }
+    }
+    return NULL;
+}
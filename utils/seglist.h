@@ -0,0 +1,62 @@
+#ifndef __SEGLIST_H__
+#define __SEGLIST_H__
+
+#include "utils_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Segregated free lists keyed on size.
+//
+// Keys are split into power-of-two classes, each divided into
+// CU_SEGLIST_SL_COUNT linearly spaced sub-buckets. A first-level bitmap marks
+// non-empty classes and a second-level bitmap per class marks non-empty
+// sub-buckets, so a lookup is two ctz instructions and a list head read.
+//
+#define CU_SEGLIST_SL_BITS  4
+#define CU_SEGLIST_SL_COUNT (1 << CU_SEGLIST_SL_BITS)
+#define CU_SEGLIST_FL_COUNT 64
+
+typedef struct CUsegListNode_st CUsegListNode;
+typedef struct CUsegList_st CUsegList;
+
+struct CUsegListNode_st
+{
+    struct CUsegListNode_st *next;
+    struct CUsegListNode_st *prev;
+
+    NvU64 key;
+};
+
+struct CUsegList_st
+{
+    NvU64 fl_bitmap;                                              // Bit per non-empty class
+    NvU32 sl_bitmap[CU_SEGLIST_FL_COUNT];                         // Bit per non-empty sub-bucket
+    CUsegListNode *heads[CU_SEGLIST_FL_COUNT][CU_SEGLIST_SL_COUNT];
+};
+
+CUDA_TEST_EXPORT void
+cuSegListInit(CUsegList *list);
+
+CUDA_TEST_EXPORT void
+cuSegListInsert(CUsegList *list, CUsegListNode *node, NvU64 key);
+
+CUDA_TEST_EXPORT void
+cuSegListRemove(CUsegList *list, CUsegListNode *node);
+
+CUDA_TEST_EXPORT NvBool
+cuSegListEmpty(CUsegList *list);
+
+// Returns a node whose key is >= 'key', or NULL if there is none. Nodes from a
+// sub-bucket entirely above 'key' are preferred (good fit in O(1)); the
+// sub-bucket containing 'key' is only scanned, first fit, when nothing larger exists.
+CUDA_TEST_EXPORT CUsegListNode *
+cuSegListFindGEQ(CUsegList *list, NvU64 key);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
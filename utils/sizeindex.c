@@ -0,0 +1,157 @@
+#include "sizeindex.h"
+
+static int
+cuSizeIndexAddrCompare(CUavlTreeKey a, CUavlTreeKey b)
+{
+    uintptr_t ka = (uintptr_t)a;
+    uintptr_t kb = (uintptr_t)b;
+    return (ka < kb) ? -1 : (ka > kb) ? 1 : 0;
+}
+
+static void
+cuSizeIndexMaxSizeAugment(CUavlTreeNode *node)
+{
+    NvU64 max_size = ((CUsizeIndexAvlNode *)node)->size;
+    if (node->left && node->left->augment > max_size) {
+        max_size = node->left->augment;
+    }
+    if (node->right && node->right->augment > max_size) {
+        max_size = node->right->augment;
+    }
+    node->augment = max_size;
+}
+
+// Lowest-address extent of at least 'size': go left whenever the left subtree
+// still holds a large enough extent, so the walk is a single root-to-leaf path.
+static CUsizeIndexNode *
+cuSizeIndexFindFirstFit(CUavlTree *tree, NvU64 size)
+{
+    CUavlTreeNode *node = tree->root;
+    if (!node || node->augment < size) {
+        return NULL;
+    }
+
+    while (node) {
+        if (node->left && node->left->augment >= size) {
+            node = node->left;
+        }
+        else if (((CUsizeIndexAvlNode *)node)->size >= size) {
+            return (CUsizeIndexNode *)node;
+        }
+        else {
+            node = node->right;
+        }
+    }
+
+    CU_ASSERT(0);
+    return NULL;
+}
+
+void
+cuSizeIndexInit(CUsizeIndex *index, CUsizeIndexKind kind)
+{
+    CU_ASSERT(index);
+
+    index->kind = kind;
+    switch (kind) {
+        case CU_SIZE_INDEX_RADIX:
+            radixTreeInit(&index->u.radix, 63);  // Use 63 bits for size keys
+            break;
+        case CU_SIZE_INDEX_RADIX_COMPRESSED:
+            radixTreeInitCompressed(&index->u.radix, 63);
+            break;
+        case CU_SIZE_INDEX_SEGREGATED:
+            cuSegListInit(&index->u.seg);
+            break;
+        case CU_SIZE_INDEX_ADDRESS_FIRST_FIT:
+            cuAvlTreeInitialize(&index->u.avl, cuSizeIndexAddrCompare, NULL);
+            cuAvlTreeSetAugment(&index->u.avl, cuSizeIndexMaxSizeAugment);
+            break;
+        default:
+            CU_ASSERT(0);
+    }
+}
+
+void
+cuSizeIndexInsert(CUsizeIndex *index, CUsizeIndexNode *node, NvU64 key, NvU64 addr)
+{
+    CU_ASSERT(index);
+    CU_ASSERT(node);
+
+    switch (index->kind) {
+        case CU_SIZE_INDEX_RADIX:
+        case CU_SIZE_INDEX_RADIX_COMPRESSED:
+            radixTreeInsert(&index->u.radix, &node->u.radix, key);
+            break;
+        case CU_SIZE_INDEX_SEGREGATED:
+            cuSegListInsert(&index->u.seg, &node->u.seg, key);
+            break;
+        case CU_SIZE_INDEX_ADDRESS_FIRST_FIT:
+            node->u.avl.size = key;
+            cuAvlTreeNodeInsert(&index->u.avl, &node->u.avl.avl, (CUavlTreeKey)(uintptr_t)addr, NULL);
+            break;
+        default:
+            CU_ASSERT(0);
+    }
+}
+
+void
+cuSizeIndexRemove(CUsizeIndex *index, CUsizeIndexNode *node)
+{
+    CU_ASSERT(index);
+    CU_ASSERT(node);
+
+    switch (index->kind) {
+        case CU_SIZE_INDEX_RADIX:
+        case CU_SIZE_INDEX_RADIX_COMPRESSED:
+            radixTreeRemove(&node->u.radix);
+            break;
+        case CU_SIZE_INDEX_SEGREGATED:
+            cuSegListRemove(&index->u.seg, &node->u.seg);
+            break;
+        case CU_SIZE_INDEX_ADDRESS_FIRST_FIT:
+            cuAvlTreeNodeRemove(&index->u.avl, &node->u.avl.avl);
+            break;
+        default:
+            CU_ASSERT(0);
+    }
+}
+
+NvBool
+cuSizeIndexEmpty(CUsizeIndex *index)
+{
+    CU_ASSERT(index);
+
+    switch (index->kind) {
+        case CU_SIZE_INDEX_RADIX:
+        case CU_SIZE_INDEX_RADIX_COMPRESSED:
+            return radixTreeEmpty(&index->u.radix);
+        case CU_SIZE_INDEX_SEGREGATED:
+            return cuSegListEmpty(&index->u.seg);
+        case CU_SIZE_INDEX_ADDRESS_FIRST_FIT:
+            return (index->u.avl.root == NULL);
+        default:
+            CU_ASSERT(0);
+            return NV_TRUE;
+    }
+}
+
+CUsizeIndexNode *
+cuSizeIndexFindGEQ(CUsizeIndex *index, NvU64 key)
+{
+    CU_ASSERT(index);
+
+    // All node types sit at offset 0 of the union, so they convert back directly
+    switch (index->kind) {
+        case CU_SIZE_INDEX_RADIX:
+        case CU_SIZE_INDEX_RADIX_COMPRESSED:
+            return (CUsizeIndexNode *)radixTreeFindGEQ(&index->u.radix, key);
+        case CU_SIZE_INDEX_SEGREGATED:
+            return (CUsizeIndexNode *)cuSegListFindGEQ(&index->u.seg, key);
+        case CU_SIZE_INDEX_ADDRESS_FIRST_FIT:
+            return cuSizeIndexFindFirstFit(&index->u.avl, key);
+        default:
+            CU_ASSERT(0);
+            return NULL;
+    }
+}
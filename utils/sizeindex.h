@@ -0,0 +1,75 @@
+#ifndef __SIZEINDEX_H__
+#define __SIZEINDEX_H__
+
+#include "utils_types.h"
+#include "radix.h"
+#include "seglist.h"
+#include "avl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Free-extent index keyed on size, with a selectable backing structure.
+// Every kind implements the same insert/remove/find-GEQ contract, so an
+// allocator can switch between them without touching its fit logic.
+//
+typedef enum CUsizeIndexKind_enum
+{
+    CU_SIZE_INDEX_RADIX      = 0,  // CUradixTree over 63-bit keys, exact best fit
+    CU_SIZE_INDEX_SEGREGATED = 1,  // CUsegList, O(1) good fit
+    CU_SIZE_INDEX_RADIX_COMPRESSED = 2,  // Path-compressed CUradixTree, exact best fit
+    CU_SIZE_INDEX_ADDRESS_FIRST_FIT = 3, // CUavlTree on address augmented with max size, lowest-address fit
+} CUsizeIndexKind;
+
+typedef struct CUsizeIndexNode_st CUsizeIndexNode;
+typedef struct CUsizeIndex_st CUsizeIndex;
+
+typedef struct CUsizeIndexAvlNode_st
+{
+    CUavlTreeNode avl;  // Keyed on address, augment is the largest size in the subtree
+    NvU64 size;
+} CUsizeIndexAvlNode;
+
+struct CUsizeIndexNode_st
+{
+    union {
+        CUradixNode radix;
+        CUsegListNode seg;
+        CUsizeIndexAvlNode avl;
+    } u;
+};
+
+struct CUsizeIndex_st
+{
+    CUsizeIndexKind kind;
+    union {
+        CUradixTree radix;
+        CUsegList seg;
+        CUavlTree avl;
+    } u;
+};
+
+CUDA_TEST_EXPORT void
+cuSizeIndexInit(CUsizeIndex *index, CUsizeIndexKind kind);
+
+// 'addr' orders extents for address-ordered kinds and is ignored by the others
+CUDA_TEST_EXPORT void
+cuSizeIndexInsert(CUsizeIndex *index, CUsizeIndexNode *node, NvU64 key, NvU64 addr);
+
+CUDA_TEST_EXPORT void
+cuSizeIndexRemove(CUsizeIndex *index, CUsizeIndexNode *node);
+
+CUDA_TEST_EXPORT NvBool
+cuSizeIndexEmpty(CUsizeIndex *index);
+
+// Returns a node whose key is >= 'key', or NULL if there is none
+CUDA_TEST_EXPORT CUsizeIndexNode *
+cuSizeIndexFindGEQ(CUsizeIndex *index, NvU64 key);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif